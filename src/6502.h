@@ -4,51 +4,476 @@
 #include <iostream>
 #include <iomanip>
 #include <vector>
-#include <thread>
-#include <chrono>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "throttle.h"
+#include "trace.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "histogram.h"
+#include "decimal.h"
+
+// dispatch engine of CPU::execute : 0 switch (default), 1 handler table, 2 threaded (computed goto), 3 decoded instruction cache
+#ifndef M6502_DISPATCH
+#define M6502_DISPATCH 0
+#endif
+
+#if defined(__GNUC__)
+#define M6502_LIKELY(condition) __builtin_expect(!!(condition), 1)
+#define M6502_NOINLINE __attribute__((noinline, cold))
+#else
+#define M6502_LIKELY(condition) (condition)
+#define M6502_NOINLINE
+#endif
 
 namespace m6502 {
 
 	typedef uint8_t BYTE;	// uint8_t (1 byte)
 	typedef uint16_t WORD;	// uint16_t (2 bytes)
 
+	// memory-mapped peripheral occupying one or more pages of the bus (see MEMORY::mapDevice)
+	struct DEVICE {
+		public:
+			virtual ~DEVICE() {}
+
+			// called for every read of a mapped page (address is the full bus address)
+			virtual BYTE read(WORD address) = 0;
+
+			// called for every write to a mapped page
+			virtual void write(WORD address, BYTE value) = 0;
+	}; // struct DEVICE
+
 	// computer memory struct
+	// the bus is split in 256 pages of 256 bytes. Each page is RAM, ROM or a device :
+	// RAM and ROM pages are read (and RAM pages written) straight through a page pointer, only device pages go through a virtual call
+	// pages are marked dirty when written so that save() and restore() only copy what changed
+	// generation() changes whenever bytes may change without a write through the page table, so caches of memory contents know when to drop
 	struct MEMORY {
 		public:
-			// returns reference to data[address] (1 cycle)
+			static constexpr uint32_t MEM_SIZE = 0x10000;	// 64 KiB
+			static constexpr uint32_t PAGE_SIZE = 0x100;
+			static constexpr uint32_t PAGES = MEM_SIZE / PAGE_SIZE;
+
+			typedef std::array<BYTE, PAGE_SIZE> PAGE;
+
+			// copy-on-write image of the memory data : pages not written between two saves are shared with the previous snapshot
+			// covers the memory data only (not the page table, mapper banks or devices)
+			struct SNAPSHOT {
+				std::array<std::shared_ptr<const PAGE>, PAGES> pages;
+			}; // struct SNAPSHOT
+
+			// returns reference to data[address] (1 cycle). Bypasses the page table (the page is marked dirty, the reference may be written)
 			BYTE &operator[](WORD address) {
 				(*cycles)--;
+				markDirty(address >> 8);
+				changes++;
 				return this->data[address];
 			}
-			
-			// fills memory with 0. Does not affect cycle count (done before CPU starts)
+
+			// returns reference to data[address] without counting a cycle. Bypasses the page table (the page is marked dirty, the reference may be written)
+			BYTE &at(WORD address) {
+				markDirty(address >> 8);
+				changes++;
+				return this->data[address];
+			}
+
+			// reads address through the page table (1 cycle)
+			BYTE read(WORD address) {
+				(*cycles)--;
+				return readAt(address);
+			}
+
+			// writes address through the page table (1 cycle)
+			void write(WORD address, BYTE value) {
+				(*cycles)--;
+				writeAt(address, value);
+			}
+
+			// counts one bus cycle
+			void tick() {
+				(*cycles)--;
+			}
+
+			// reads data[address] without counting a cycle. Bypasses the page table (flat bus, see CPU_T)
+			BYTE readRam(WORD address) const {
+				return data[address];
+			}
+
+			// writes data[address] without counting a cycle. Bypasses the page table and the dirty pages (flat bus, see CPU_T) : save does not see the write
+			void writeRam(WORD address, BYTE value) {
+				data[address] = value;
+			}
+
+			// reads address through the page table without counting a cycle
+			BYTE readAt(WORD address) {
+				const BYTE *page = readPages[address >> 8];
+				if (M6502_LIKELY(page != nullptr)) {
+					return page[address & 0xFF];
+				}
+				return deviceRead(address);
+			}
+
+			// writes address through the page table without counting a cycle. Writes to ROM pages are discarded
+			void writeAt(WORD address, BYTE value) {
+				BYTE *page = writePages[address >> 8];
+				if (M6502_LIKELY(page != nullptr)) {
+					page[address & 0xFF] = value;
+					markDirty(address >> 8);
+					return;
+				}
+				deviceWrite(address, value);
+			}
+
+			// returns the cycle count the memory decrements
+			uint32_t remainingCycles() const {
+				return *cycles;
+			}
+
+			// returns true if page is mapped to a device (its bytes are produced by each read)
+			bool isDevice(BYTE page) const {
+				return readPages[page] == nullptr;
+			}
+
+			// returns a counter changed by every mapping, fill, restore and direct access (at and operator[])
+			uint32_t generation() const {
+				return changes;
+			}
+
+			// returns the bytes read by page, nullptr for a device page
+			const BYTE *readPage(BYTE page) const {
+				return readPages[page];
+			}
+
+			// returns the bytes written by page (romSink for a ROM page), nullptr for a device page
+			BYTE *writePage(BYTE page) const {
+				return writePages[page];
+			}
+
+			// records writes to page made through writePage instead of writeAt
+			void markWritten(BYTE page) {
+				markDirty(page);
+			}
+
+			// maps pages firstPage to lastPage as RAM. memory points to the bytes of firstPage (the matching part of data by default)
+			void mapRam(BYTE firstPage, BYTE lastPage, BYTE *memory = nullptr) {
+				changes++;
+				for (uint32_t page = firstPage; page <= lastPage; page++) {
+					BYTE *pageData = (memory != nullptr ? memory + (page - firstPage) * PAGE_SIZE : data + page * PAGE_SIZE);
+					readPages[page] = writePages[page] = pageData;
+					devices[page] = nullptr;
+				}
+			}
+
+			// maps pages firstPage to lastPage as ROM : reads like mapRam, writes are ignored
+			void mapRom(BYTE firstPage, BYTE lastPage, const BYTE *memory = nullptr) {
+				changes++;
+				for (uint32_t page = firstPage; page <= lastPage; page++) {
+					readPages[page] = (memory != nullptr ? memory + (page - firstPage) * PAGE_SIZE : data + page * PAGE_SIZE);
+					writePages[page] = romSink;
+					devices[page] = nullptr;
+				}
+			}
+
+			// maps pages firstPage to lastPage to device, which then handles every access to them
+			void mapDevice(BYTE firstPage, BYTE lastPage, DEVICE *device) {
+				changes++;
+				for (uint32_t page = firstPage; page <= lastPage; page++) {
+					readPages[page] = nullptr;
+					writePages[page] = nullptr;
+					devices[page] = device;
+				}
+			}
+
+			// fills memory with 0 and maps every page as RAM. Does not affect cycle count (done before CPU starts)
 			void init(uint32_t *nCycles) {
-				for (WORD i = 0; i < MAX_MEM; i++) {
+				for (uint32_t i = 0; i < MEM_SIZE; i++) {
 					data[i] = 0;
 				}
-				data[MAX_MEM] = 0;
+				mapRam(0x00, 0xFF);
+				for (uint32_t page = 0; page < PAGES; page++) {
+					markDirty(page);
+				}
 				cycles = nCycles;
 			}
 
-			// fills memory with given byte array. Does not affect cycle count (done before CPU starts)
-			void fill(std::vector<BYTE> nData) {
-				for (WORD i = 0; i < nData.size(); i++) {
-					data[i] = nData[i];
-					if (i == MAX_MEM) {
-						data[i] = nData[i];
-						break;
+			// fills memory with given byte array, from address 0. Does not affect cycle count (done before CPU starts)
+			// writes data directly, so it also loads ROM pages
+			void fill(const std::vector<BYTE> &nData) {
+				load(0x0000, nData.data(), nData.size());
+			}
+
+			// copies size bytes to origin and up (the bytes past 0xFFFF are dropped). Does not affect cycle count
+			// like fill, writes data directly, and only marks the pages it touches as written
+			void load(WORD origin, const BYTE *bytes, size_t size) {
+				if (size == 0) {
+					return;
+				}
+				changes++;
+				size = std::min(size, (size_t)(MEM_SIZE - origin));
+				std::copy(bytes, bytes + size, data + origin);
+				for (uint32_t page = origin >> 8; page <= (origin + size - 1) >> 8; page++) {
+					markDirty(page);
+				}
+			}
+
+			// returns a snapshot of the memory data. Only the pages written since the last save or restore are copied
+			SNAPSHOT save() {
+				for (uint32_t i = 0; i < dirtyCount; i++) {
+					BYTE page = dirtyList[i];
+					std::shared_ptr<PAGE> copy = std::make_shared<PAGE>();
+					std::copy(data + page * PAGE_SIZE, data + (page + 1) * PAGE_SIZE, copy->begin());
+					clean[page] = copy;
+				}
+				clearDirty();
+				SNAPSHOT snapshot;
+				snapshot.pages = clean;
+				return snapshot;
+			}
+
+			// puts the memory data back as it was at snapshot. Only the pages written since, or differing between the last save or restore and snapshot, are copied
+			void restore(const SNAPSHOT &snapshot) {
+				changes++;
+				for (uint32_t page = 0; page < PAGES; page++) {
+					if (dirty[page] || clean[page] != snapshot.pages[page]) {
+						std::copy(snapshot.pages[page]->begin(), snapshot.pages[page]->end(), data + page * PAGE_SIZE);
+						clean[page] = snapshot.pages[page];
 					}
 				}
+				clearDirty();
+			}
+
+			// returns the number of pages written since the last save or restore
+			uint32_t dirtyPages() const {
+				return dirtyCount;
 			}
 		private:
-			static constexpr WORD MAX_MEM = 0xFFFF;
-			BYTE data[MAX_MEM];	// memory data (64 KiB)
-			uint32_t *cycles;	// pointer to cycle count
+			// device accesses stay out of line so the inlined RAM path of every access remains small
+			M6502_NOINLINE BYTE deviceRead(WORD address) {
+				return devices[address >> 8]->read(address);
+			}
+
+			M6502_NOINLINE void deviceWrite(WORD address, BYTE value) {
+				devices[address >> 8]->write(address, value);
+			}
+
+			// records the first write to a page since the last save or restore
+			void markDirty(BYTE page) {
+				if (!dirty[page]) {
+					dirty[page] = true;
+					dirtyList[dirtyCount++] = page;
+				}
+			}
+
+			void clearDirty() {
+				for (uint32_t i = 0; i < dirtyCount; i++) {
+					dirty[dirtyList[i]] = false;
+				}
+				dirtyCount = 0;
+			}
+
+			BYTE data[MEM_SIZE];				// memory data (64 KiB)
+			const BYTE *readPages[PAGES];		// data read by each page, nullptr for device pages
+			BYTE *writePages[PAGES];			// data written by each page, romSink for ROM pages, nullptr for device pages
+			DEVICE *devices[PAGES];				// device of each device page
+			BYTE romSink[PAGE_SIZE];			// receives the writes to ROM pages
+			bool dirty[PAGES] = {};				// pages written since the last save or restore
+			BYTE dirtyList[PAGES];				// the dirty pages, in order of first write
+			uint32_t dirtyCount = 0;
+			std::array<std::shared_ptr<const PAGE>, PAGES> clean;	// content of each page as of the last save or restore (what a clean page still holds)
+			uint32_t *cycles;					// pointer to cycle count
+			uint32_t changes = 0;				// see generation()
 	}; // struct MEMORY
 
-	// computer central processing unit struct
-	struct CPU {
+	// statistics of the last CPU::execute run
+	struct RUN_STATS {
+		public:
+			uint64_t instructions;				// instructions retired
+			uint64_t cycles;					// emulated cycles consumed
+			std::chrono::nanoseconds wallTime;	// host time spent in execute
+
+			// returns the effective emulated clock frequency in MHz
+			double emulatedMHz() const {
+				return (wallTime.count() > 0 ? cycles * 1000.0 / wallTime.count() : 0.0);
+			}
+
+			// prints a one-line summary of the run
+			void report(std::ostream &out) const {
+				out << std::dec << instructions << " instructions, " << cycles << " cycles in " << std::fixed << std::setprecision(3)
+					<< wallTime.count() / 1000000.0 << " ms (" << emulatedMHz() << " emulated MHz)" << std::defaultfloat << std::endl;
+			}
+	}; // struct RUN_STATS
+
+	// operations of the 6502 : an opcode is one of them in one addressing mode (see M6502_OPCODES)
+	// listed so that ranges make groups : LDA to LDY and AND to CPY read an operand, BCC to BVS are the branches
+	enum OPERATION : BYTE {
+		LDA, LDX, LDY, STA, STX, STY, TAX, TAY, TXA, TYA, TSX, TXS, PHA, PHP, PLA, PLP,
+		AND, EOR, ORA, BIT, ADC, SBC, CMP, CPX, CPY, INC, INX, INY, DEC, DEX, DEY,
+		ASL, LSR, ROL, ROR, JMP, JSR, RTS, BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS,
+		CLC, CLD, CLI, CLV, SEC, SED, SEI, BRK, NOP, RTI
+	};
+
+	// every implemented opcode as X(name, operation, addressing mode, base cycles). name matches the CPU::ins_<name> constant
+	// base cycles exclude the page-cross cycle of indexed reads and the taken / page-cross cycles of branches
+	// this is the only definition of the instruction set : the descriptor table (CPU::descriptorTable), the dispatch engines of CPU::execute and
+	// the handler each of them calls (CPU::op<operation, mode>) are all generated from it
+	#define M6502_OPCODES(X) \
+		X(lda_im, LDA, imm, 2) X(lda_zp, LDA, zp, 3) X(lda_zpx, LDA, zpx, 4) X(lda_abs, LDA, abs, 4) X(lda_absx, LDA, absx, 4) X(lda_absy, LDA, absy, 4) X(lda_indx, LDA, indx, 6) X(lda_indy, LDA, indy, 5) \
+		X(ldx_im, LDX, imm, 2) X(ldx_zp, LDX, zp, 3) X(ldx_zpy, LDX, zpy, 4) X(ldx_abs, LDX, abs, 4) X(ldx_absy, LDX, absy, 4) \
+		X(ldy_im, LDY, imm, 2) X(ldy_zp, LDY, zp, 3) X(ldy_zpx, LDY, zpx, 4) X(ldy_abs, LDY, abs, 4) X(ldy_absx, LDY, absx, 4) \
+		X(sta_zp, STA, zp, 3) X(sta_zpx, STA, zpx, 4) X(sta_abs, STA, abs, 4) X(sta_absx, STA, absx, 5) X(sta_absy, STA, absy, 5) X(sta_indx, STA, indx, 6) X(sta_indy, STA, indy, 6) \
+		X(stx_zp, STX, zp, 3) X(stx_zpy, STX, zpy, 4) X(stx_abs, STX, abs, 4) \
+		X(sty_zp, STY, zp, 3) X(sty_zpx, STY, zpx, 4) X(sty_abs, STY, abs, 4) \
+		X(tax, TAX, imp, 2) X(tay, TAY, imp, 2) X(txa, TXA, imp, 2) X(tya, TYA, imp, 2) \
+		X(tsx, TSX, imp, 2) X(txs, TXS, imp, 2) X(pha, PHA, imp, 3) X(php, PHP, imp, 3) X(pla, PLA, imp, 4) X(plp, PLP, imp, 4) \
+		X(and_im, AND, imm, 2) X(and_zp, AND, zp, 3) X(and_zpx, AND, zpx, 4) X(and_abs, AND, abs, 4) X(and_absx, AND, absx, 4) X(and_absy, AND, absy, 4) X(and_indx, AND, indx, 6) X(and_indy, AND, indy, 5) \
+		X(eor_im, EOR, imm, 2) X(eor_zp, EOR, zp, 3) X(eor_zpx, EOR, zpx, 4) X(eor_abs, EOR, abs, 4) X(eor_absx, EOR, absx, 4) X(eor_absy, EOR, absy, 4) X(eor_indx, EOR, indx, 6) X(eor_indy, EOR, indy, 5) \
+		X(ora_im, ORA, imm, 2) X(ora_zp, ORA, zp, 3) X(ora_zpx, ORA, zpx, 4) X(ora_abs, ORA, abs, 4) X(ora_absx, ORA, absx, 4) X(ora_absy, ORA, absy, 4) X(ora_indx, ORA, indx, 6) X(ora_indy, ORA, indy, 5) \
+		X(bit_zp, BIT, zp, 3) X(bit_abs, BIT, abs, 4) \
+		X(adc_im, ADC, imm, 2) X(adc_zp, ADC, zp, 3) X(adc_zpx, ADC, zpx, 4) X(adc_abs, ADC, abs, 4) X(adc_absx, ADC, absx, 4) X(adc_absy, ADC, absy, 4) X(adc_indx, ADC, indx, 6) X(adc_indy, ADC, indy, 5) \
+		X(sbc_im, SBC, imm, 2) X(sbc_zp, SBC, zp, 3) X(sbc_zpx, SBC, zpx, 4) X(sbc_abs, SBC, abs, 4) X(sbc_absx, SBC, absx, 4) X(sbc_absy, SBC, absy, 4) X(sbc_indx, SBC, indx, 6) X(sbc_indy, SBC, indy, 5) \
+		X(cmp_im, CMP, imm, 2) X(cmp_zp, CMP, zp, 3) X(cmp_zpx, CMP, zpx, 4) X(cmp_abs, CMP, abs, 4) X(cmp_absx, CMP, absx, 4) X(cmp_absy, CMP, absy, 4) X(cmp_indx, CMP, indx, 6) X(cmp_indy, CMP, indy, 5) \
+		X(cpx_im, CPX, imm, 2) X(cpx_zp, CPX, zp, 3) X(cpx_abs, CPX, abs, 4) \
+		X(cpy_im, CPY, imm, 2) X(cpy_zp, CPY, zp, 3) X(cpy_abs, CPY, abs, 4) \
+		X(inc_zp, INC, zp, 5) X(inc_zpx, INC, zpx, 6) X(inc_abs, INC, abs, 6) X(inc_absx, INC, absx, 7) X(inx, INX, imp, 2) X(iny, INY, imp, 2) \
+		X(dec_zp, DEC, zp, 5) X(dec_zpx, DEC, zpx, 6) X(dec_abs, DEC, abs, 6) X(dec_absx, DEC, absx, 7) X(dex, DEX, imp, 2) X(dey, DEY, imp, 2) \
+		X(asl_acc, ASL, imp, 2) X(asl_zp, ASL, zp, 5) X(asl_zpx, ASL, zpx, 6) X(asl_abs, ASL, abs, 6) X(asl_absx, ASL, absx, 7) \
+		X(lsr_acc, LSR, imp, 2) X(lsr_zp, LSR, zp, 5) X(lsr_zpx, LSR, zpx, 6) X(lsr_abs, LSR, abs, 6) X(lsr_absx, LSR, absx, 7) \
+		X(rol_acc, ROL, imp, 2) X(rol_zp, ROL, zp, 5) X(rol_zpx, ROL, zpx, 6) X(rol_abs, ROL, abs, 6) X(rol_absx, ROL, absx, 7) \
+		X(ror_acc, ROR, imp, 2) X(ror_zp, ROR, zp, 5) X(ror_zpx, ROR, zpx, 6) X(ror_abs, ROR, abs, 6) X(ror_absx, ROR, absx, 7) \
+		X(jmp_abs, JMP, abs, 3) X(jmp_ind, JMP, ind, 5) X(jsr_abs, JSR, abs, 6) X(rts, RTS, imp, 6) \
+		X(bcc, BCC, rel, 2) X(bcs, BCS, rel, 2) X(beq, BEQ, rel, 2) X(bmi, BMI, rel, 2) X(bne, BNE, rel, 2) X(bpl, BPL, rel, 2) X(bvc, BVC, rel, 2) X(bvs, BVS, rel, 2) \
+		X(clc, CLC, imp, 2) X(cld, CLD, imp, 2) X(cli, CLI, imp, 2) X(clv, CLV, imp, 2) X(sec, SEC, imp, 2) X(sed, SED, imp, 2) X(sei, SEI, imp, 2) \
+		X(brk, BRK, imp, 7) X(nop, NOP, imp, 2) X(rti, RTI, imp, 6)
+
+	// pieces of the dispatch engines and tables, expanded over M6502_OPCODES inside CPU_T
+	#define M6502_SWITCH_CASE(name, operation, mode, cycles) case ins_##name: op<operation, am_##mode>(handlerCycles, mem, fetchOperand<operandLength(am_##mode)>(mem)); break;
+	#define M6502_CACHED_CASE(name, operation, mode, cycles) case ins_##name: op<operation, am_##mode>(handlerCycles, mem, decoded->operand); break;
+	#define M6502_TABLE_ENTRY(name, operation, mode, cycles) table[ins_##name] = {&CPU_T::op<operation, am_##mode>, operandLength(am_##mode)};
+	#define M6502_DESCRIPTOR_ENTRY(name, operation, mode, cycles) table[ins_##name] = {operation, am_##mode, cycles};
+	#define M6502_THREADED_LABEL(name, operation, mode, cycles) labels[ins_##name] = &&threaded_##name;
+	#define M6502_THREADED_HANDLER(name, operation, mode, cycles) threaded_##name: op<operation, am_##mode>(handlerCycles, mem, fetchOperand<operandLength(am_##mode)>(mem)); M6502_THREADED_NEXT
+	#define M6502_THREADED_NEXT \
+		chargeInstruction(cycles, instruction); \
+		throttle.sync((uint32_t)(startCycles - cycles)); \
+		M6502_THREADED_DISPATCH
+	#define M6502_THREADED_DISPATCH \
+		if (cycles == 0 || cycles >= 0xFFFFFFFA) { \
+			goto threaded_done; \
+		} \
+		instructions++; \
+		instruction = fetchOpcode(mem); \
+		goto *labels[instruction];
+
+	// cycle-exact timing : every bus access and internal cycle is counted as it happens
+	struct EXACT_TIMING {
+		static constexpr bool exact = true;
+	}; // struct EXACT_TIMING
+
+	// per-instruction timing : bus accesses are not counted, each instruction is charged its base cost from CPU_T::cycleTable plus its page-cross and branch penalties in one subtraction
+	struct INSTRUCTION_TIMING {
+		static constexpr bool exact = false;
+	}; // struct INSTRUCTION_TIMING
+
+	// registers of the 6502, in one trivially copyable block (saved and restored with a memcpy)
+	// the flags are the bits of the status register reg_status, laid out as pushed on the stack (NV--DIZC), so PHP, PLP, BRK, RTI and interrupts move it as one byte
+	struct REGISTERS {
+		WORD reg_programCounter;	// 16-bit program counter register
+		BYTE reg_stackPointer;		// 8-bit stack pointer register
+		BYTE reg_acc;				// 8-bit accumulator register
+		BYTE reg_x;					// 8-bit x register
+		BYTE reg_y;					// 8-bit y register
+
+		union {
+			BYTE reg_status;			// 8-bit status register (bits 4 and 5 always clear)
+			struct {
+				BYTE fl_carry:1;		// 1-bit carry flag
+				BYTE fl_zero:1;			// 1-bit zero flag
+				BYTE fl_interr:1;		// 1-bit interrupt flag
+				BYTE fl_dec:1;			// 1-bit decimal flag
+				BYTE :2;				// during a processor status stack push, bit 4 is set to 1 if pushed from a PHP or BRK instruction or to 0 if pushed from an /IRQ or /NMI signal being pulled low
+										// during a processor status stack push, bit 5 is always set to 1
+				BYTE fl_oflow:1;		// 1-bit overflow flag
+				BYTE fl_neg:1;			// 1-bit negative flag
+			};
+		};
+	}; // struct REGISTERS
+
+	static_assert(std::is_trivially_copyable<REGISTERS>::value && sizeof(REGISTERS) == 8, "registers block");
+	// bitfield order is implementation-defined : GCC and Clang allocate from the least significant bit on little-endian targets only
+	// (each fl_* is checked against its NV--DIZC bit of reg_status by test N)
+#ifdef __BYTE_ORDER__
+	static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the fl_* bitfields must land on their bits of reg_status");
+#endif
+
+	// eager flags : every flag is written to its bitfield by the instruction that sets it
+	struct EAGER_FLAGS {
+		static constexpr bool lazy = false;
+	}; // struct EAGER_FLAGS
+
+	// lazy flags : during a run, instructions only store the values N, Z, C and V are made of (the last result, the carry, the overflow bits),
+	// and the flags are computed from them when they are read : by a branch, a status push (PHP, BRK, an interrupt) or the host once the run is over
+	struct LAZY_FLAGS {
+		static constexpr bool lazy = true;
+	}; // struct LAZY_FLAGS
+
+	// paged bus : every access goes through the page table of MEMORY, so ROM, banked and device pages behave as mapped
+	struct PAGED_BUS {
+		static constexpr bool paged = true;
+	}; // struct PAGED_BUS
+
+	// flat bus : every access goes straight to the 64 KiB array of MEMORY, as RAM (the page table is not looked at : no ROM, bank or device)
+	// writes are plain stores, recorded neither in the dirty pages of MEMORY nor against the decode cache : CPU save / restore and DISPATCH_CACHED
+	// are not available, and MEMORY::save misses the writes of a run. For programs that run on plain RAM, such as batch jobs without a halt port
+	struct FLAT_BUS {
+		static constexpr bool paged = false;
+	}; // struct FLAT_BUS
+
+	// no tracing : the CPU contains no trace code, traceSink is never called
+	struct NO_TRACE {
+		static constexpr bool traced = false;
+	}; // struct NO_TRACE
+
+	// sink tracing : instruction starts and bus accesses are reported to traceSink (the null sink until one is attached)
+	struct SINK_TRACE {
+		static constexpr bool traced = true;
+	}; // struct SINK_TRACE
+
+	// tracing of CPU_T when not chosen : sink tracing in builds defining M6502_TRACE, none otherwise
+#ifdef M6502_TRACE
+	typedef SINK_TRACE DEFAULT_TRACE;
+#else
+	typedef NO_TRACE DEFAULT_TRACE;
+#endif
+
+	// no interrupts : the CPU contains no scheduler code, execute runs the whole budget in one slice and scheduler is ignored
+	struct NO_INTERRUPTS {
+		static constexpr bool scheduled = false;
+	}; // struct NO_INTERRUPTS
+
+	// scheduled interrupts : with a scheduler attached, execute fires its events and takes its IRQ and NMI between instructions
+	struct SCHEDULED_INTERRUPTS {
+		static constexpr bool scheduled = true;
+	}; // struct SCHEDULED_INTERRUPTS
+
+	// computer central processing unit struct, parameterized by policies :
+	// timing (EXACT_TIMING or INSTRUCTION_TIMING), flags (EAGER_FLAGS or LAZY_FLAGS), bus access (PAGED_BUS or FLAT_BUS),
+	// tracing (NO_TRACE or SINK_TRACE) and interrupts (NO_INTERRUPTS or SCHEDULED_INTERRUPTS)
+	// a feature left out by its policy is not compiled in : CPU_T<INSTRUCTION_TIMING, EAGER_FLAGS, FLAT_BUS, NO_TRACE, NO_INTERRUPTS> (MINIMAL_CPU)
+	// runs every instruction without a page table lookup, dirty page or decode cache bookkeeping, a trace call or a scheduler test
+	template <class TIMING, class FLAGS = EAGER_FLAGS, class BUS = PAGED_BUS, class TRACING = DEFAULT_TRACE, class INTERRUPTS = SCHEDULED_INTERRUPTS>
+	struct CPU_T : public REGISTERS {
 		public:
+			// policies of this instantiation, for code templated on the CPU type
+			typedef TIMING TIMING_POLICY;
+			typedef FLAGS FLAGS_POLICY;
+			typedef BUS BUS_POLICY;
+			typedef TRACING TRACING_POLICY;
+			typedef INTERRUPTS INTERRUPTS_POLICY;
+
 			static constexpr bool READ = true;
 			static constexpr bool WRITE = false;
 
@@ -136,7 +561,8 @@ namespace m6502 {
 			static constexpr BYTE ins_adc_zpx = 0x75;	// zero-page X ADD CARRY instruction (2 bytes, 4 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_adc_abs = 0x6D;	// absolute ADD CARRY instruction (3 bytes, 4 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_adc_absx = 0x7D;	// absolute X ADD CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
-			static constexpr BYTE ins_adc_aby = 0x79;	// absolute Y ADD CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
+			static constexpr BYTE ins_adc_absy = 0x79;	// absolute Y ADD CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
+			static constexpr BYTE ins_adc_aby = ins_adc_absy;	// former name of ins_adc_absy
 			static constexpr BYTE ins_adc_indx = 0x61;	// indirect X ADD CARRY instruction (2 bytes, 6 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_adc_indy = 0x71;	// indirect Y ADD CARRY instruction (2 bytes, 5-6 cycles. Affects carry, zero, overflow and negative flags)
 
@@ -145,7 +571,8 @@ namespace m6502 {
 			static constexpr BYTE ins_sbc_zpx = 0xF5;	// zero-page X SUBTRACT CARRY instruction (2 bytes, 4 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_sbc_abs = 0xED;	// absolute SUBTRACT CARRY instruction (3 bytes, 4 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_sbc_absx = 0xFD;	// absolute X SUBTRACT CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
-			static constexpr BYTE ins_sbc_aby = 0xF9;	// absolute Y SUBTRACT CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
+			static constexpr BYTE ins_sbc_absy = 0xF9;	// absolute Y SUBTRACT CARRY instruction (3 bytes, 4-5 cycles. Affects carry, zero, overflow and negative flags)
+			static constexpr BYTE ins_sbc_aby = ins_sbc_absy;	// former name of ins_sbc_absy
 			static constexpr BYTE ins_sbc_indx = 0xE1;	// indirect X SUBTRACT CARRY instruction (2 bytes, 6 cycles. Affects carry, zero, overflow and negative flags)
 			static constexpr BYTE ins_sbc_indy = 0xF1;	// indirect Y SUBTRACT CARRY instruction (2 bytes, 5-6 cycles. Affects carry, zero, overflow and negative flags)
 
@@ -154,7 +581,8 @@ namespace m6502 {
 			static constexpr BYTE ins_cmp_zpx = 0xD5;	// zero-page X COMPARE A instruction (2 bytes, 4 cycles. Affects carry, zero and negative flags)
 			static constexpr BYTE ins_cmp_abs = 0xCD;	// absolute COMPARE A instruction (3 bytes, 4 cycles. Affects carry, zero and negative flags)
 			static constexpr BYTE ins_cmp_absx = 0xDD;	// absolute X COMPARE A instruction (3 bytes, 4-5 cycles. Affects carry, zero and negative flags)
-			static constexpr BYTE ins_cmp_aby = 0xD9;	// absolute Y COMPARE A instruction (3 bytes, 4-5 cycles. Affects carry, zero and negative flags)
+			static constexpr BYTE ins_cmp_absy = 0xD9;	// absolute Y COMPARE A instruction (3 bytes, 4-5 cycles. Affects carry, zero and negative flags)
+			static constexpr BYTE ins_cmp_aby = ins_cmp_absy;	// former name of ins_cmp_absy
 			static constexpr BYTE ins_cmp_indx = 0xC1;	// indirect X COMPARE A instruction (2 bytes, 6 cycles. Affects carry, zero and negative flags)
 			static constexpr BYTE ins_cmp_indy = 0xD1;	// indirect Y COMPARE A instruction (2 bytes, 5-6 cycles. Affects carry, zero and negative flags)
 
@@ -232,11 +660,12 @@ namespace m6502 {
 
 			// sends a reset signal to reset computer state (7 cycles)
 			void reset(uint32_t &cycles, MEMORY &mem) {
+				runStart = cycles;
 				reg_programCounter = 0x0000;
 				reg_stackPointer = 0x00;
 				cycles--;
 				cycles--;
-				fl_carry = fl_zero = fl_interr = fl_dec = fl_oflow = fl_neg = false;
+				reg_status = 0;
 				reg_acc = reg_x = reg_y = 0;
 				// three fake stack accesses to set the stack pointer to 0xFDs
 				rw(mem, reg_stackPointer | 0x0100, READ);
@@ -248,1095 +677,779 @@ namespace m6502 {
 				// stores contents at 0xFFFC and 0xFFFD (little-endian) in program counter (contains location of reset routine)
 				BYTE programCounterLowByte = rw(mem, 0xFFFC, READ);
 				reg_programCounter = littleEndianWord(programCounterLowByte, rw(mem, 0xFFFD, READ));
+				if constexpr (!TIMING::exact) {
+					// the five accesses above are not counted by rw with per-instruction timing
+					cycles -= 5;
+				}
+				cycleClock += (uint32_t)(runStart - cycles);
+			}
+
+			// takes the pending NMI, or else the IRQ, of scheduler (7 cycles). Called by execute between two instructions
+			// pushes program counter and status flags (break bit clear), sets the interrupt flag and jumps through the NMI (0xFFFA) or IRQ (0xFFFE) vector
+			void interrupt(uint32_t &cycles, MEMORY &mem) {
+#ifdef M6502_PROFILE
+				if (profiler != nullptr) {
+					profiler->interrupt(now(mem), reg_programCounter);
+				}
+#endif
+				WORD vector = 0xFFFE;
+				if (scheduler->nmiPending) {
+					scheduler->nmiPending = false;
+					vector = 0xFFFA;
+				}
+				// two internal cycles, then three pushes
+				cycles--;
+				cycles--;
+				rw(mem, reg_stackPointer | 0x0100, WRITE, reg_programCounter >> 8);
+				reg_stackPointer--;
+				rw(mem, reg_stackPointer | 0x0100, WRITE, reg_programCounter & 0xFF);
+				reg_stackPointer--;
+				rw(mem, reg_stackPointer | 0x0100, WRITE, status(0b00100000));
+				reg_stackPointer--;
+				fl_interr = true;
+				BYTE programCounterLowByte = rw(mem, vector, READ);
+				reg_programCounter = littleEndianWord(programCounterLowByte, rw(mem, vector + 1, READ));
+				if constexpr (!TIMING::exact) {
+					// the five accesses above are not counted by rw with per-instruction timing
+					cycles -= 5;
+				}
+				interrupts++;
+			}
+
+			static constexpr int DISPATCH_SWITCH = 0;	// one switch over all opcodes
+			static constexpr int DISPATCH_TABLE = 1;	// indirect call through a 256-entry handler table
+			static constexpr int DISPATCH_THREADED = 2;	// computed goto at the end of every handler (GCC and Clang, falls back to the table elsewhere)
+			static constexpr int DISPATCH_CACHED = 3;	// handler and operand looked up by programCounter in decodeCache, decoded on first execution only
+
+			static constexpr BYTE am_imp = 0;	// implied or accumulator addressing (no operand)
+			static constexpr BYTE am_imm = 1;	// immediate addressing (1-byte operand)
+			static constexpr BYTE am_zp = 2;	// zero-page addressing (1-byte operand)
+			static constexpr BYTE am_zpx = 3;	// zero-page X addressing (1-byte operand)
+			static constexpr BYTE am_zpy = 4;	// zero-page Y addressing (1-byte operand)
+			static constexpr BYTE am_abs = 5;	// absolute addressing (2-byte operand)
+			static constexpr BYTE am_absx = 6;	// absolute X addressing (2-byte operand)
+			static constexpr BYTE am_absy = 7;	// absolute Y addressing (2-byte operand)
+			static constexpr BYTE am_ind = 8;	// indirect addressing (2-byte operand)
+			static constexpr BYTE am_indx = 9;	// indirect X addressing (1-byte operand)
+			static constexpr BYTE am_indy = 10;	// indirect Y addressing (1-byte operand)
+			static constexpr BYTE am_rel = 11;	// relative addressing (1-byte operand)
+
+			// returns the number of operand bytes following the opcode in an addressing mode
+			static constexpr BYTE operandLength(BYTE mode) {
+				return (mode == am_imp ? 0 : (mode == am_abs || mode == am_absx || mode == am_absy || mode == am_ind) ? 2 : 1);
 			}
 
-			// executes instructions at programCounter while cycles is greater than 0
+			// executes instructions at programCounter while cycles is greater than 0, paced by throttle
+			// the dispatch engine is chosen at build time with M6502_DISPATCH (0 : switch, 1 : handler table, 2 : threaded, 3 : cached)
+			// a flat bus has no decode cache checks : it runs the threaded engine where the cached one is chosen
 			void execute(uint32_t &cycles, MEMORY &mem) {
-				while (cycles > 0 && cycles < 0xFFFFFFFA) {
-					BYTE instruction = fetch(mem);
-					switch (instruction) {
-						case ins_lda_im:
-							{
-								reg_acc = fetch(mem);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_zp:
-							{
-								reg_acc = rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_zpx:
-							{
-								reg_acc = rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc = rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc = rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc = rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_indx:
-							{
-								reg_acc = rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lda_indy:
-							{
-								reg_acc = rw(mem, indirectYAddressing(mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ldx_im:
-							{
-								reg_x = fetch(mem);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_ldx_zp:
-							{
-								reg_x = rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_ldx_zpy:
-							{
-								reg_x = rw(mem, zeroPageYAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_ldx_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_x = rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_ldx_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_x = rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_ldy_im:
-							{
-								reg_y = fetch(mem);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_ldy_zp:
-							{
-								reg_y = rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_ldy_zpx:
-							{
-								reg_y = rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_ldy_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_y = rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_ldy_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_y = rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_sta_zp:
-							{
-								rw(mem, fetch(mem), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_zpx:
-							{
-								rw(mem, zeroPageXAddressing(cycles, fetch(mem)), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								rw(mem, littleEndianWord(addressLowByte, fetch(mem)), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)), true), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)), true), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_indx:
-							{
-								rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), WRITE, reg_acc);
-							}
-							break;
-						case ins_sta_indy:
-							{
-								rw(mem, indirectYAddressing(mem, fetch(mem), true), WRITE, reg_acc);
-							}
-							break;
-						case ins_stx_zp:
-							{
-								rw(mem, fetch(mem), WRITE, reg_x);
-							}
-							break;
-						case ins_stx_zpy:
-							{
-								rw(mem, zeroPageYAddressing(cycles, fetch(mem)), WRITE, reg_x);
-							}
-							break;
-						case ins_stx_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								rw(mem, littleEndianWord(addressLowByte, fetch(mem)), WRITE, reg_x);
-							}
-							break;
-						case ins_sty_zp:
-							{
-								rw(mem, fetch(mem), WRITE, reg_y);
-							}
-							break;
-						case ins_sty_zpx:
-							{
-								rw(mem, zeroPageXAddressing(cycles, fetch(mem)), WRITE, reg_y);
-							}
-							break;
-						case ins_sty_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								rw(mem, littleEndianWord(addressLowByte, fetch(mem)), WRITE, reg_y);
-							}
-							break;
-						case ins_tax:
-							{
-								transfer(cycles, reg_acc, reg_x);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_tay:
-							{
-								transfer(cycles, reg_acc, reg_x);
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_txa:
-							{
-								transfer(cycles, reg_x, reg_acc);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_tya:
-							{
-								transfer(cycles, reg_y, reg_acc);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_tsx:
-							{
-								transfer(cycles, reg_stackPointer, reg_x);
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_txs:
-							{
-								transfer(cycles, reg_x, reg_stackPointer);
-								setLoadFlags(reg_stackPointer);
-							}
-							break;
-						case ins_pha:
-							{
-								pushStack(cycles, mem, reg_acc);
-							}
-							break;
-						case ins_php:
-							{
-								// pushes byte with representation NV11DIZC (from flag names, V represents overflow)
-								pushStack(cycles, mem, fl_carry | fl_zero << 1 | fl_interr << 2 | fl_dec << 3 | 0b00110000 | fl_oflow << 6 | fl_neg << 7);
-							}
-							break;
-						case ins_pla:
-							{
-								transfer(cycles, pullStack(cycles, mem), reg_acc);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_plp:
-							{
-								BYTE status = pullStack(cycles, mem);
-								fl_carry = ((status & 0b00000001) > 0);
-								fl_zero = ((status & 0b00000010) > 0);
-								fl_interr = ((status & 0b00000100) > 0);
-								fl_dec = ((status & 0b00001000) > 0);
-								fl_oflow = ((status & 0b01000000) > 0);
-								fl_neg = ((status & 0b10000000) > 0);
-								cycles--;
-							}
-							break;
-						case ins_and_im:
-							{
-								reg_acc &= fetch(mem);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_zp:
-							{
-								reg_acc &= rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_zpx:
-							{
-								reg_acc &= rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc &= rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc &= rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc &= rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_indx:
-							{
-								reg_acc &= rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_and_indy:
-							{
-								reg_acc &= rw(mem, indirectYAddressing(mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_im:
-							{
-								reg_acc ^= fetch(mem);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_zp:
-							{
-								reg_acc ^= rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_zpx:
-							{
-								reg_acc ^= rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc ^= rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc ^= rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc ^= rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_indx:
-							{
-								reg_acc ^= rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_eor_indy:
-							{
-								reg_acc ^= rw(mem, indirectYAddressing(mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_im:
-							{
-								reg_acc |= fetch(mem);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_zp:
-							{
-								reg_acc |= rw(mem, fetch(mem), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_zpx:
-							{
-								reg_acc |= rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc |= rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc |= rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_absy:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_acc |= rw(mem, absoluteYAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_indx:
-							{
-								reg_acc |= rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ora_indy:
-							{
-								reg_acc |= rw(mem, indirectYAddressing(mem, fetch(mem)), READ);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_bit_zp:
-							{
-								BYTE value = fetch(mem);
-								fl_zero = (reg_acc & value == 0);
-								fl_oflow = (value & 0b01000000 > 0);
-								fl_neg = (value & 0b10000000 > 0);
-								cycles--;
-							}
-							break;
-						case ins_bit_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE value = rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ);
-								fl_zero = (reg_acc & value == 0);
-								fl_oflow = (value & 0b01000000 > 0);
-								fl_neg = (value & 0b10000000 > 0);
-								cycles--;
-							}
-							break;
-						case ins_adc_im:
-							{
-								addSetFlags(reg_acc, fetch(mem));
-							}
-							break;
-						case ins_adc_zp:
-							{
-								addSetFlags(reg_acc, rw(mem, fetch(mem), READ));
-							}
-							break;
-						case ins_adc_zpx:
-							{
-								addSetFlags(reg_acc, rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ));
-							}
-							break;
-						case ins_adc_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								addSetFlags(reg_acc, rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ));
-							}
-							break;
-						case ins_adc_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								addSetFlags(reg_acc, rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ));
-							}
-							break;
-						case ins_adc_indx:
-							{
-								addSetFlags(reg_acc, rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_adc_indy:
-							{
-								addSetFlags(reg_acc, rw(mem, indirectYAddressing(mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_sbc_im:
-							{
-								subtractSetFlags(reg_acc, fetch(mem));
-							}
-							break;
-						case ins_sbc_zp:
-							{
-								subtractSetFlags(reg_acc, rw(mem, fetch(mem), READ));
-							}
-							break;
-						case ins_sbc_zpx:
-							{
-								subtractSetFlags(reg_acc, rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ));
-							}
-							break;
-						case ins_sbc_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								subtractSetFlags(reg_acc, rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ));
-							}
-							break;
-						case ins_sbc_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								subtractSetFlags(reg_acc, rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ));
-							}
-							break;
-						case ins_sbc_indx:
-							{
-								subtractSetFlags(reg_acc, rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_sbc_indy:
-							{
-								subtractSetFlags(reg_acc, rw(mem, indirectYAddressing(mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_cmp_im:
-							{
-								compare(reg_acc, fetch(mem));
-							}
-							break;
-						case ins_cmp_zp:
-							{
-								compare(reg_acc, rw(mem, fetch(mem), READ));
-							}
-							break;
-						case ins_cmp_zpx:
-							{
-								compare(reg_acc, rw(mem, zeroPageXAddressing(cycles, fetch(mem)), READ));
-							}
-							break;
-						case ins_cmp_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								compare(reg_acc, rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ));
-							}
-							break;
-						case ins_cmp_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								compare(reg_acc, rw(mem, absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem))), READ));
-							}
-							break;
-						case ins_cmp_indx:
-							{
-								compare(reg_acc, rw(mem, indirectXAddressing(cycles, mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_cmp_indy:
-							{
-								compare(reg_acc, rw(mem, indirectYAddressing(mem, fetch(mem)), READ));
-							}
-							break;
-						case ins_cpx_im:
-							{
-								compare(reg_x, fetch(mem));
-							}
-							break;
-						case ins_cpx_zp:
-							{
-								compare(reg_x, rw(mem, fetch(mem), READ));
-							}
-							break;
-						case ins_cpx_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								compare(reg_x, rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ));
-							}
-							break;
-						case ins_cpy_im:
-							{
-								compare(reg_y, fetch(mem));
-							}
-							break;
-						case ins_cpy_zp:
-							{
-								compare(reg_y, rw(mem, fetch(mem), READ));
-							}
-							break;
-						case ins_cpy_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								compare(reg_y, rw(mem, littleEndianWord(addressLowByte, fetch(mem)), READ));
-							}
-							break;
-						case ins_inc_zp:
-							{
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								value++;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_inc_zpx:
-							{
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								value++;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_inc_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								value++;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_inc_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)), true);
-								BYTE value = rw(mem, address, READ);
-								value++;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_inx:
-							{
-								reg_x++;
-								cycles--;
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_iny:
-							{
-								reg_y++;cycles--;
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_dec_zp:
-							{
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								value--;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_dec_zpx:
-							{
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								value--;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_dec_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								value--;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_dec_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)), true);
-								BYTE value = rw(mem, address, READ);
-								value--;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_dex:
-							{
-								reg_x--;
-								cycles--;
-								setLoadFlags(reg_x);
-							}
-							break;
-						case ins_dey:
-							{
-								reg_y--;
-								cycles--;
-								setLoadFlags(reg_y);
-							}
-							break;
-						case ins_asl_acc:
-							{
-								fl_carry = (reg_acc & 0b10000000 > 0);
-								reg_acc <<= 1;
-								cycles--;
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_asl_zp:
-							{
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_asl_zpx:
-							{
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_asl_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_asl_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_lsr_acc:
-							{
-								fl_carry = (reg_acc & 0b00000001 > 0);
-								reg_acc >>= 1;
-								cycles--;
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_lsr_zp:
-							{
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_lsr_zpx:
-							{
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_lsr_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_lsr_absx:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(value);
-							}
-							break;
-						case ins_rol_acc:
-							{
-								bool carry = fl_carry;
-								fl_carry = (reg_acc & 0b10000000 > 0);
-								reg_acc <<= 1;
-								reg_acc += carry;
-								cycles--;
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_rol_zp:
-							{
-								bool carry = fl_carry;
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								value += carry;
-								cycles--;
-								setLoadFlags(value);
-								rw(mem, address, WRITE, value);
-							}
-							break;
-						case ins_rol_zpx:
-							{
-								bool carry = fl_carry;
-
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-
-								value <<= 1;
-								value += carry;
-								cycles--;
-								setLoadFlags(value);
-								rw(mem, address, WRITE, value);
-							}
-							break;
-						case ins_rol_abs:
-							{
-								bool carry = fl_carry;
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								value += carry;
-								cycles--;
-								setLoadFlags(value);
-								rw(mem, address, WRITE, value);
-							}
-							break;
-						case ins_rol_absx:
-							{
-								bool carry = fl_carry;
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b10000000 > 0);
-								value <<= 1;
-								value += carry;
-								cycles--;
-								setLoadFlags(value);
-								rw(mem, address, WRITE, value);
-							}
-							break;
-						case ins_ror_acc:
-							{
-								bool carry = fl_carry;
-								fl_carry = (reg_acc & 0b00000001 > 0);
-								reg_acc >>= 1;
-								reg_acc |= (carry ? 0b10000000 : 0);
-								cycles--;
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ror_zp:
-							{
-								bool carry = fl_carry;
-								BYTE address = fetch(mem);
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								value |= (carry ? 0b10000000 : 0);
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ror_zpx:
-							{
-								bool carry = fl_carry;
-								BYTE address = zeroPageXAddressing(cycles, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								value |= (carry ? 0b10000000 : 0);
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ror_abs:
-							{
-								bool carry = fl_carry;
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = littleEndianWord(addressLowByte, fetch(mem));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								value |= (carry ? 0b10000000 : 0);
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_ror_absx:
-							{
-								bool carry = fl_carry;
-								BYTE addressLowByte = fetch(mem);
-								BYTE address = absoluteXAddressing(mem, littleEndianWord(addressLowByte, fetch(mem)));
-								BYTE value = rw(mem, address, READ);
-								fl_carry = (value & 0b00000001 > 0);
-								value >>= 1;
-								value |= (carry ? 0b10000000 : 0);
-								cycles--;
-								rw(mem, address, WRITE, value);
-								setLoadFlags(reg_acc);
-							}
-							break;
-						case ins_jmp_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								reg_programCounter = littleEndianWord(addressLowByte, fetch(mem));
-							}
-							break;
-						case ins_jmp_ind:
-							{
-								// on an original 6502, indirect addressing on a page boundary (first byte on 0xxxFF) results in the effective address being taken from FF of that page and 00 of the same page, and not 00 of the next page
-								BYTE addressLowByte = fetch(mem);
-								BYTE addressHighByte = fetch(mem);
-								BYTE effectiveAddressLowByte = rw(mem, addressLowByte | (WORD)(addressHighByte << 8), READ);
-								reg_programCounter = littleEndianWord(effectiveAddressLowByte, rw(mem, addressLowByte | (WORD)(addressHighByte++ << 8), READ));
-							}
-							break;
-						case ins_jsr_abs:
-							{
-								BYTE addressLowByte = fetch(mem);
-								BYTE addressHighByte = fetch(mem);
-								pushStack(cycles, mem, reg_programCounter >> 8);
-								pushStack(cycles, mem, reg_programCounter & 0xFF);
-								reg_programCounter = littleEndianWord(addressLowByte, addressHighByte);
-								// for some reason the 6502 manages to do the instruction in 6 cycles, yet this does it in 7, to incrementing the cycle count
-								cycles++;
-							}
-							break;
-						case ins_rts:
-							{
-								BYTE addressLowByte = pullStack(cycles, mem);
-								reg_programCounter = littleEndianWord(addressLowByte, pullStack(cycles, mem));
-								reg_stackPointer++;
-								// extra cycle to arrive at 6 cycles
-								cycles--;
-							}
-							break;
-						case ins_bcc:
-							{
-								branch(cycles, fetch(mem), fl_carry, false);
-							}
-							break;
-						case ins_bcs:
-							{
-								branch(cycles, fetch(mem), fl_carry, true);
-							}
-							break;
-						case ins_beq:
-							{
-								branch(cycles, fetch(mem), fl_zero, true);
-							}
-							break;
-						case ins_bmi:
-							{
-								branch(cycles, fetch(mem), fl_neg, true);
-							}
-							break;
-						case ins_bne:
-							{
-								branch(cycles, fetch(mem), fl_zero, false);
-							}
-							break;
-						case ins_bpl:
-							{
-								branch(cycles, fetch(mem), fl_neg, false);
-							}
-							break;
-						case ins_bvc:
-							{
-								branch(cycles, fetch(mem), fl_oflow, false);
-							}
-							break;
-						case ins_bvs:
-							{
-								branch(cycles, fetch(mem), fl_oflow, true);
-							}
-							break;
-						case ins_clc:
-							{
-								fl_carry = false;
-							}
-							break;
-						case ins_cld:
-							{
-								fl_dec = false;
-							}
-							break;
-						case ins_cli:
-							{
-								fl_interr = false;
-							}
-							break;
-						case ins_clv:
-							{
-								fl_oflow = false;
-							}
-							break;
-						case ins_sec:
-							{
-								fl_carry = true;
-							}
-							break;
-						case ins_sed:
-							{
-								fl_dec = true;
-							}
-							break;
-						case ins_sei:
-							{
-								fl_interr = true;
-							}
-							break;
-						case ins_brk:
-							{
-								cycles--;
-								cycles--;
-								// pushes program counter and status flags on the stack
-								rw(mem, reg_stackPointer | 0x0100, WRITE, (reg_programCounter + 1) >> 8);
-								reg_stackPointer--;
-								rw(mem, reg_stackPointer | 0x0100, WRITE, (reg_programCounter + 1) & 0xFF);
-								reg_stackPointer--;
-								rw(mem, reg_stackPointer | 0x0100, WRITE, (fl_carry | fl_zero << 1 | fl_interr << 2 | fl_dec << 3 | 0b00110000 | fl_oflow << 6 | fl_neg << 7));
-								reg_stackPointer--;
-								// stores contents of 0xFFFE and 0xFFFF in the program counter
-								reg_programCounter = littleEndianWord(rw(mem, 0xFFFE, READ), rw(mem, 0xFFFF, READ));
-							}
-							break;
-						case ins_nop:
-							{
-								cycles--;
-							}
-							break;
-						case ins_rti:
-							{
-								cycles--;
-								cycles--;
-								cycles--;
-								// sets program counter and status flags from stack
-								BYTE flags = rw(mem, reg_stackPointer | 0x0100, READ);
-								reg_stackPointer++;
-								fl_carry = (flags & 0b00000001);
-								fl_zero = (flags & 0b00000010);
-								fl_interr = (flags & 0b00000100);
-								fl_dec = (flags & 0b00001000);
-								fl_oflow = (flags &0b01000000);
-								fl_neg = (flags & 0b10000000);
-								BYTE programCounterLowByte = rw(mem, reg_stackPointer | 0x0100, READ);
-								reg_stackPointer++;
-								reg_programCounter = littleEndianWord(programCounterLowByte, rw(mem, reg_stackPointer | 0x0100, READ));
-								reg_stackPointer++;
+				if constexpr (!BUS::paged && M6502_DISPATCH == DISPATCH_CACHED) {
+					executeWith<DISPATCH_THREADED>(cycles, mem);
+				} else {
+					executeWith<M6502_DISPATCH>(cycles, mem);
+				}
+			}
+
+			// same as execute, with an explicit dispatch engine (DISPATCH_SWITCH, DISPATCH_TABLE, DISPATCH_THREADED or DISPATCH_CACHED)
+			// with a scheduler attached, runs slices of instructions up to the next event, and fires events and takes interrupts between them
+			template <int DISPATCH>
+			void executeWith(uint32_t &cycles, MEMORY &mem) {
+				static_assert(BUS::paged || DISPATCH != DISPATCH_CACHED, "the decode cache needs the write checks of the paged bus");
+				uint32_t startCycles = runStart = cycles;
+				uint64_t instructions = 0;
+				uint64_t skippedAtStart = idleLoop.skippedInstructions;
+				// memory may have changed since the last run : a loop must be seen twice again before it is skipped
+				idleLoop.key = UINT64_MAX;
+				THROTTLE::CLOCK::time_point startTime = THROTTLE::CLOCK::now();
+				throttle.start();
+				loadLazyFlags();
+				if (!scheduled()) {
+					instructions = dispatch<DISPATCH>(cycles, mem, startCycles);
+					cycleClock += (uint32_t)(startCycles - cycles);
+				} else {
+					// cycles holds the budget of each slice (the memory counts on it), remaining the rest of the run
+					uint32_t remaining = cycles;
+					while (remaining > 0 && remaining < 0xFFFFFFFA) {
+						uint32_t fired = scheduler->runDue(cycleClock);
+						bool interrupted = scheduler->nmiPending || (scheduler->irqAsserted() && !fl_interr);
+						if (fired > 0 || interrupted) {
+							// events may change what an idle loop reads, and interrupts lengthen its pass
+							idleLoop.key = UINT64_MAX;
+						}
+						// a slice ends at the next event. An interrupt sequence is a slice of its own
+						uint32_t slice = remaining;
+						uint64_t next = scheduler->nextTime();
+						if (!interrupted && next - cycleClock < slice) {
+							slice = (uint32_t)(next - cycleClock);
+						}
+						cycles = runStart = slice;
+						scheduler->enter(&cycles, cycleClock);
+						if (interrupted) {
+							interrupt(cycles, mem);
+						} else {
+							// throttle counts from the start of the run
+							instructions += dispatch<DISPATCH>(cycles, mem, startCycles - remaining + slice);
+						}
+						// cycles wraps below 0 when the last instruction overruns the slice. A cut slice stopped at 0 without running the cut cycles
+						uint32_t used = slice - scheduler->leave() - cycles;
+						cycleClock += used;
+						remaining -= used;
+					}
+					cycles = remaining;
+				}
+				storeLazyFlags();
+#ifdef M6502_PROFILE
+				if (profiler != nullptr) {
+					profiler->finish(cycleClock);
+				}
+#endif
+				stats.instructions = instructions + idleLoop.skippedInstructions - skippedAtStart;
+				stats.cycles = (uint32_t)(startCycles - cycles);
+				stats.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE::CLOCK::now() - startTime);
+			}
+
+			// runs the instructions of one run or slice on the DISPATCH engine while cycles is greater than 0. Returns the instructions executed
+			// startCycles is the budget throttle counts the elapsed cycles from
+			template <int DISPATCH>
+			uint64_t dispatch(uint32_t &cycles, MEMORY &mem, uint32_t startCycles) {
+				uint64_t instructions = 0;
+				// handlers count internal cycles on handlerCycles : the budget itself with cycle-exact timing, a discarded counter otherwise
+				uint32_t discardedCycles = 0;
+				uint32_t &handlerCycles = (TIMING::exact ? cycles : discardedCycles);
+				BYTE instruction;
+#if defined(__GNUC__)
+				if constexpr (DISPATCH == DISPATCH_THREADED) {
+					void *labels[256];
+					for (int i = 0; i < 256; i++) {
+						labels[i] = &&threaded_illegal;
+					}
+					M6502_OPCODES(M6502_THREADED_LABEL)
+					M6502_THREADED_DISPATCH
+					M6502_OPCODES(M6502_THREADED_HANDLER)
+				threaded_illegal:
+					op<NOP, am_imp>(handlerCycles, mem, 0);
+					M6502_THREADED_NEXT
+				threaded_done:
+					;
+				} else
+#endif
+				if constexpr (DISPATCH == DISPATCH_SWITCH) {
+					while (cycles > 0 && cycles < 0xFFFFFFFA) {
+						instructions++;
+						dispatchSwitch(cycles, mem);
+						throttle.sync((uint32_t)(startCycles - cycles));
+					}
+				} else if constexpr (DISPATCH == DISPATCH_CACHED) {
+					if (&mem != decodeCache.memory) {
+						decodeCache.clear();
+						decodeCache.memory = &mem;
+					}
+					while (cycles > 0 && cycles < 0xFFFFFFFA) {
+						instructions++;
+						const DECODED *decoded = lookupDecoded(mem);
+						if (M6502_LIKELY(decoded != nullptr)) {
+							BYTE baseCycles = decoded->cycles;
+							replayFetch(cycles, mem, *decoded);
+							switch (decoded->opcode) {
+								M6502_OPCODES(M6502_CACHED_CASE)
+								default:
+									op<NOP, am_imp>(handlerCycles, mem, 0);
+							}
+							if constexpr (!TIMING::exact) {
+								cycles -= baseCycles + penaltyCycles;
+								penaltyCycles = 0;
+							}
+						} else {
+							// code read from a device page is fetched and decoded every time
+							dispatchSwitch(cycles, mem);
+						}
+						throttle.sync((uint32_t)(startCycles - cycles));
+					}
+				} else {
+					static constexpr std::array<HANDLER, 256> table = handlerTable();
+					while (cycles > 0 && cycles < 0xFFFFFFFA) {
+						instructions++;
+						instruction = fetchOpcode(mem);
+						const HANDLER &handler = table[instruction];
+						(this->*handler.execute)(handlerCycles, mem, fetchOperand(mem, handler.operandLength));
+						chargeInstruction(cycles, instruction);
+						throttle.sync((uint32_t)(startCycles - cycles));
+					}
+				}
+				return instructions;
+			}
+
+			// executes exactly one instruction, whatever the remaining cycles
+			void step(uint32_t &cycles, MEMORY &mem) {
+				runStart = cycles;
+				loadLazyFlags();
+				dispatchSwitch(cycles, mem);
+				storeLazyFlags();
+				cycleClock += (uint32_t)(runStart - cycles);
+			}
+
+			// saved machine : registers, flags, emulated time and a copy-on-write snapshot of memory
+			struct STATE {
+				REGISTERS registers;
+				uint64_t cycleClock;
+				MEMORY::SNAPSHOT memory;
+			}; // struct STATE
+
+			// saves the machine between two runs. Costs one page copy per page written since the last save or restore
+			STATE save(MEMORY &mem) {
+				static_assert(BUS::paged, "snapshots need the dirty pages of the paged bus");
+				STATE state;
+				std::memcpy(&state.registers, static_cast<REGISTERS *>(this), sizeof(REGISTERS));
+				state.cycleClock = cycleClock;
+				state.memory = mem.save();
+				return state;
+			}
+
+			// puts the machine back as it was at save. Costs one page copy per page that differs from state
+			void restore(const STATE &state, MEMORY &mem) {
+				static_assert(BUS::paged, "snapshots need the dirty pages of the paged bus");
+				std::memcpy(static_cast<REGISTERS *>(this), &state.registers, sizeof(REGISTERS));
+				cycleClock = state.cycleClock;
+				mem.restore(state.memory);
+			}
+
+			// fetches and executes one instruction through the switch engine
+			void dispatchSwitch(uint32_t &cycles, MEMORY &mem) {
+				uint32_t discardedCycles = 0;
+				uint32_t &handlerCycles = (TIMING::exact ? cycles : discardedCycles);
+				BYTE instruction = fetchOpcode(mem);
+				switch (instruction) {
+					M6502_OPCODES(M6502_SWITCH_CASE)
+					default:
+						op<NOP, am_imp>(handlerCycles, mem, 0);
+				}
+				chargeInstruction(cycles, instruction);
+			}
+
+			// entry of the handler table dispatch engine
+			struct HANDLER {
+				void (CPU_T::*execute)(uint32_t &cycles, MEMORY &mem, WORD operand);	// instruction handler
+				BYTE operandLength;															// operand bytes fetched before calling the handler
+			}; // struct HANDLER
+
+			// builds the 256-entry handler table. Unimplemented opcodes do nothing
+			static constexpr std::array<HANDLER, 256> handlerTable() {
+				std::array<HANDLER, 256> table{};
+				for (HANDLER &handler : table) {
+					handler = {&CPU_T::op<NOP, am_imp>, 0};
+				}
+				M6502_OPCODES(M6502_TABLE_ENTRY)
+				return table;
+			}
+
+			// instruction decoded by the cached dispatch engine. The opcode selects the handler through a switch (cheaper than a call through a member pointer)
+			struct DECODED {
+				WORD operand;			// operand bytes (little-endian)
+				BYTE opcode;
+				BYTE operandLength;
+				BYTE cycles;			// base cost (see cycleTable)
+				bool valid;
+			}; // struct DECODED
+
+			// decoded instructions by programCounter, allocated one 256-byte page at a time
+			// a write through rw to a page holding cached code drops the page (and the instructions of the previous page running into it),
+			// a change of MEMORY::generation (bank switch, fill, restore, direct access) or of memory drops everything
+			struct DECODE_CACHE {
+				public:
+					typedef std::array<DECODED, MEMORY::PAGE_SIZE> PAGE;
+
+					DECODE_CACHE() {}
+
+					// copies of a CPU start with an empty cache
+					DECODE_CACHE(const DECODE_CACHE &other) {}
+
+					DECODE_CACHE &operator=(const DECODE_CACHE &other) {
+						clear();
+						return *this;
+					}
+
+					// drops every decoded instruction
+					void clear() {
+						for (uint32_t page = 0; page < MEMORY::PAGES; page++) {
+							if (code[page]) {
+								invalidate(page);
 							}
+						}
+					}
+
+					// drops the instructions starting in page, and those starting at the end of the previous page that run into it
+					void invalidate(BYTE page) {
+						if (pages[page] != nullptr) {
+							for (DECODED &decoded : *pages[page]) {
+								decoded.valid = false;
+							}
+						}
+						BYTE previous = page - 1;
+						if (pages[previous] != nullptr) {
+							(*pages[previous])[0xFE].valid = false;
+							(*pages[previous])[0xFF].valid = false;
+						}
+						code[page] = false;
+						invalidations++;
+					}
+
+					std::array<std::unique_ptr<PAGE>, MEMORY::PAGES> pages;	// decoded instructions of each page, nullptr until code runs there
+					bool code[MEMORY::PAGES] = {};							// pages holding bytes of a valid decoded instruction
+					const MEMORY *memory = nullptr;							// memory the instructions were decoded from
+					uint32_t generation = 0;								// MEMORY::generation at decoding time
+
+					uint64_t hits = 0;				// instructions run from the cache
+					uint64_t misses = 0;			// instructions decoded
+					uint64_t invalidations = 0;		// pages dropped
+			}; // struct DECODE_CACHE
+
+			// returns the decoded instruction at programCounter, decoding it on a miss. Returns nullptr for code in device pages
+			const DECODED *lookupDecoded(MEMORY &mem) {
+				if (mem.generation() != decodeCache.generation) {
+					decodeCache.clear();
+					decodeCache.generation = mem.generation();
+				}
+				const std::unique_ptr<typename DECODE_CACHE::PAGE> &page = decodeCache.pages[reg_programCounter >> 8];
+				if (M6502_LIKELY(page != nullptr)) {
+					const DECODED &decoded = (*page)[reg_programCounter & 0xFF];
+					if (M6502_LIKELY(decoded.valid)) {
+						decodeCache.hits++;
+						return &decoded;
 					}
-					std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 				}
+				return decode(mem);
 			}
 
-			WORD reg_programCounter;	// 16-bit program counter register
-			BYTE reg_stackPointer;		// 8-bit stack pointer register
-			BYTE reg_acc;				// 8-bit accumulator register
-			BYTE reg_x;					// 8-bit x register
-			BYTE reg_y;					// 8-bit y register
+			// decodes the instruction at programCounter into decodeCache without counting cycles
+			M6502_NOINLINE const DECODED *decode(MEMORY &mem) {
+				static constexpr std::array<HANDLER, 256> handlers = handlerTable();
+				static constexpr std::array<BYTE, 256> costs = cycleTable();
+				WORD address = reg_programCounter;
+				if (devicePage(mem, address >> 8)) {
+					return nullptr;
+				}
+				BYTE opcode = peek(mem, address);
+				const HANDLER &handler = handlers[opcode];
+				WORD last = address + handler.operandLength;
+				if (devicePage(mem, last >> 8)) {
+					return nullptr;
+				}
+				WORD operand = 0;
+				if (handler.operandLength == 1) {
+					operand = peek(mem, address + 1);
+				} else if (handler.operandLength == 2) {
+					operand = littleEndianWord(peek(mem, address + 1), peek(mem, address + 2));
+				}
+				std::unique_ptr<typename DECODE_CACHE::PAGE> &page = decodeCache.pages[address >> 8];
+				if (page == nullptr) {
+					page = std::make_unique<typename DECODE_CACHE::PAGE>();
+				}
+				DECODED &decoded = (*page)[address & 0xFF];
+				decoded = {operand, opcode, handler.operandLength, costs[opcode], true};
+				decodeCache.code[address >> 8] = true;
+				decodeCache.code[last >> 8] = true;
+				decodeCache.misses++;
+				return &decoded;
+			}
 
-			BYTE fl_carry:1;			// 1-bit carry flag
-			BYTE fl_zero:1;				// 1-bit zero flag
-			BYTE fl_interr:1;			// 1-bit interrupt flag
-			BYTE fl_dec:1;				// 1-bit decimal flag
-										// during a processor status stack push, bit 4 is set to 1 if pushed from a PHP or BRK instruction or to 0 if pushed from an /IRQ or /NMI signal being pulled low
-										// during a processor status stack push, bit 5 is always set to 1
-			BYTE fl_oflow:1;			// 1-bit overflow flag
-			BYTE fl_neg:1;				// 1-bit negative flag
+			// accounts for the fetches of a cached instruction as if they were done : programCounter, fetch cycles with cycle-exact timing and trace records
+			void replayFetch(uint32_t &cycles, MEMORY &mem, const DECODED &decoded) {
+#ifdef M6502_PROFILE
+				if (profiler != nullptr) {
+					profiler->instruction(now(mem), reg_programCounter, decoded.opcode);
+				}
+#endif
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr) {
+					histogram->instruction(decoded.opcode);
+				}
+#endif
+				if constexpr (TRACING::traced) {
+					traceSink->instruction(now(mem), reg_programCounter);
+					BYTE bytes[3] = {decoded.opcode, (BYTE)(decoded.operand & 0xFF), (BYTE)(decoded.operand >> 8)};
+					for (BYTE i = 0; i <= decoded.operandLength; i++) {
+						if constexpr (TIMING::exact) {
+							cycles--;
+						}
+						traceSink->access(now(mem), reg_programCounter + i, READ, bytes[i]);
+					}
+				} else if constexpr (TIMING::exact) {
+					cycles -= 1 + decoded.operandLength;
+				}
+				reg_programCounter += 1 + decoded.operandLength;
+			}
+
+			// what an opcode does, from its M6502_OPCODES entry
+			struct DESCRIPTOR {
+				BYTE operation;		// OPERATION
+				BYTE mode;			// addressing mode (am_*)
+				BYTE cycles;		// base cost, without page-cross and branch penalties
+			}; // struct DESCRIPTOR
+
+			// builds the 256-entry opcode descriptor table. Unimplemented opcodes are a 2-cycle implied NOP (see op)
+			static constexpr std::array<DESCRIPTOR, 256> descriptorTable() {
+				std::array<DESCRIPTOR, 256> table{};
+				for (DESCRIPTOR &descriptor : table) {
+					descriptor = {NOP, am_imp, 2};
+				}
+				M6502_OPCODES(M6502_DESCRIPTOR_ENTRY)
+				return table;
+			}
+
+			// builds the 256-entry table of base instruction costs (the cycles column of descriptorTable)
+			static constexpr std::array<BYTE, 256> cycleTable() {
+				std::array<DESCRIPTOR, 256> descriptors = descriptorTable();
+				std::array<BYTE, 256> table{};
+				for (uint32_t opcode = 0; opcode < 256; opcode++) {
+					table[opcode] = descriptors[opcode].cycles;
+				}
+				return table;
+			}
+
+			// builds the 256-entry table of addressing modes (the mode column of descriptorTable)
+			static constexpr std::array<BYTE, 256> modeTable() {
+				std::array<DESCRIPTOR, 256> descriptors = descriptorTable();
+				std::array<BYTE, 256> table{};
+				for (uint32_t opcode = 0; opcode < 256; opcode++) {
+					table[opcode] = descriptors[opcode].mode;
+				}
+				return table;
+			}
+
+			// skips of idle loops (see loopBack)
+			struct IDLE_LOOP {
+				bool enabled = true;				// false runs every pass of every loop
+				uint64_t key = UINT64_MAX;			// loop and state of the last backward branch or jump
+				uint64_t clock = 0;					// emulated time of that branch or jump (see now)
+				bool rejected = false;				// the loop of key cannot be skipped (see idleBody)
+
+				uint64_t skips = 0;					// fast-forwards done
+				uint64_t skippedCycles = 0;			// cycles charged by them
+				uint64_t skippedInstructions = 0;	// instructions they stand for
+			}; // struct IDLE_LOOP
+
+			// charges an instruction its base cost and penalties with per-instruction timing (cycle-exact timing has already counted them)
+			void chargeInstruction(uint32_t &cycles, BYTE opcode) {
+				if constexpr (!TIMING::exact) {
+					static constexpr std::array<BYTE, 256> table = cycleTable();
+					cycles -= table[opcode] + penaltyCycles;
+					penaltyCycles = 0;
+				}
+			}
+
+			// counts page-cross and branch cycles with per-instruction timing (cycle-exact timing counts them as they happen)
+			void addPenalty(BYTE count) {
+				if constexpr (!TIMING::exact) {
+					penaltyCycles += count;
+				}
+			}
+
+			// fetches the operand of the current instruction (LENGTH bytes, little-endian). Same cost as the fetches done by the handlers themselves
+			template <BYTE LENGTH>
+			WORD fetchOperand(MEMORY &mem) {
+				if constexpr (LENGTH == 0) {
+					return 0;
+				} else if constexpr (LENGTH == 1) {
+					return fetch(mem);
+				} else {
+					BYTE lowByte = fetch(mem);
+					return littleEndianWord(lowByte, fetch(mem));
+				}
+			}
+
+			// runtime version of fetchOperand, used by the handler table
+			WORD fetchOperand(MEMORY &mem, BYTE length) {
+				switch (length) {
+					case 1:
+						return fetchOperand<1>(mem);
+					case 2:
+						return fetchOperand<2>(mem);
+				}
+				return 0;
+			}
+
+			// instruction handlers, one per operation and addressing mode of M6502_OPCODES. The operand bytes have already been fetched by the dispatch engine (1 cycle each)
+			// every mode of an operation runs the same body : the mode only chooses how the operand is reached (see load and effectiveAddress)
+			// unimplemented opcodes run op<NOP, am_imp>
+			template <OPERATION OP, BYTE MODE>
+			void op(uint32_t &cycles, MEMORY &mem, WORD operand) {
+				if constexpr (OP == LDA || OP == LDX || OP == LDY) {
+					BYTE &reg = operationRegister<OP>();
+					reg = load<MODE>(cycles, mem, operand);
+					setLoadFlags(reg);
+				} else if constexpr (OP == STA || OP == STX || OP == STY) {
+					rw(mem, effectiveAddress<MODE>(cycles, mem, operand, true), WRITE, operationRegister<OP>());
+				} else if constexpr (OP == TAX) {
+					transfer(cycles, reg_acc, reg_x);
+					setLoadFlags(reg_x);
+				} else if constexpr (OP == TAY) {
+					transfer(cycles, reg_acc, reg_y);
+					setLoadFlags(reg_y);
+				} else if constexpr (OP == TXA) {
+					transfer(cycles, reg_x, reg_acc);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == TYA) {
+					transfer(cycles, reg_y, reg_acc);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == TSX) {
+					transfer(cycles, reg_stackPointer, reg_x);
+					setLoadFlags(reg_x);
+				} else if constexpr (OP == TXS) {
+					// the only transfer that leaves the flags alone
+					transfer(cycles, reg_x, reg_stackPointer);
+				} else if constexpr (OP == PHA) {
+					pushStack(cycles, mem, reg_acc);
+				} else if constexpr (OP == PHP) {
+					// pushes byte with representation NV11DIZC (from flag names, V represents overflow)
+					pushStack(cycles, mem, status(0b00110000));
+				} else if constexpr (OP == PLA) {
+					transfer(cycles, pullStack(cycles, mem), reg_acc);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == PLP) {
+					setStatus(pullStack(cycles, mem));
+					cycles--;
+					unmaskIrq();
+				} else if constexpr (OP == AND) {
+					reg_acc &= load<MODE>(cycles, mem, operand);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == EOR) {
+					reg_acc ^= load<MODE>(cycles, mem, operand);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == ORA) {
+					reg_acc |= load<MODE>(cycles, mem, operand);
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == BIT) {
+					// zero from A AND value, overflow and negative from bits 6 and 7 of value
+					BYTE value = load<MODE>(cycles, mem, operand);
+					setZeroFlag((reg_acc & value) == 0);
+					setOverflowFlag(value >> 6);
+					setNegativeFlag(value >> 7);
+				} else if constexpr (OP == ADC) {
+					addSetFlags(reg_acc, load<MODE>(cycles, mem, operand));
+				} else if constexpr (OP == SBC) {
+					subtractSetFlags(reg_acc, load<MODE>(cycles, mem, operand));
+				} else if constexpr (OP == CMP || OP == CPX || OP == CPY) {
+					compare(operationRegister<OP>(), load<MODE>(cycles, mem, operand));
+				} else if constexpr ((OP == INC || OP == DEC || OP == ASL || OP == LSR || OP == ROL || OP == ROR) && MODE == am_imp) {
+					// shifts and rotates of A (1 internal cycle)
+					reg_acc = modify<OP>(reg_acc);
+					cycles--;
+					setLoadFlags(reg_acc);
+				} else if constexpr (OP == INC || OP == DEC || OP == ASL || OP == LSR || OP == ROL || OP == ROR) {
+					// read-modify-write : the indexed forms always take the extra addressing cycle, then one cycle modifies the value read
+					WORD address = effectiveAddress<MODE>(cycles, mem, operand, true);
+					BYTE value = modify<OP>(rw(mem, address, READ));
+					cycles--;
+					rw(mem, address, WRITE, value);
+					setLoadFlags(value);
+				} else if constexpr (OP == INX || OP == DEX) {
+					reg_x = modify<(OP == INX ? INC : DEC)>(reg_x);
+					cycles--;
+					setLoadFlags(reg_x);
+				} else if constexpr (OP == INY || OP == DEY) {
+					reg_y = modify<(OP == INY ? INC : DEC)>(reg_y);
+					cycles--;
+					setLoadFlags(reg_y);
+				} else if constexpr (OP == JMP && MODE == am_abs) {
+					loopBack(cycles, mem, reg_programCounter - 3, operand);
+					reg_programCounter = operand;
+				} else if constexpr (OP == JMP) {
+					// on an original 6502, indirect addressing on a page boundary (first byte on 0xxxFF) results in the effective address being taken from FF of that page and 00 of the same page, and not 00 of the next page
+					BYTE effectiveAddressLowByte = rw(mem, operand, READ);
+					reg_programCounter = littleEndianWord(effectiveAddressLowByte, rw(mem, (operand & 0xFF00) | (BYTE)(operand + 1), READ));
+				} else if constexpr (OP == JSR) {
+					// one internal cycle, then the return address is pushed with two writes (6 cycles in total)
+					cycles--;
+					rw(mem, reg_stackPointer | 0x0100, WRITE, reg_programCounter >> 8);
+					reg_stackPointer--;
+					rw(mem, reg_stackPointer | 0x0100, WRITE, reg_programCounter & 0xFF);
+					reg_stackPointer--;
+					reg_programCounter = operand;
+				} else if constexpr (OP == RTS) {
+					BYTE addressLowByte = pullStack(cycles, mem);
+					reg_programCounter = littleEndianWord(addressLowByte, pullStack(cycles, mem));
+					// extra cycle to arrive at 6 cycles
+					cycles--;
+				} else if constexpr (OP == BCC || OP == BCS) {
+					branch(cycles, mem, operand, carryFlag(), OP == BCS);
+				} else if constexpr (OP == BEQ || OP == BNE) {
+					branch(cycles, mem, operand, zeroFlag(), OP == BEQ);
+				} else if constexpr (OP == BMI || OP == BPL) {
+					branch(cycles, mem, operand, negativeFlag(), OP == BMI);
+				} else if constexpr (OP == BVC || OP == BVS) {
+					branch(cycles, mem, operand, overflowFlag(), OP == BVS);
+				} else if constexpr (OP == CLC || OP == SEC) {
+					setCarryFlag(OP == SEC);
+					cycles--;
+				} else if constexpr (OP == CLD || OP == SED) {
+					fl_dec = (OP == SED);
+					cycles--;
+				} else if constexpr (OP == CLI) {
+					fl_interr = false;
+					cycles--;
+					unmaskIrq();
+				} else if constexpr (OP == SEI) {
+					fl_interr = true;
+					cycles--;
+				} else if constexpr (OP == CLV) {
+					setOverflowFlag(false);
+					cycles--;
+				} else if constexpr (OP == BRK) {
+					// padding byte read
+					cycles--;
+					// pushes program counter and status flags on the stack
+					rw(mem, reg_stackPointer | 0x0100, WRITE, (reg_programCounter + 1) >> 8);
+					reg_stackPointer--;
+					rw(mem, reg_stackPointer | 0x0100, WRITE, (reg_programCounter + 1) & 0xFF);
+					reg_stackPointer--;
+					rw(mem, reg_stackPointer | 0x0100, WRITE, status(0b00110000));
+					reg_stackPointer--;
+					// stores contents of 0xFFFE and 0xFFFF in the program counter
+					reg_programCounter = littleEndianWord(rw(mem, 0xFFFE, READ), rw(mem, 0xFFFF, READ));
+				} else if constexpr (OP == RTI) {
+					cycles--;
+					cycles--;
+					// sets status flags and program counter from stack (pushed by BRK or an interrupt : program counter high byte, low byte, then status)
+					reg_stackPointer++;
+					setStatus(rw(mem, reg_stackPointer | 0x0100, READ));
+					reg_stackPointer++;
+					BYTE programCounterLowByte = rw(mem, reg_stackPointer | 0x0100, READ);
+					reg_stackPointer++;
+					reg_programCounter = littleEndianWord(programCounterLowByte, rw(mem, reg_stackPointer | 0x0100, READ));
+					unmaskIrq();
+				} else {
+					static_assert(OP == NOP, "operation without a handler");
+					cycles--;
+				}
+			}
+
+			// returns the register an operation loads, stores or compares
+			template <OPERATION OP>
+			BYTE &operationRegister() {
+				if constexpr (OP == LDX || OP == STX || OP == CPX) {
+					return reg_x;
+				} else if constexpr (OP == LDY || OP == STY || OP == CPY) {
+					return reg_y;
+				} else {
+					return reg_acc;
+				}
+			}
+
+			// returns the value read by an instruction in addressing mode MODE : the operand itself in immediate mode, the byte at its effective address otherwise
+			template <BYTE MODE>
+			BYTE load(uint32_t &cycles, MEMORY &mem, WORD operand) {
+				if constexpr (MODE == am_imm) {
+					return operand;
+				} else {
+					return rw(mem, effectiveAddress<MODE>(cycles, mem, operand), READ);
+				}
+			}
+
+			// returns the effective address of operand in addressing mode MODE, through the addressing helpers below (0 to 3 cycles)
+			// extraCycle : the indexed modes always take their page-cross cycle (stores and read-modify-writes)
+			template <BYTE MODE>
+			WORD effectiveAddress(uint32_t &cycles, MEMORY &mem, WORD operand, bool extraCycle = false) {
+				if constexpr (MODE == am_zpx) {
+					return zeroPageXAddressing(cycles, operand);
+				} else if constexpr (MODE == am_zpy) {
+					return zeroPageYAddressing(cycles, operand);
+				} else if constexpr (MODE == am_absx) {
+					return absoluteXAddressing(mem, operand, extraCycle);
+				} else if constexpr (MODE == am_absy) {
+					return absoluteYAddressing(mem, operand, extraCycle);
+				} else if constexpr (MODE == am_indx) {
+					return indirectXAddressing(cycles, mem, operand);
+				} else if constexpr (MODE == am_indy) {
+					return indirectYAddressing(mem, operand, extraCycle);
+				} else {
+					static_assert(MODE == am_zp || MODE == am_abs, "addressing mode without an effective address");
+					return operand;
+				}
+			}
+
+			// returns value modified by an increment, decrement, shift or rotate, and sets the carry flag of the shifts and rotates (0 cycles)
+			template <OPERATION OP>
+			BYTE modify(BYTE value) {
+				if constexpr (OP == INC) {
+					return value + 1;
+				} else if constexpr (OP == DEC) {
+					return value - 1;
+				} else if constexpr (OP == ASL) {
+					setCarryFlag(value >> 7);
+					return value << 1;
+				} else if constexpr (OP == LSR) {
+					setCarryFlag(value);
+					return value >> 1;
+				} else if constexpr (OP == ROL) {
+					BYTE carry = carryFlag();
+					setCarryFlag(value >> 7);
+					return value << 1 | carry;
+				} else {
+					static_assert(OP == ROR, "operation without a modified value");
+					BYTE carry = carryFlag();
+					setCarryFlag(value);
+					return value >> 1 | carry << 7;
+				}
+			}
+
+			THROTTLE throttle;			// real-time pacing of execute (frequency, batch size, lag and jitter counters)
+			RUN_STATS stats;			// instructions, cycles and host time of the last execute run
+			DECODE_CACHE decodeCache;	// decoded instructions of the cached dispatch engine (empty with the other engines)
+			IDLE_LOOP idleLoop;			// idle loop detection and counters of the passes skipped
+			SCHEDULER *scheduler = nullptr;	// events and interrupt lines (nullptr : none, execute runs without slicing. Ignored with NO_INTERRUPTS)
+			uint64_t interrupts = 0;	// NMI and IRQ sequences taken
+			uint64_t cycleClock = 0;	// cycles elapsed before the current run (absolute emulated time)
+			uint32_t runStart = 0;		// cycle budget at the start of the current run (reset or execute)
+			TRACE_SINK *traceSink = &nullTraceSink;	// receives every bus access (only called with SINK_TRACE)
+#ifdef M6502_PROFILE
+			PROFILER *profiler = nullptr;			// counts instructions, cycles and calls (only compiled in with M6502_PROFILE, nullptr : not profiled)
+#endif
+#ifdef M6502_HISTOGRAM
+			HISTOGRAM *histogram = nullptr;			// counts opcodes, page crosses and branches (only compiled in with M6502_HISTOGRAM, nullptr : not counted)
+#endif
+			// registers and flags (reg_* and fl_*) are inherited from REGISTERS
+			// with LAZY_FLAGS, carry, zero, overflow and negative are only up to date between runs (see lazyFlags)
+
+			// returns true if bus accesses are reported to a trace sink (SINK_TRACE with a sink attached)
+			bool traced() const {
+				return TRACING::traced && traceSink != &nullTraceSink;
+			}
+
+			// returns true if execute runs under a scheduler (SCHEDULED_INTERRUPTS with a scheduler attached)
+			bool scheduled() const {
+				return INTERRUPTS::scheduled && scheduler != nullptr;
+			}
+
+			// returns absolute emulated time (cycles elapsed since power-on)
+			uint64_t now(MEMORY &mem) {
+				if (scheduled()) {
+					// the cycles cut from a slice by an interrupt line were never run
+					return cycleClock + (uint32_t)(runStart - mem.remainingCycles() - scheduler->cutCycles());
+				}
+				return cycleClock + (uint32_t)(runStart - mem.remainingCycles());
+			}
+
+			// fetches the opcode of the next instruction (1 cycle). Same as fetch, but also tells the trace sink where the instruction starts
+			BYTE fetchOpcode(MEMORY &mem) {
+				if constexpr (TRACING::traced) {
+					traceSink->instruction(now(mem), reg_programCounter);
+				}
+#ifdef M6502_PROFILE
+				uint64_t start = (profiler != nullptr ? now(mem) : 0);
+#endif
+				BYTE opcode = fetch(mem);
+#ifdef M6502_PROFILE
+				if (profiler != nullptr) {
+					profiler->instruction(start, reg_programCounter - 1, opcode);
+				}
+#endif
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr) {
+					histogram->instruction(opcode);
+				}
+#endif
+				return opcode;
+			}
 
 			// reads and returns next byte at programCounter. Increments programCounter (1 cycle)
 			BYTE fetch(MEMORY &mem) {
@@ -1347,18 +1460,46 @@ namespace m6502 {
 
 			// reads/writes and returns byte at absolute address (from 0x0000 to 0xFFFF) (1 cycle)
 			BYTE rw(MEMORY &mem, WORD address, bool rw, BYTE data = 0x00) {
+				if constexpr (TIMING::exact) {
+					mem.tick();
+				}
 				BYTE value;
 				if (rw == READ) {
-					value = mem[address];
-					std::cout << std::hex << std::setw(4) << address << " r " << std::setw(2) << (int)value << std::endl;
+					value = peek(mem, address);
 				} else {
-					mem[address] = data;
+					if constexpr (BUS::paged) {
+						mem.writeAt(address, data);
+					} else {
+						mem.writeRam(address, data);
+					}
 					value = data;
-					std::cout << std::hex << std::setw(4) << address << " W " << std::setw(2) << (int)value << std::endl;
+					// self-modifying code : decoded instructions of the page are stale
+					if constexpr (BUS::paged) {
+						if (decodeCache.code[address >> 8]) {
+							decodeCache.invalidate(address >> 8);
+						}
+					}
+				}
+				if constexpr (TRACING::traced) {
+					traceSink->access(now(mem), address, rw, value);
 				}
 				return value;
 			}
 
+			// returns byte at address through the bus policy, without counting a cycle
+			BYTE peek(MEMORY &mem, WORD address) {
+				if constexpr (BUS::paged) {
+					return mem.readAt(address);
+				} else {
+					return mem.readRam(address);
+				}
+			}
+
+			// returns true if page is a device page on the bus (never on a flat bus)
+			bool devicePage(MEMORY &mem, BYTE page) {
+				return BUS::paged && mem.isDevice(page);
+			}
+
 			// pushes value to stack (address reg_stackPointer | 0x0100) and increments stack pointer (2 cycles)
 			BYTE pushStack(uint32_t &cycles, MEMORY &mem, BYTE value) {
 				rw(mem, reg_stackPointer | 0x0100, WRITE, value);
@@ -1390,9 +1531,15 @@ namespace m6502 {
 			// returns effective address of absolute X addressing mode (1 cycle in case of page cross, 0 otherwise)
 			WORD absoluteXAddressing(MEMORY &mem, WORD address, bool extraCycle = false) {
 				address += reg_x;
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr && !extraCycle) {
+					histogram->indexed(HISTOGRAM::ABSOLUTE_X, (address & 0x00ff) < reg_x);
+				}
+#endif
 				if ((address & 0x00ff) < reg_x || extraCycle) {
-					// extra cycle when page boundary is crossed
+					// extra cycle when page boundary is crossed (always taken by writes, whose base cost already includes it)
 					rw(mem, address, READ);
+					addPenalty(!extraCycle);
 				}
 				return address;
 			}
@@ -1400,9 +1547,15 @@ namespace m6502 {
 			// returns effective address of absolute Y addressing mode (1 cycle in case of page cross, 0 otherwise)
 			WORD absoluteYAddressing(MEMORY &mem, WORD address, bool extraCycle = false) {
 				address += reg_y;
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr && !extraCycle) {
+					histogram->indexed(HISTOGRAM::ABSOLUTE_Y, (address & 0x00ff) < reg_y);
+				}
+#endif
 				if ((address & 0x00ff) < reg_y || extraCycle) {
-					// extra cycle when page boundary is crossed
+					// extra cycle when page boundary is crossed (always taken by writes, whose base cost already includes it)
 					rw(mem, address, READ);
+					addPenalty(!extraCycle);
 				}
 				return address;
 			}
@@ -1422,45 +1575,178 @@ namespace m6502 {
 				address++;
 				WORD effectiveAddress = littleEndianWord(lowByte, rw(mem, address, READ));
 				effectiveAddress += reg_y;
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr && !extraCycle) {
+					histogram->indexed(HISTOGRAM::INDIRECT_Y, (effectiveAddress & 0x00ff) < reg_y);
+				}
+#endif
 				if ((effectiveAddress & 0x00ff) < reg_y || extraCycle) {
-					// extra cycle when page boundary is crossed
+					// extra cycle when page boundary is crossed (always taken by writes, whose base cost already includes it)
 					rw(mem, effectiveAddress, READ);
+					addPenalty(!extraCycle);
 				}
 				return effectiveAddress;
 			}
 
+			// returns the carry, zero, overflow and negative flags during a run (computed from the stored values with LAZY_FLAGS)
+			bool carryFlag() const {
+				if constexpr (FLAGS::lazy) {
+					return lazyFlags.carry;
+				}
+				return fl_carry;
+			}
+
+			bool zeroFlag() const {
+				if constexpr (FLAGS::lazy) {
+					return lazyFlags.zeroResult == 0;
+				}
+				return fl_zero;
+			}
+
+			bool overflowFlag() const {
+				if constexpr (FLAGS::lazy) {
+					return lazyFlags.overflowBits >> 7;
+				}
+				return fl_oflow;
+			}
+
+			bool negativeFlag() const {
+				if constexpr (FLAGS::lazy) {
+					return lazyFlags.negativeResult >> 7;
+				}
+				return fl_neg;
+			}
+
+			// set the carry, zero, overflow and negative flags during a run to bit 0 of value (like an assignment to their 1-bit fields)
+			void setCarryFlag(BYTE value) {
+				if constexpr (FLAGS::lazy) {
+					lazyFlags.carry = value & 1;
+				} else {
+					fl_carry = value;
+				}
+			}
+
+			void setZeroFlag(BYTE value) {
+				if constexpr (FLAGS::lazy) {
+					lazyFlags.zeroResult = ~value & 1;
+				} else {
+					fl_zero = value;
+				}
+			}
+
+			void setOverflowFlag(BYTE value) {
+				if constexpr (FLAGS::lazy) {
+					lazyFlags.overflowBits = value << 7;
+				} else {
+					fl_oflow = value;
+				}
+			}
+
+			void setNegativeFlag(BYTE value) {
+				if constexpr (FLAGS::lazy) {
+					lazyFlags.negativeResult = value << 7;
+				} else {
+					fl_neg = value;
+				}
+			}
+
+			// returns the status byte NV-BDIZC pushed on the stack, with bits 4 and 5 from breakBits
+			BYTE status(BYTE breakBits) const {
+				if constexpr (FLAGS::lazy) {
+					return carryFlag() | zeroFlag() << 1 | (reg_status & 0b00001100) | breakBits | overflowFlag() << 6 | negativeFlag() << 7;
+				}
+				return reg_status | breakBits;
+			}
+
+			// sets every flag from a status byte pulled from the stack
+			void setStatus(BYTE status) {
+				reg_status = status & 0b11001111;
+				if constexpr (FLAGS::lazy) {
+					loadLazyFlags();
+				}
+			}
+
+			// with LAZY_FLAGS, makes the flag fields (what the host sees between runs) the stored values of the run starting
+			void loadLazyFlags() {
+				if constexpr (FLAGS::lazy) {
+					lazyFlags = {fl_carry, (BYTE)!fl_zero, (BYTE)(fl_oflow << 7), (BYTE)(fl_neg << 7)};
+				}
+			}
+
+			// with LAZY_FLAGS, computes the flag fields from the stored values at the end of a run
+			void storeLazyFlags() {
+				if constexpr (FLAGS::lazy) {
+					fl_carry = carryFlag();
+					fl_zero = zeroFlag();
+					fl_oflow = overflowFlag();
+					fl_neg = negativeFlag();
+				}
+			}
+
 			// loads a register with a defined value and sets appropriate flags (0 cycles)
 			void setLoadFlags(BYTE reg) {
-				fl_zero = (reg == 0);
-				fl_neg = (0b10000000 & reg) > 0;
+				if constexpr (FLAGS::lazy) {
+					// both flags are read from the result
+					lazyFlags.zeroResult = lazyFlags.negativeResult = reg;
+				} else {
+					fl_zero = (reg == 0);
+					fl_neg = (0b10000000 & reg) > 0;
+				}
 			}
 
 			// adds a register and a value together and sets appropriate flags (0 cycles)
 			void addSetFlags(BYTE &reg, BYTE input) {
-				BYTE result = reg + input + fl_carry;
-				fl_carry = (result < reg);
-				// sets overflow flag if bit 7 of both inputs are different from bit 7 of result (therefore, bit 7 of both inputs are the same while bit 7 of result is different)
-				fl_oflow = ((reg ^ result) & (input ^ result) & 0b10000000) > 0;
-				reg = result;
-				setLoadFlags(reg);
+				if (fl_dec) {
+					decimalSetFlags(reg, decimal::additions[decimal::index(carryFlag(), reg, input)]);
+					return;
+				}
+				addBinary(reg, input);
 			}
 
-			// subtracts a value from a register and sets appropriate flags (0 cycles)			
+			// subtracts a value from a register and sets appropriate flags (0 cycles)
 			void subtractSetFlags(BYTE &reg, BYTE input) {
-				BYTE result = reg - input - (~fl_carry);
-				// sets the carry flag if no borrow was needed
-				fl_carry = (reg_acc >= input);
-				// sets overflow flag with the same condition as addSetFlags, except we replace the input with (255 - input) (adding two inputs and subtracting (256 - second input) from the first input are the same in 8-bit values; the final jump between 255 and 256 is done by the borrow (~carry) bit.)
-				fl_oflow = ((reg ^ result) & ((255 - input) ^ result) & 0b10000000) > 0;
+				if (fl_dec) {
+					decimalSetFlags(reg, decimal::subtractions[decimal::index(carryFlag(), reg, input)]);
+					return;
+				}
+				// in binary mode, subtracting is adding the complement : the carry out is set if no borrow was needed
+				addBinary(reg, ~input);
+			}
+
+			// binary addition of ADC and SBC : adds a value and the carry flag to a register and sets appropriate flags (0 cycles)
+			void addBinary(BYTE &reg, BYTE input) {
+				WORD sum = reg + input + carryFlag();
+				BYTE result = sum;
+				setCarryFlag(sum >> 8);
+				// sets overflow flag if bit 7 of both inputs are different from bit 7 of result (therefore, bit 7 of both inputs are the same while bit 7 of result is different)
+				if constexpr (FLAGS::lazy) {
+					lazyFlags.overflowBits = (reg ^ result) & (input ^ result);
+				} else {
+					fl_oflow = ((reg ^ result) & (input ^ result) & 0b10000000) > 0;
+				}
 				reg = result;
 				setLoadFlags(reg);
 			}
 
+			// stores the result of a decimal mode ADC or SBC and its N, V, Z and C flags, from an entry of decimal::additions or decimal::subtractions (0 cycles)
+			void decimalSetFlags(BYTE &reg, WORD entry) {
+				reg = entry & 0xFF;
+				BYTE flags = entry >> 8;
+				if constexpr (FLAGS::lazy) {
+					setCarryFlag(flags);
+					setZeroFlag(flags >> 1);
+					setOverflowFlag(flags >> 6);
+					setNegativeFlag(flags >> 7);
+				} else {
+					reg_status = (reg_status & 0b00001100) | flags;
+				}
+			}
+
 			// compares a register with a value to set appropriate flags (0 cycles)
 			void compare(BYTE reg, BYTE input) {
-				reg -= input;
-				setLoadFlags(reg);
-				fl_carry = (reg <= input);
+				// carry set if no borrow was needed, zero and negative from the difference
+				setCarryFlag(reg >= input);
+				setLoadFlags(reg - input);
 			}
 
 			// transfers contents of a register to another (1 cycle)
@@ -1470,27 +1756,212 @@ namespace m6502 {
 			}
 
 			// branches program counter to a new relative location if condition is met (0-2 cycles)
-			bool branch(uint32_t &cycles, BYTE offset, bool flag, bool condition) {
+			bool branch(uint32_t &cycles, MEMORY &mem, BYTE offset, bool flag, bool condition) {
 				if (flag == condition) {
+					WORD from = reg_programCounter - 2;
 					BYTE oldPage = reg_programCounter >> 8;
-					// unsigned to signed integer with convertion to two's complement if highest bit is set
-					int8_t finalOffset = (offset & 0b10000000 > 0 ? offset - 256 : offset);
+					// offset is a two's complement signed byte
+					int8_t finalOffset = (int8_t)offset;
 					reg_programCounter += finalOffset;
 					cycles--;
-					if (oldPage != (reg_programCounter >> 8)) {
+					addPenalty(1);
+					bool crossed = (oldPage != (reg_programCounter >> 8));
+					if (crossed) {
 						// extra cycle if page is crossed
 						cycles--;
+						addPenalty(1);
+					}
+#ifdef M6502_HISTOGRAM
+					if (histogram != nullptr) {
+						histogram->branch(true, crossed);
 					}
+#endif
+					loopBack(cycles, mem, from, reg_programCounter);
 					return true;
 				}
+#ifdef M6502_HISTOGRAM
+				if (histogram != nullptr) {
+					histogram->branch(false, false);
+				}
+#endif
 				return false;
 			}
 
+			// ends the running slice when the interrupt flag was just cleared with IRQ held, so the interrupt is taken before the next instruction
+			void unmaskIrq() {
+				if (scheduled() && !fl_interr && scheduler->irqAsserted()) {
+					scheduler->interruptSlice();
+				}
+			}
+
+			// called by every taken branch and absolute jump (from is the address of the instruction), once its own cycles are counted
+			// two backward transfers in a row with the same registers and flags are two passes of the same loop from the same state : if its body
+			// only reads memory (see idleBody), every later pass is identical, so whole passes are skipped up to the end of the budget
+			// (leaving the last pass or so to run, so execute stops exactly where it would have)
+			void loopBack(uint32_t &cycles, MEMORY &mem, WORD from, WORD target) {
+				if (target > from || from - target > 0xFF || !idleLoop.enabled) {
+					return;
+				}
+				// skipped passes would leave no trace records
+				if (traced()) {
+					return;
+				}
+#ifdef M6502_PROFILE
+				// nor profile counts
+				if (profiler != nullptr) {
+					return;
+				}
+#endif
+#ifdef M6502_HISTOGRAM
+				// nor opcode counts
+				if (histogram != nullptr) {
+					return;
+				}
+#endif
+				BYTE flags = status(0);
+				uint64_t key = target | (uint64_t)(from - target) << 16 | (uint64_t)reg_acc << 24 | (uint64_t)reg_x << 32 | (uint64_t)reg_y << 40
+					| (uint64_t)reg_stackPointer << 48 | (uint64_t)flags << 56;
+				uint64_t clock = now(mem);
+				if (M6502_LIKELY(key != idleLoop.key)) {
+					idleLoop.key = key;
+					idleLoop.clock = clock;
+					idleLoop.rejected = false;
+					return;
+				}
+				uint64_t period = clock - idleLoop.clock;
+				idleLoop.clock = clock;
+				uint32_t remaining = mem.remainingCycles();
+				// the budget may already be overrun (wrapped below 0) by this instruction
+				if (idleLoop.rejected || period == 0 || remaining >= 0xFFFFFFFA || remaining / period < 3) {
+					return;
+				}
+				uint32_t length = idleBody(mem, from, target);
+				if (length == 0) {
+					idleLoop.rejected = true;
+					return;
+				}
+				uint32_t passes = (remaining - 1) / period - 1;
+				uint32_t skipped = passes * (uint32_t)period;
+				if constexpr (TIMING::exact) {
+					cycles -= skipped;
+				} else {
+					penaltyCycles += skipped;
+				}
+				idleLoop.clock += skipped;
+				idleLoop.skips++;
+				idleLoop.skippedCycles += skipped;
+				idleLoop.skippedInstructions += (uint64_t)passes * length;
+			}
+
+			// returns the instructions of one pass of the loop from target to the branch or jump at from, or 0 if passes cannot be skipped :
+			// the body must be straight-line code outside device pages, with only instructions that change nothing but registers and flags
+			// (see readsOnly), reading RAM or ROM at addresses that do not depend on memory
+			uint32_t idleBody(MEMORY &mem, WORD from, WORD target) {
+				static constexpr std::array<BYTE, 256> modes = modeTable();
+				static constexpr std::array<bool, 256> idle = idleTable();
+				uint32_t length = 1;
+				WORD address = target;
+				while (address != from) {
+					if (devicePage(mem, address >> 8) || devicePage(mem, (WORD)(address + 2) >> 8)) {
+						return 0;
+					}
+					BYTE opcode = peek(mem, address);
+					WORD operand = littleEndianWord(peek(mem, address + 1), peek(mem, address + 2));
+					bool device;
+					switch (modes[opcode]) {
+						case am_zp:
+						case am_zpx:
+						case am_zpy:
+							device = devicePage(mem, 0x00);
+							break;
+						case am_abs:
+							device = devicePage(mem, operand >> 8);
+							break;
+						case am_absx:
+						case am_absy:
+							// the index may differ inside the pass : both pages the access can reach
+							device = devicePage(mem, operand >> 8) || devicePage(mem, (WORD)(operand + 0xFF) >> 8);
+							break;
+						case am_imp:
+						case am_imm:
+							device = false;
+							break;
+						default:
+							// indirect addresses come from memory, relative ones leave the straight line
+							return 0;
+					}
+					if (!idle[opcode] || device) {
+						return 0;
+					}
+					WORD next = address + 1 + operandLength(modes[opcode]);
+					// the body must end exactly at from
+					if ((WORD)(next - target) > (WORD)(from - target)) {
+						return 0;
+					}
+					address = next;
+					length++;
+				}
+				return length;
+			}
+
+			// returns true for the instructions that change registers and flags only (no write, stack access or jump)
+			static constexpr bool readsOnly(BYTE operation, BYTE mode) {
+				switch (operation) {
+					case STA:
+					case STX:
+					case STY:
+					case PHA:
+					case PHP:
+					case PLA:
+					case PLP:
+					case INC:
+					case DEC:
+					case JMP:
+					case JSR:
+					case RTS:
+					case BRK:
+					case RTI:
+						return false;
+					case ASL:
+					case LSR:
+					case ROL:
+					case ROR:
+						// shifts and rotates of A, but not of memory
+						return mode == am_imp;
+				}
+				return operation < BCC || operation > BVS;
+			}
+
+			// builds the 256-entry table of readsOnly opcodes
+			static constexpr std::array<bool, 256> idleTable() {
+				std::array<DESCRIPTOR, 256> descriptors = descriptorTable();
+				std::array<bool, 256> table{};
+				for (uint32_t opcode = 0; opcode < 256; opcode++) {
+					table[opcode] = readsOnly(descriptors[opcode].operation, descriptors[opcode].mode);
+				}
+				return table;
+			}
+
 			// returns a low endian word formed from two bytes
 			WORD littleEndianWord(BYTE lowByte, BYTE highByte) {
 				return lowByte | (WORD)(highByte) << 8;
 			}
-	}; // struct CPU
+			uint32_t penaltyCycles = 0;	// page-cross and branch cycles of the current instruction (and skipped idle passes), with per-instruction timing
+
+			// what the carry, zero, overflow and negative flags are computed from during a run, with LAZY_FLAGS
+			struct LAZY_FLAG_VALUES {
+				BYTE carry;				// 0 or 1
+				BYTE zeroResult;		// zero flag set if 0
+				BYTE overflowBits;		// overflow flag in bit 7
+				BYTE negativeResult;	// negative flag in bit 7
+			} lazyFlags = {0, 1, 0, 0};
+	}; // struct CPU_T : public REGISTERS
+
+	typedef CPU_T<EXACT_TIMING> CPU;				// cycle-exact CPU
+	typedef CPU_T<INSTRUCTION_TIMING> FAST_CPU;		// CPU charging each instruction from the cycle table
+	typedef CPU_T<INSTRUCTION_TIMING, EAGER_FLAGS, FLAT_BUS, NO_TRACE, NO_INTERRUPTS> MINIMAL_CPU;	// FAST_CPU on plain RAM, without trace or scheduler code
+
+	static_assert(PROFILER::OPCODE_JSR == CPU::ins_jsr_abs && PROFILER::OPCODE_RTS == CPU::ins_rts && PROFILER::OPCODE_RTI == CPU::ins_rti, "profiler opcodes");
 } // namespace m6502
 
 #endif // ifndef _6502_H
\ No newline at end of file
@@ -0,0 +1,290 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "6502.h"
+
+namespace m6502 {
+
+	// device ending a batch job : the guest writes its exit code to any address of the page
+	// records the remaining cycles at the write so the runner knows exactly when the job halted
+	struct HALT_PORT : public DEVICE {
+		public:
+			HALT_PORT(MEMORY &nMem) : mem(nMem) {}
+
+			BYTE read(WORD) {
+				return code;
+			}
+
+			void write(WORD, BYTE value) {
+				if (!halted) {
+					halted = true;
+					code = value;
+					remainingAtHalt = mem.remainingCycles();
+				}
+			}
+
+			bool halted = false;			// true once the guest wrote to the port
+			BYTE code = 0;					// first value written
+			uint32_t remainingAtHalt = 0;	// remaining cycles of the run right after the write (before the writing instruction is charged with per-instruction timing)
+		private:
+			MEMORY &mem;
+	}; // struct HALT_PORT : public DEVICE
+
+	// one guest run : a memory image, the input patched into it, a cycle budget and the memory range to return
+	struct BATCH_JOB {
+		std::shared_ptr<const std::vector<BYTE>> image;	// memory image (with reset vector), shared by every job running the same ROM
+		WORD inputAddress = 0x0000;						// where input is written over the image before reset
+		std::vector<BYTE> input;						// job-specific bytes
+		uint64_t cycles = 1000000;						// cycle budget
+		WORD outputAddress = 0x0000;					// first byte returned in BATCH_RESULT::output
+		WORD outputLength = 0;							// bytes returned
+	}; // struct BATCH_JOB
+
+	// outcome and statistics of one job
+	struct BATCH_RESULT {
+		bool halted = false;				// true if the guest wrote to the halt port, false if it ran out of budget
+		BYTE haltCode = 0;					// value written to the halt port
+		uint64_t cycles = 0;				// cycles run up to the halt (or the whole budget)
+		uint64_t instructions = 0;			// instructions run (the last slice runs on past a halt)
+		std::chrono::nanoseconds wallTime;	// host time spent on the job
+		WORD programCounter = 0;			// registers at the end of the job
+		BYTE acc = 0;
+		BYTE x = 0;
+		BYTE y = 0;
+		std::vector<BYTE> output;			// memory range asked for by the job
+		unsigned worker = 0;				// worker thread that ran the job
+	}; // struct BATCH_RESULT
+
+	// runs independent jobs on a pool of worker threads, each owning one MEMORY
+	// jobs are dealt round-robin to per-worker queues. A worker takes jobs from the front of its own queue and, once it is empty,
+	// steals from the back of the others, so uneven jobs still keep every core busy
+	template <class CPU_TYPE>
+	struct BATCH_RUNNER_T {
+		public:
+			// jobs halt through a device page and are reset by restoring the dirty pages of the image
+			static_assert(CPU_TYPE::BUS_POLICY::paged, "batch jobs need the HALT_PORT device and the dirty pages of the paged bus");
+
+			BYTE haltPage = 0xDF;			// page mapped to the HALT_PORT of every job
+			uint32_t sliceCycles = 20000;	// cycles run between two checks of the halt port
+
+			uint64_t steals = 0;			// jobs taken from another worker's queue during the last run
+#ifdef M6502_HISTOGRAM
+			bool countOpcodes = false;		// counts the opcodes, page crosses and branches of the jobs (each worker in its own HISTOGRAM)
+			HISTOGRAM histogram;			// counts of the last run, merged from every worker once it is done
+#endif
+
+			// starts nThreads workers (one per hardware thread by default)
+			BATCH_RUNNER_T(unsigned nThreads = 0) {
+				if (nThreads == 0) {
+					nThreads = std::max(1u, std::thread::hardware_concurrency());
+				}
+				queues.resize(nThreads);
+				for (unsigned i = 0; i < nThreads; i++) {
+					queues[i] = std::make_unique<QUEUE>();
+				}
+				for (unsigned i = 0; i < nThreads; i++) {
+					workers.emplace_back(&BATCH_RUNNER_T::work, this, i);
+				}
+			}
+
+			~BATCH_RUNNER_T() {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				wake.notify_all();
+				for (std::thread &worker : workers) {
+					worker.join();
+				}
+			}
+
+			// returns the number of worker threads
+			unsigned threads() const {
+				return workers.size();
+			}
+
+			// runs every job and returns their results in the same order. Blocks until all are done
+			std::vector<BATCH_RESULT> run(const std::vector<BATCH_JOB> &nJobs) {
+				std::vector<BATCH_RESULT> results(nJobs.size());
+				std::unique_lock<std::mutex> lock(mutex);
+				jobs = &nJobs;
+				output = &results;
+				pending = nJobs.size();
+				stealCount = 0;
+#ifdef M6502_HISTOGRAM
+				histogram.clear();
+#endif
+				// each queue under its own lock, the one take() and stealing workers use
+				for (size_t queue = 0; queue < queues.size(); queue++) {
+					std::lock_guard<std::mutex> queueLock(queues[queue]->mutex);
+					for (size_t i = queue; i < nJobs.size(); i += queues.size()) {
+						queues[queue]->jobs.push_back(i);
+					}
+				}
+				generation++;
+				wake.notify_all();
+				// also wait for the workers to leave their job loop, so none of them looks at the queues of the next run
+				done.wait(lock, [this] { return pending == 0 && active == 0; });
+				jobs = nullptr;
+				output = nullptr;
+				steals = stealCount;
+				return results;
+			}
+		private:
+			struct QUEUE {
+				std::mutex mutex;
+				std::deque<size_t> jobs;	// indexes in *jobs
+			}; // struct QUEUE
+
+			// what a worker keeps from one job to the next
+			struct WORKER {
+				uint32_t cycles = 0;
+				MEMORY mem;
+				std::shared_ptr<const std::vector<BYTE>> image;	// image last loaded into mem (held so that its address is not reused by another image)
+				MEMORY::SNAPSHOT loaded;						// mem right after loading image : jobs on the same image restore it instead of reloading
+				HISTOGRAM counts;								// counts of this worker's jobs in the current run (with countOpcodes)
+			}; // struct WORKER
+
+			// worker thread : waits for a run, then takes jobs until every queue is empty
+			void work(unsigned worker) {
+				std::unique_ptr<WORKER> state = std::make_unique<WORKER>();
+				uint64_t seenGeneration = 0;
+				while (true) {
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+						if (stopping) {
+							return;
+						}
+						seenGeneration = generation;
+						active++;
+					}
+					size_t job;
+					size_t finished = 0;
+					while (take(worker, job)) {
+						(*output)[job] = runJob((*jobs)[job], *state);
+						(*output)[job].worker = worker;
+						finished++;
+					}
+					std::lock_guard<std::mutex> lock(mutex);
+#ifdef M6502_HISTOGRAM
+					if (countOpcodes) {
+						histogram.merge(state->counts);
+						state->counts.clear();
+					}
+#endif
+					pending -= finished;
+					active--;
+					if (pending == 0 && active == 0) {
+						done.notify_all();
+					}
+				}
+			}
+
+			// takes the next job of worker, or steals one. Returns false once every queue is empty
+			bool take(unsigned worker, size_t &job) {
+				{
+					QUEUE &own = *queues[worker];
+					std::lock_guard<std::mutex> lock(own.mutex);
+					if (!own.jobs.empty()) {
+						job = own.jobs.front();
+						own.jobs.pop_front();
+						return true;
+					}
+				}
+				for (size_t i = 1; i < queues.size(); i++) {
+					QUEUE &victim = *queues[(worker + i) % queues.size()];
+					std::lock_guard<std::mutex> lock(victim.mutex);
+					if (!victim.jobs.empty()) {
+						job = victim.jobs.back();
+						victim.jobs.pop_back();
+						stealCount++;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// runs one job on the worker's memory, counting into the worker's histogram counts
+			// the image is loaded once per worker : the next jobs on it only copy back the pages the previous job wrote (see MEMORY::restore)
+			BATCH_RESULT runJob(const BATCH_JOB &job, WORKER &worker) {
+				BATCH_RESULT result;
+				THROTTLE::CLOCK::time_point startTime = THROTTLE::CLOCK::now();
+				uint32_t &cycles = worker.cycles;
+				MEMORY &mem = worker.mem;
+				if (job.image != worker.image) {
+					mem.init(&cycles);
+					mem.fill(*job.image);
+					worker.image = job.image;
+					worker.loaded = mem.save();
+				} else {
+					mem.restore(worker.loaded);
+				}
+				for (size_t i = 0; i < job.input.size(); i++) {
+					mem.at(job.inputAddress + i) = job.input[i];
+				}
+				HALT_PORT port(mem);
+				mem.mapDevice(haltPage, haltPage, &port);
+				CPU_TYPE cpu;
+				cpu.throttle.mode = THROTTLE::UNTHROTTLED;
+#ifdef M6502_HISTOGRAM
+				if (countOpcodes) {
+					cpu.histogram = &worker.counts;
+				}
+#endif
+				cycles = 7;
+				cpu.reset(cycles, mem);
+				uint64_t remaining = job.cycles;
+				while (remaining > 0 && !port.halted) {
+					uint32_t slice = (uint32_t)std::min<uint64_t>(remaining, sliceCycles);
+					cycles = slice;
+					cpu.execute(cycles, mem);
+					// the budget of a slice may be overshot by the last instruction (cycles wraps below 0)
+					uint32_t used = (port.halted ? slice - port.remainingAtHalt : slice - cycles);
+					result.cycles += used;
+					result.instructions += cpu.stats.instructions;
+					remaining = (used < remaining ? remaining - used : 0);
+				}
+				result.halted = port.halted;
+				result.haltCode = port.code;
+				result.programCounter = cpu.reg_programCounter;
+				result.acc = cpu.reg_acc;
+				result.x = cpu.reg_x;
+				result.y = cpu.reg_y;
+				for (uint32_t i = 0; i < job.outputLength; i++) {
+					result.output.push_back(mem.readAt(job.outputAddress + i));
+				}
+				result.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE::CLOCK::now() - startTime);
+				return result;
+			}
+
+			std::vector<std::thread> workers;
+			std::vector<std::unique_ptr<QUEUE>> queues;	// one per worker
+			std::mutex mutex;							// guards everything below
+			std::condition_variable wake;				// signals a new run or shutdown to the workers
+			std::condition_variable done;				// signals the end of a run to run()
+			const std::vector<BATCH_JOB> *jobs = nullptr;
+			std::vector<BATCH_RESULT> *output = nullptr;
+			size_t pending = 0;							// jobs of the current run not finished yet
+			unsigned active = 0;						// workers inside their job loop
+			uint64_t generation = 0;					// number of runs started
+			std::atomic<uint64_t> stealCount{0};
+			bool stopping = false;
+	}; // struct BATCH_RUNNER_T
+
+	typedef BATCH_RUNNER_T<CPU> BATCH_RUNNER;			// batch runner with cycle-exact timing
+	typedef BATCH_RUNNER_T<FAST_CPU> FAST_BATCH_RUNNER;	// batch runner with per-instruction timing
+} // namespace m6502
+
+#endif // ifndef _BATCH_H
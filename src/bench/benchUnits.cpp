@@ -0,0 +1,689 @@
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../6502.h"
+#include "../mapper.h"
+#include "../batch.h"
+#include "../lockstep.h"
+#include "../jit.h"
+#include "../scheduler.h"
+#include "../via.h"
+#include "../loader.h"
+
+// counts one hardware event of the calling thread with perf_event_open. Reports nothing if the host does not allow it
+class perfCounter {
+	public:
+		perfCounter(uint64_t config) {
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = config;
+			attributes.disabled = 1;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			fd = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+		}
+
+		~perfCounter() {
+			if (fd >= 0) {
+				close(fd);
+			}
+		}
+
+		bool available() const {
+			return fd >= 0;
+		}
+
+		void start() {
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+
+		// stops counting and returns the count since start
+		uint64_t stop() {
+			uint64_t count = 0;
+			if (fd >= 0) {
+				ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+					count = 0;
+				}
+			}
+			return count;
+		}
+	private:
+		int fd;
+}; // class perfCounter
+
+// writes the benchmark program at 0x2000 and points the reset vector to it
+// the program loops forever over a mix of indexed loads and stores, ALU operations, compares, branches and a subroutine call
+void loadWorkload(m6502::MEMORY &mem) {
+	std::vector<m6502::BYTE> program = {
+		m6502::CPU::ins_ldx_im, 0x00,			// 2000 : ldx #0
+		m6502::CPU::ins_lda_zpx, 0x10,			// 2002 : lda $10,x
+		m6502::CPU::ins_clc,					// 2004 : clc
+		m6502::CPU::ins_adc_im, 0x03,			// 2005 : adc #3
+		m6502::CPU::ins_sta_zpx, 0x10,			// 2007 : sta $10,x
+		m6502::CPU::ins_eor_abs, 0x00, 0x30,	// 2009 : eor $3000
+		m6502::CPU::ins_inx,					// 200C : inx
+		m6502::CPU::ins_cpx_im, 0x40,			// 200D : cpx #$40
+		m6502::CPU::ins_bne, 0xF1,				// 200F : bne $2002
+		m6502::CPU::ins_jsr_abs, 0x00, 0x21,	// 2011 : jsr $2100
+		m6502::CPU::ins_jmp_abs, 0x00, 0x20		// 2014 : jmp $2000
+	};
+	std::vector<m6502::BYTE> subroutine = {
+		m6502::CPU::ins_ldy_im, 0x08,			// 2100 : ldy #8
+		m6502::CPU::ins_dey,					// 2102 : dey
+		m6502::CPU::ins_bne, 0xFD,				// 2103 : bne $2102
+		m6502::CPU::ins_rts						// 2105 : rts
+	};
+	std::vector<m6502::BYTE> image(0x10000, m6502::CPU::ins_nop);
+	std::copy(program.begin(), program.end(), image.begin() + 0x2000);
+	std::copy(subroutine.begin(), subroutine.end(), image.begin() + 0x2100);
+	image[0xFFFC] = 0x00;
+	image[0xFFFD] = 0x20;
+	mem.fill(image);
+}
+
+// base class for benchmark units
+class benchUnit {
+	public:
+		virtual ~benchUnit() {}
+
+		// runs the benchmark and prints its results
+		virtual void run() = 0;
+}; // class benchUnit
+
+// compares the dispatch engines of CPU::execute, with per-access (CPU) and per-instruction (FAST_CPU) timing : host ns per emulated instruction and branch mispredicts per instruction
+class dispatch : public benchUnit {
+	public:
+		void run() {
+			std::cout << "dispatch benchmark (" << std::dec << CYCLES << " cycles per engine)" << std::endl;
+			measure<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>("switch");
+			measure<m6502::CPU, m6502::CPU::DISPATCH_TABLE>("table");
+			measure<m6502::CPU, m6502::CPU::DISPATCH_THREADED>("threaded");
+			measure<m6502::CPU, m6502::CPU::DISPATCH_CACHED>("cached");
+			std::cout << "per-instruction timing (FAST_CPU)" << std::endl;
+			measure<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>("switch");
+			measure<m6502::FAST_CPU, m6502::CPU::DISPATCH_TABLE>("table");
+			measure<m6502::FAST_CPU, m6502::CPU::DISPATCH_THREADED>("threaded");
+			measure<m6502::FAST_CPU, m6502::CPU::DISPATCH_CACHED>("cached");
+		}
+	private:
+		static constexpr uint32_t CYCLES = 200000000;
+
+		template <class CPU_TYPE, int DISPATCH>
+		void measure(const char *name) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			CPU_TYPE cpu;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			perfCounter branchMisses(PERF_COUNT_HW_BRANCH_MISSES);
+			branchMisses.start();
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			uint64_t misses = branchMisses.stop();
+			std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+				<< (double)cpu.stats.wallTime.count() / cpu.stats.instructions << " ns/instruction, " << cpu.stats.emulatedMHz() << " emulated MHz, ";
+			if (branchMisses.available()) {
+				std::cout << std::setprecision(4) << (double)misses / cpu.stats.instructions << " branch mispredicts/instruction";
+			} else {
+				std::cout << "branch mispredicts unavailable";
+			}
+			std::cout << std::defaultfloat << std::endl;
+		}
+}; // class dispatch : public benchUnit
+
+// measures switch-heavy code on an 8 KiB banked RAM window : a bank switch every 5 instructions
+// the same program runs once with the register page as plain RAM to give the cost of the switches themselves
+class banking : public benchUnit {
+	public:
+		void run() {
+			std::cout << "banking benchmark (" << std::dec << CYCLES << " cycles per run)" << std::endl;
+			measure(false);
+			measure(true);
+		}
+	private:
+		static constexpr uint32_t CYCLES = 100000000;
+
+		void measure(bool mapped) {
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldx_im, 0x00,			// 2000 : ldx #0
+				m6502::CPU::ins_stx_abs, 0x00, 0x9F,	// 2002 : stx $9F00 (select bank x)
+				m6502::CPU::ins_lda_abs, 0x00, 0xA0,	// 2005 : lda $A000
+				m6502::CPU::ins_sta_abs, 0x01, 0xA0,	// 2008 : sta $A001
+				m6502::CPU::ins_inx,					// 200B : inx
+				m6502::CPU::ins_bne, 0xF4,				// 200C : bne $2002
+				m6502::CPU::ins_jmp_abs, 0x00, 0x20		// 200E : jmp $2000
+			};
+			std::vector<m6502::BYTE> image(0x10000, m6502::CPU::ins_nop);
+			std::copy(program.begin(), program.end(), image.begin() + 0x2000);
+			image[0xFFFC] = 0x00;
+			image[0xFFFD] = 0x20;
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::CPU cpu;
+			m6502::RAM8_MAPPER expansion(64);
+			mem.init(&cycles);
+			mem.fill(image);
+			if (mapped) {
+				expansion.attach(mem, 0x9F);
+			}
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			cpu.execute(cycles, mem);
+			double seconds = cpu.stats.wallTime.count() / 1e9;
+			std::cout << "  " << std::left << std::setw(10) << (mapped ? "mapper" : "plain RAM") << std::right << std::fixed << std::setprecision(2)
+				<< (double)cpu.stats.wallTime.count() / cpu.stats.instructions << " ns/instruction, " << cpu.stats.emulatedMHz() << " emulated MHz";
+			if (mapped) {
+				std::cout << ", " << expansion.switches / seconds / 1e6 << " M switches/s";
+			}
+			std::cout << std::defaultfloat << std::endl;
+		}
+}; // class banking : public benchUnit
+
+// measures save states the way a search or fuzzing loop uses them : run a short slice, then go back to a saved state
+class snapshot : public benchUnit {
+	public:
+		void run() {
+			std::cout << "snapshot benchmark (" << std::dec << ROUNDS << " rounds of " << SLICE << " cycles)" << std::endl;
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::CPU cpu;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			m6502::CPU::STATE start = cpu.save(mem);
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			for (uint32_t round = 0; round < ROUNDS; round++) {
+				cycles = SLICE;
+				cpu.execute(cycles, mem);
+				m6502::CPU::STATE state = cpu.save(mem);
+				cycles = SLICE;
+				cpu.execute(cycles, mem);
+				cpu.restore(start, mem);
+			}
+			double nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count();
+			std::cout << "  " << std::fixed << std::setprecision(2) << nanoseconds / ROUNDS << " ns per round (2 runs, 1 save, 1 restore), "
+				<< ROUNDS * 1e9 / nanoseconds << " save/restore pairs/s" << std::defaultfloat << std::endl;
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t ROUNDS = 200000;
+		static constexpr uint32_t SLICE = 1000;
+}; // class snapshot : public benchUnit
+
+// measures batch runner throughput against the number of worker threads (1, 2, 4... up to twice the hardware threads)
+class batch : public benchUnit {
+	public:
+		void run() {
+			unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+			std::cout << "batch benchmark (" << std::dec << JOBS << " jobs of " << JOB_CYCLES << " cycles, " << hardwareThreads << " hardware threads)" << std::endl;
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			std::shared_ptr<std::vector<m6502::BYTE>> image = std::make_shared<std::vector<m6502::BYTE>>(0x10000);
+			for (uint32_t i = 0; i < 0x10000; i++) {
+				(*image)[i] = mem.at(i);
+			}
+			std::vector<m6502::BATCH_JOB> jobs(JOBS);
+			for (uint32_t i = 0; i < JOBS; i++) {
+				jobs[i].image = image;
+				jobs[i].inputAddress = 0x10;
+				jobs[i].input = {(m6502::BYTE)i};
+				jobs[i].cycles = JOB_CYCLES;
+			}
+			double baseline = 0;
+			for (unsigned threads = 1; threads <= 2 * hardwareThreads; threads *= 2) {
+				m6502::BATCH_RUNNER runner(threads);
+				THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+				runner.run(jobs);
+				double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+				double jobsPerSecond = JOBS / seconds;
+				if (threads == 1) {
+					baseline = jobsPerSecond;
+				}
+				std::cout << "  " << std::setw(3) << threads << " threads : " << std::fixed << std::setprecision(1) << jobsPerSecond << " jobs/s, "
+					<< (double)JOBS * JOB_CYCLES / seconds / 1e6 << " emulated MHz, speedup " << std::setprecision(2) << jobsPerSecond / baseline
+					<< ", " << runner.steals << " steals" << std::defaultfloat << std::endl;
+			}
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t JOBS = 256;
+		static constexpr uint32_t JOB_CYCLES = 2000000;
+}; // class batch : public benchUnit
+
+// compares LOCKSTEP (every lane on one vector step) with the same machines run one after the other on FAST_CPU, each lane with its own input at 0x10
+class lockstep : public benchUnit {
+	public:
+		void run() {
+			std::cout << "lockstep benchmark (" << std::dec << LANES << " machines of " << MACHINE_CYCLES << " cycles)" << std::endl;
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			std::vector<m6502::BYTE> image(0x10000);
+			for (uint32_t i = 0; i < 0x10000; i++) {
+				image[i] = mem.at(i);
+			}
+
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			for (int lane = 0; lane < LANES; lane++) {
+				image[0x10] = lane;
+				mem.fill(image);
+				m6502::FAST_CPU cpu;
+				cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+				cycles = 7;
+				cpu.reset(cycles, mem);
+				cycles = MACHINE_CYCLES;
+				cpu.execute(cycles, mem);
+			}
+			double scalarSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+
+			std::unique_ptr<m6502::LOCKSTEP> machines = std::make_unique<m6502::LOCKSTEP>();
+			image[0x10] = 0;
+			machines->load(image);
+			for (int lane = 0; lane < LANES; lane++) {
+				machines->write(lane, 0x10, lane);
+			}
+			machines->reset();
+			begin = THROTTLE_CLOCK::now();
+			machines->execute(MACHINE_CYCLES);
+			double lockstepSeconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+
+			double emulatedCycles = (double)LANES * MACHINE_CYCLES;
+			std::cout << "  scalar   : " << std::fixed << std::setprecision(1) << emulatedCycles / scalarSeconds / 1e6 << " emulated MHz (all machines)" << std::endl;
+			std::cout << "  lockstep : " << emulatedCycles / lockstepSeconds / 1e6 << " emulated MHz (all machines), speedup " << std::setprecision(2)
+				<< scalarSeconds / lockstepSeconds << ", " << machines->ejections << " lanes ejected" << std::defaultfloat << std::endl;
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr int LANES = m6502::LOCKSTEP::LANE_COUNT;
+		static constexpr uint32_t MACHINE_CYCLES = 2000000;
+}; // class lockstep : public benchUnit
+
+// compares FAST_CPU interpreting with FAST_JIT, on the common workload (partly compilable) and on a copy loop made only of compilable instructions
+class jit : public benchUnit {
+	public:
+		void run() {
+			std::cout << "jit benchmark (" << std::dec << CYCLES << " cycles per run)" << std::endl;
+			if (!m6502::FAST_JIT::available()) {
+				std::cout << "  no executable memory, skipped" << std::endl;
+				return;
+			}
+			std::cout << "  workload" << std::endl;
+			measure(loadWorkload);
+			std::cout << "  copy loop" << std::endl;
+			measure(loadCopyLoop);
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t CYCLES = 200000000;
+
+		// writes a loop copying 0x3000-0x30FF to 0x4000-0x40FF with a transform, at 0x2000
+		static void loadCopyLoop(m6502::MEMORY &mem) {
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldy_im, 0x00,			// 2000 : ldy #0
+				m6502::CPU::ins_lda_absy, 0x00, 0x30,	// 2002 : lda $3000,y
+				m6502::CPU::ins_eor_im, 0x5A,			// 2005 : eor #$5A
+				m6502::CPU::ins_sta_absy, 0x00, 0x40,	// 2007 : sta $4000,y
+				m6502::CPU::ins_iny,					// 200A : iny
+				m6502::CPU::ins_bne, 0xF5,				// 200B : bne $2002
+				m6502::CPU::ins_jmp_abs, 0x00, 0x20		// 200D : jmp $2000
+			};
+			std::vector<m6502::BYTE> image(0x10000, m6502::CPU::ins_nop);
+			std::copy(program.begin(), program.end(), image.begin() + 0x2000);
+			image[0xFFFC] = 0x00;
+			image[0xFFFD] = 0x20;
+			mem.fill(image);
+		}
+
+		void measure(void (*load)(m6502::MEMORY &)) {
+			double interpreted = time(load, nullptr);
+			m6502::FAST_JIT compiler;
+			double compiled = time(load, &compiler);
+			std::cout << "    interpreter : " << std::fixed << std::setprecision(2) << interpreted << " ns/instruction" << std::endl;
+			std::cout << "    jit         : " << compiled << " ns/instruction, speedup " << interpreted / compiled << std::defaultfloat << ", "
+				<< compiler.compiledBlocks << " blocks, " << compiler.nativeInstructions << " native / " << compiler.interpretedInstructions << " interpreted instructions" << std::endl;
+		}
+
+		// runs CYCLES cycles of the program written by load and returns the host ns per emulated instruction
+		double time(void (*load)(m6502::MEMORY &), m6502::FAST_JIT *compiler) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::FAST_CPU cpu;
+			mem.init(&cycles);
+			load(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			if (compiler != nullptr) {
+				compiler->execute(cpu, cycles, mem);
+			} else {
+				cpu.execute(cycles, mem);
+			}
+			double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count();
+			return ns / cpu.stats.instructions;
+		}
+}; // class jit : public benchUnit
+
+// compares running every pass of a polling loop with skipping its idle passes (CPU::idleLoop)
+class idle : public benchUnit {
+	public:
+		void run() {
+			std::cout << "idle loop benchmark (" << std::dec << CYCLES << " cycles, polling $10 until bit 7 is set)" << std::endl;
+			measure(false, "every pass");
+			measure(true, "skipped");
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t CYCLES = 200000000;
+
+		void measure(bool skip, const char *name) {
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_lda_zp, 0x10,			// 2000 : lda $10
+				m6502::CPU::ins_and_im, 0x80,			// 2002 : and #$80
+				m6502::CPU::ins_beq, 0xFA				// 2004 : beq $2000
+			};
+			std::vector<m6502::BYTE> image(0x10000, m6502::CPU::ins_nop);
+			std::copy(program.begin(), program.end(), image.begin() + 0x2000);
+			image[0x10] = 0x00;
+			image[0xFFFC] = 0x00;
+			image[0xFFFD] = 0x20;
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::CPU cpu;
+			mem.init(&cycles);
+			mem.fill(image);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cpu.idleLoop.enabled = skip;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			cpu.execute(cycles, mem);
+			double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+			std::cout << "  " << std::left << std::setw(11) << name << std::right << ": " << std::fixed << std::setprecision(1) << CYCLES / seconds / 1e6
+				<< " emulated MHz, " << cpu.stats.instructions << " instructions, " << cpu.idleLoop.skips << " skips" << std::defaultfloat << std::endl;
+		}
+}; // class idle : public benchUnit
+
+// measures the cost of slicing CPU::execute around scheduled events : the workload alone, then with a periodic event every PERIOD cycles
+// the events only reschedule themselves, so the difference is the cost of the slices and of the scheduler
+class events : public benchUnit {
+	public:
+		void run() {
+			std::cout << "event scheduler benchmark (" << std::dec << CYCLES << " cycles)" << std::endl;
+			measure(0, "no scheduler");
+			measure(10000, "every 10000");
+			measure(1000, "every 1000");
+			measure(100, "every 100");
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t CYCLES = 200000000;
+
+		struct PERIODIC : public m6502::EVENT_HANDLER {
+			public:
+				PERIODIC(m6502::SCHEDULER *nScheduler, uint64_t nPeriod) : scheduler(nScheduler), period(nPeriod) {}
+
+				void fire(uint64_t time) {
+					scheduler->schedule(time + period, this);
+				}
+
+				m6502::SCHEDULER *scheduler;
+				uint64_t period;
+		}; // struct PERIODIC
+
+		void measure(uint64_t period, const char *name) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::CPU cpu;
+			m6502::SCHEDULER scheduler;
+			PERIODIC periodic(&scheduler, period);
+			mem.init(&cycles);
+			loadWorkload(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			if (period != 0) {
+				scheduler.schedule(period, &periodic);
+				cpu.scheduler = &scheduler;
+			}
+			cycles = CYCLES;
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			cpu.execute(cycles, mem);
+			double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+			std::cout << "  " << std::left << std::setw(13) << name << std::right << ": " << std::fixed << std::setprecision(1) << CYCLES / seconds / 1e6
+				<< " emulated MHz, " << cpu.stats.instructions << " instructions, " << scheduler.fired << " events" << std::defaultfloat << std::endl;
+		}
+}; // class events : public benchUnit
+
+// runs the workload without a timer, then with VIA timer 1 interrupting it every PERIOD cycles (an IRQ handler acknowledging it)
+// the counter is never ticked : the cost of the timer is one event and one interrupt per period
+class timer : public benchUnit {
+	public:
+		void run() {
+			std::cout << "VIA timer benchmark (" << std::dec << CYCLES << " cycles)" << std::endl;
+			measure(0, "no timer");
+			measure(10000, "every 10000");
+			measure(1000, "every 1000");
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t CYCLES = 200000000;
+
+		void measure(uint32_t period, const char *name) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			m6502::CPU cpu;
+			m6502::SCHEDULER scheduler;
+			m6502::VIA via(&scheduler);
+			mem.init(&cycles);
+			loadWorkload(mem);
+			if (period != 0) {
+				// starts timer 1 free-running (latch period - 2), enables its interrupt, then jumps to the workload
+				m6502::WORD latch = period - 2;
+				std::vector<m6502::BYTE> setup = {
+					m6502::CPU::ins_lda_im, 0x40,							// 2300 : lda #$40
+					m6502::CPU::ins_sta_abs, 0x0B, 0xD0,					// 2302 : sta $D00B
+					m6502::CPU::ins_lda_im, (m6502::BYTE)(latch & 0xFF),	// 2305 : lda #<latch
+					m6502::CPU::ins_sta_abs, 0x04, 0xD0,					// 2307 : sta $D004
+					m6502::CPU::ins_lda_im, (m6502::BYTE)(latch >> 8),		// 230A : lda #>latch
+					m6502::CPU::ins_sta_abs, 0x05, 0xD0,					// 230C : sta $D005
+					m6502::CPU::ins_lda_im, 0xC0,							// 230F : lda #$C0
+					m6502::CPU::ins_sta_abs, 0x0E, 0xD0,					// 2311 : sta $D00E
+					m6502::CPU::ins_cli,									// 2314 : cli
+					m6502::CPU::ins_jmp_abs, 0x00, 0x20						// 2315 : jmp $2000
+				};
+				std::vector<m6502::BYTE> irq = {
+					m6502::CPU::ins_pha,									// 2200 : pha
+					m6502::CPU::ins_lda_abs, 0x04, 0xD0,					// 2201 : lda $D004
+					m6502::CPU::ins_pla,									// 2204 : pla
+					m6502::CPU::ins_rti										// 2205 : rti
+				};
+				for (size_t i = 0; i < setup.size(); i++) {
+					mem.at(0x2300 + i) = setup[i];
+				}
+				for (size_t i = 0; i < irq.size(); i++) {
+					mem.at(0x2200 + i) = irq[i];
+				}
+				mem.at(0xFFFC) = 0x00;
+				mem.at(0xFFFD) = 0x23;
+				mem.at(0xFFFE) = 0x00;
+				mem.at(0xFFFF) = 0x22;
+				via.attach(mem, 0xD0);
+				cpu.scheduler = &scheduler;
+			}
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			cpu.execute(cycles, mem);
+			double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count() / 1e9;
+			std::cout << "  " << std::left << std::setw(12) << name << std::right << ": " << std::fixed << std::setprecision(1) << CYCLES / seconds / 1e6
+				<< " emulated MHz, " << cpu.interrupts << " interrupts, " << via.underflows << " underflows" << std::defaultfloat << std::endl;
+		}
+}; // class timer : public benchUnit
+
+// loads a 24 byte program ROUNDS times : building a 64 KiB image and filling the memory with it, or writing the bytes through loadSegments
+class loading : public benchUnit {
+	public:
+		void run() {
+			std::cout << "loading benchmark (" << std::dec << ROUNDS << " loads of a 24 byte program)" << std::endl;
+			std::vector<m6502::BYTE> program(24, m6502::CPU::ins_nop);
+			std::vector<m6502::BYTE> resetVector = {0x00, 0x20};
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			mem.init(&cycles);
+			THROTTLE_CLOCK::time_point begin = THROTTLE_CLOCK::now();
+			for (uint32_t round = 0; round < ROUNDS; round++) {
+				std::vector<m6502::BYTE> image(m6502::MEMORY::MEM_SIZE, m6502::CPU::ins_nop);
+				std::copy(program.begin(), program.end(), image.begin() + 0x2000);
+				image[0xFFFC] = resetVector[0];
+				image[0xFFFD] = resetVector[1];
+				mem.fill(image);
+			}
+			report("64 KiB image", begin);
+			begin = THROTTLE_CLOCK::now();
+			for (uint32_t round = 0; round < ROUNDS; round++) {
+				m6502::loadSegments(mem, {{0x2000, program}, {0xFFFC, resetVector}});
+			}
+			report("segments", begin);
+		}
+	private:
+		typedef m6502::THROTTLE::CLOCK THROTTLE_CLOCK;
+		static constexpr uint32_t ROUNDS = 20000;
+
+		void report(const char *name, THROTTLE_CLOCK::time_point begin) {
+			double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE_CLOCK::now() - begin).count();
+			std::cout << "  " << std::left << std::setw(13) << name << std::right << ": " << std::fixed << std::setprecision(1) << ns / ROUNDS
+				<< " ns/load" << std::defaultfloat << std::endl;
+		}
+}; // class loading : public benchUnit
+
+// compares eager and lazy flags (see LAZY_FLAGS) on the dispatch workload, with per-instruction timing where flag updates weigh the most
+class flags : public benchUnit {
+	public:
+		void run() {
+			std::cout << "flags benchmark (" << std::dec << CYCLES << " cycles per policy)" << std::endl;
+			measure<m6502::CPU_T<m6502::INSTRUCTION_TIMING, m6502::EAGER_FLAGS>>("eager");
+			measure<m6502::CPU_T<m6502::INSTRUCTION_TIMING, m6502::LAZY_FLAGS>>("lazy");
+		}
+	private:
+		static constexpr uint32_t CYCLES = 200000000;
+
+		template <class CPU_TYPE>
+		void measure(const char *name) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			CPU_TYPE cpu;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			cpu.template executeWith<CPU_TYPE::DISPATCH_THREADED>(cycles, mem);
+			std::cout << "  " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+				<< (double)cpu.stats.wallTime.count() / cpu.stats.instructions << " ns/instruction, " << cpu.stats.emulatedMHz() << " emulated MHz" << std::defaultfloat << std::endl;
+		}
+}; // class flags : public benchUnit
+
+// compares instantiations of CPU_T on the dispatch workload, from the minimal one (MINIMAL_CPU : a bus access is a plain load or store of the
+// memory array) up to the full one, adding one policy at a time
+// the traced configurations keep the null sink and the scheduled ones get an empty scheduler : what is measured is the cost of the code compiled in
+class policies : public benchUnit {
+	public:
+		void run() {
+			std::cout << "policies benchmark (" << std::dec << CYCLES << " cycles per instantiation)" << std::endl;
+			measure<m6502::MINIMAL_CPU>("minimal (instruction timing, flat bus, no trace, no interrupts)");
+			measure<m6502::CPU_T<m6502::INSTRUCTION_TIMING, m6502::EAGER_FLAGS, m6502::PAGED_BUS, m6502::NO_TRACE, m6502::NO_INTERRUPTS>>("+ paged bus (page table, dirty pages, decode cache checks)");
+			measure<m6502::CPU_T<m6502::EXACT_TIMING, m6502::EAGER_FLAGS, m6502::PAGED_BUS, m6502::NO_TRACE, m6502::NO_INTERRUPTS>>("+ exact timing");
+			measure<m6502::CPU_T<m6502::EXACT_TIMING, m6502::EAGER_FLAGS, m6502::PAGED_BUS, m6502::SINK_TRACE, m6502::NO_INTERRUPTS>>("+ sink trace");
+			measure<m6502::CPU_T<m6502::EXACT_TIMING, m6502::EAGER_FLAGS, m6502::PAGED_BUS, m6502::SINK_TRACE, m6502::SCHEDULED_INTERRUPTS>>("+ scheduled interrupts (full)");
+		}
+	private:
+		static constexpr uint32_t CYCLES = 200000000;
+
+		template <class CPU_TYPE>
+		void measure(const char *name) {
+			uint32_t cycles = 0;
+			m6502::MEMORY mem;
+			CPU_TYPE cpu;
+			m6502::SCHEDULER scheduler;
+			mem.init(&cycles);
+			loadWorkload(mem);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cpu.scheduler = &scheduler;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = CYCLES;
+			cpu.template executeWith<CPU_TYPE::DISPATCH_THREADED>(cycles, mem);
+			std::cout << "  " << std::left << std::setw(66) << name << std::right << std::fixed << std::setprecision(2)
+				<< (double)cpu.stats.wallTime.count() / cpu.stats.instructions << " ns/instruction, " << cpu.stats.emulatedMHz() << " emulated MHz" << std::defaultfloat << std::endl;
+		}
+}; // class policies : public benchUnit
+
+// usage : benchUnits [name...]
+// runs the named benchmarks, or all of them
+int main(int argc, char **argv) {
+	dispatch d;
+	banking b;
+	snapshot s;
+	batch t;
+	lockstep l;
+	jit j;
+	idle i;
+	events e;
+	timer v;
+	loading o;
+	flags f;
+	policies p;
+	std::vector<std::pair<const char *, benchUnit *>> units = {
+		{"dispatch", &d},
+		{"banking", &b},
+		{"snapshot", &s},
+		{"batch", &t},
+		{"lockstep", &l},
+		{"jit", &j},
+		{"idle", &i},
+		{"events", &e},
+		{"timer", &v},
+		{"loading", &o},
+		{"flags", &f},
+		{"policies", &p}
+	};
+	for (auto &unit : units) {
+		bool selected = (argc == 1);
+		for (int i = 1; i < argc; i++) {
+			selected |= (std::strcmp(argv[i], unit.first) == 0);
+		}
+		if (selected) {
+			unit.second->run();
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef _DECIMAL_H
+#define _DECIMAL_H
+
+#include <cstdint>
+
+namespace m6502 {
+
+	typedef uint8_t BYTE;	// uint8_t (1 byte)
+	typedef uint16_t WORD;	// uint16_t (2 bytes)
+
+	// decimal mode arithmetic of the NMOS 6502, computed once into tables indexed by (carry, A, operand) : an ADC or SBC with the decimal flag set
+	// costs one load, like the binary ones
+	// as on the NMOS part, Z comes from the binary result, N and V from the high digit before its decimal adjust (ADC) or from the binary result (SBC),
+	// and C is the decimal carry (ADC) or the binary borrow (SBC). Invalid BCD digits go through the same adjust steps, as on the chip
+	// the tables are built at run time, once per program during static initialization (evaluated at compile time, they took seconds in every
+	// translation unit including 6502.h and 512 KiB in every binary). As namespace-scope objects, reading them costs no initialization guard
+	// (a static initializer of another translation unit must not run decimal arithmetic)
+	namespace decimal {
+		// every outcome of ADC or SBC : the result in the low byte, N, V, Z and C in the high byte at their status register bits (0b11000011)
+		struct TABLE {
+			public:
+				// builds the table of SBC (subtraction) or ADC
+				explicit TABLE(bool subtraction) {
+					if (subtraction) {
+						fillSubtractions();
+					} else {
+						fillAdditions();
+					}
+				}
+
+				WORD operator[](uint32_t index) const {
+					return entries[index];
+				}
+			private:
+				void fillAdditions() {
+					uint32_t i = 0;
+					for (int carry = 0; carry < 2; carry++) {
+						for (int acc = 0; acc < 0x100; acc++) {
+							for (int operand = 0; operand < 0x100; operand++) {
+								int low = (acc & 0x0F) + (operand & 0x0F) + carry;
+								if (low > 0x09) {
+									low += 0x06;
+								}
+								int high = (acc >> 4) + (operand >> 4) + (low > 0x0F);
+								int flags = (((acc + operand + carry) & 0xFF) == 0 ? 0b00000010 : 0) | ((high << 4) & 0b10000000)
+									| ((~(acc ^ operand) & (acc ^ (high << 4)) & 0b10000000) >> 1);
+								if (high > 0x09) {
+									high += 0x06;
+								}
+								flags |= (high > 0x0F);
+								entries[i++] = (WORD)((high & 0x0F) << 4 | (low & 0x0F) | flags << 8);
+							}
+						}
+					}
+				}
+
+				void fillSubtractions() {
+					uint32_t i = 0;
+					for (int carry = 0; carry < 2; carry++) {
+						for (int acc = 0; acc < 0x100; acc++) {
+							for (int operand = 0; operand < 0x100; operand++) {
+								int binary = acc - operand - (1 - carry);
+								int flags = ((binary & 0xFF) == 0 ? 0b00000010 : 0) | (binary & 0b10000000) | (((acc ^ operand) & (acc ^ binary) & 0b10000000) >> 1) | (binary >= 0);
+								int low = (acc & 0x0F) - (operand & 0x0F) - (1 - carry);
+								int high = (acc >> 4) - (operand >> 4);
+								if (low & 0x10) {
+									low -= 0x06;
+									high--;
+								}
+								if (high & 0x10) {
+									high -= 0x06;
+								}
+								entries[i++] = (WORD)((high & 0x0F) << 4 | (low & 0x0F) | flags << 8);
+							}
+						}
+					}
+				}
+
+				WORD entries[0x20000];
+		}; // struct TABLE
+
+		// returns the table index of an operation with the carry flag carry, the accumulator acc and operand
+		constexpr uint32_t index(bool carry, BYTE acc, BYTE operand) {
+			return (uint32_t)carry << 16 | acc << 8 | operand;
+		}
+
+		inline const TABLE additions(false);	// ADC table (one per program, shared by every thread)
+		inline const TABLE subtractions(true);	// SBC table
+	} // namespace decimal
+} // namespace m6502
+
+#endif // ifndef _DECIMAL_H
@@ -0,0 +1,216 @@
+#ifndef _DISASM_H
+#define _DISASM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+
+#include "6502.h"
+
+namespace m6502 {
+
+	#define M6502_NAME_ENTRY(name, operation, mode, cycles) table[CPU::ins_##name] = #name;
+
+	// builds the 256-entry table of handler names (see M6502_OPCODES). Unimplemented opcodes are nullptr
+	constexpr std::array<const char *, 256> opcodeNameTable() {
+		std::array<const char *, 256> table{};
+		M6502_OPCODES(M6502_NAME_ENTRY)
+		return table;
+	}
+
+	// table-driven disassembler generated from M6502_OPCODES : the mnemonic is the handler name up to its '_', the operand syntax comes from the addressing mode
+	// unimplemented opcodes disassemble as ".byte $xx"
+	struct DISASSEMBLER {
+		public:
+			// returns the length in bytes of the instruction starting with opcode (1 for unimplemented opcodes)
+			static BYTE length(BYTE opcode) {
+				static constexpr std::array<BYTE, 256> modes = CPU::modeTable();
+				return 1 + CPU::operandLength(modes[opcode]);
+			}
+
+			// formats the instruction at address whose bytes (length(bytes[0]) of them) are bytes, as "lda $10,x"
+			static std::string format(WORD address, const BYTE *bytes) {
+				// handler name of each opcode, nullptr if unimplemented
+				static constexpr std::array<const char *, 256> names = opcodeNameTable();
+				static constexpr std::array<BYTE, 256> modes = CPU::modeTable();
+				const char *name = names[bytes[0]];
+				char text[24];
+				if (name == nullptr) {
+					std::snprintf(text, sizeof(text), ".byte $%02x", bytes[0]);
+					return text;
+				}
+				std::string mnemonic(name, 3);
+				WORD word = bytes[1] | bytes[2] << 8;
+				switch (modes[bytes[0]]) {
+					case CPU::am_imp:
+						// the accumulator forms are the implied ones named <mnemonic>_acc
+						return (name[3] == '_' ? mnemonic + " a" : mnemonic);
+					case CPU::am_imm:
+						std::snprintf(text, sizeof(text), " #$%02x", bytes[1]);
+						break;
+					case CPU::am_zp:
+						std::snprintf(text, sizeof(text), " $%02x", bytes[1]);
+						break;
+					case CPU::am_zpx:
+						std::snprintf(text, sizeof(text), " $%02x,x", bytes[1]);
+						break;
+					case CPU::am_zpy:
+						std::snprintf(text, sizeof(text), " $%02x,y", bytes[1]);
+						break;
+					case CPU::am_abs:
+						std::snprintf(text, sizeof(text), " $%04x", word);
+						break;
+					case CPU::am_absx:
+						std::snprintf(text, sizeof(text), " $%04x,x", word);
+						break;
+					case CPU::am_absy:
+						std::snprintf(text, sizeof(text), " $%04x,y", word);
+						break;
+					case CPU::am_ind:
+						std::snprintf(text, sizeof(text), " ($%04x)", word);
+						break;
+					case CPU::am_indx:
+						std::snprintf(text, sizeof(text), " ($%02x,x)", bytes[1]);
+						break;
+					case CPU::am_indy:
+						std::snprintf(text, sizeof(text), " ($%02x),y", bytes[1]);
+						break;
+					case CPU::am_rel:
+						// shows the branch target
+						std::snprintf(text, sizeof(text), " $%04x", (WORD)(address + 2 + (int8_t)bytes[1]));
+						break;
+				}
+				return mnemonic + text;
+			}
+
+			// formats the instruction at address of mem, read through the page table without side effects or cycles
+			// an instruction with bytes on a device page is shown as "???" (reading them could change the device)
+			static std::string format(const MEMORY &mem, WORD address) {
+				BYTE bytes[3] = {0, 0, 0};
+				if (!peek(mem, address, bytes[0])) {
+					return "???";
+				}
+				for (BYTE i = 1; i < length(bytes[0]); i++) {
+					if (!peek(mem, address + i, bytes[i])) {
+						return "???";
+					}
+				}
+				return format(address, bytes);
+			}
+
+			// writes count instructions of mem from address, one "addr  bytes  instruction" line each (a listing for a debugger)
+			static void list(std::ostream &out, const MEMORY &mem, WORD address, size_t count) {
+				for (size_t i = 0; i < count; i++) {
+					BYTE bytes[3] = {0, 0, 0};
+					bool readable = peek(mem, address, bytes[0]);
+					BYTE instructionLength = length(bytes[0]);
+					for (BYTE j = 1; j < instructionLength; j++) {
+						readable &= peek(mem, address + j, bytes[j]);
+					}
+					out << line(address, bytes, instructionLength) << (readable ? format(address, bytes) : "???") << '\n';
+					address += instructionLength;
+				}
+			}
+
+			// formats "addr  bytes  " (the start of a listing line) for an instruction of instructionLength bytes
+			static std::string line(WORD address, const BYTE *bytes, BYTE instructionLength) {
+				char text[20];
+				int used = std::snprintf(text, sizeof(text), "%04x  ", address);
+				for (BYTE i = 0; i < 3; i++) {
+					used += (i < instructionLength ? std::snprintf(text + used, sizeof(text) - used, "%02x ", bytes[i]) : std::snprintf(text + used, sizeof(text) - used, "   "));
+				}
+				std::snprintf(text + used, sizeof(text) - used, " ");
+				return text;
+			}
+		private:
+			// reads address through the page table. Returns false on a device page
+			static bool peek(const MEMORY &mem, WORD address, BYTE &value) {
+				const BYTE *page = mem.readPage(address >> 8);
+				if (page == nullptr) {
+					return false;
+				}
+				value = page[address & 0xFF];
+				return true;
+			}
+
+	}; // struct DISASSEMBLER
+
+	// one instruction seen by INSTRUCTION_TRACE_SINK : raw bytes only, formatted on demand
+	struct INSTRUCTION_RECORD {
+		uint64_t cycle;		// absolute emulated time of the opcode fetch
+		WORD address;		// address of the opcode
+		BYTE bytes[3];		// opcode and operand bytes (as many as were fetched)
+		BYTE fetched;		// bytes fetched from address onwards
+
+		// returns the instruction as "lda $10,x"
+		std::string text() const {
+			return DISASSEMBLER::format(address, bytes);
+		}
+	}; // struct INSTRUCTION_RECORD
+
+	// records the last instructions a traced CPU executed (up to capacity, a power of two), as the address and bytes fetched :
+	// nothing is decoded or formatted while the CPU runs, and the records stay in a fixed ring that does not grow with the run
+	// every access is also passed on to next (if not nullptr), so a bus trace and an instruction trace can be taken in the same run
+	struct INSTRUCTION_TRACE_SINK : public TRACE_SINK {
+		public:
+			INSTRUCTION_TRACE_SINK(TRACE_SINK *nNext = nullptr, size_t capacity = 1 << 16) : next(nNext), records(capacity), mask(capacity - 1) {}
+
+			void instruction(uint64_t cycle, WORD address) {
+				current = &records[total++ & mask];
+				*current = {cycle, address, {0, 0, 0}, 0};
+				if (next != nullptr) {
+					next->instruction(cycle, address);
+				}
+			}
+
+			void access(uint64_t cycle, WORD address, bool read, BYTE value) {
+				// the opcode and operand fetches are the reads following the instruction address (other reads stop the capture once 3 bytes are in)
+				if (current != nullptr && read && address == (WORD)(current->address + current->fetched)) {
+					current->bytes[current->fetched++] = value;
+					if (current->fetched == 3) {
+						current = nullptr;
+					}
+				}
+				if (next != nullptr) {
+					next->access(cycle, address, read, value);
+				}
+			}
+
+			void flush() {
+				if (next != nullptr) {
+					next->flush();
+				}
+			}
+
+			// returns the number of records kept (the last instructions, at most capacity)
+			size_t size() const {
+				return std::min(total, (uint64_t)records.size());
+			}
+
+			// returns record i of those kept, 0 being the oldest
+			const INSTRUCTION_RECORD &operator[](size_t i) const {
+				return records[(total - size() + i) & mask];
+			}
+
+			// writes the records kept as "cycle addr  bytes  instruction" lines, oldest first
+			void write(std::ostream &out) const {
+				for (size_t i = 0; i < size(); i++) {
+					const INSTRUCTION_RECORD &record = (*this)[i];
+					out << record.cycle << ' ' << DISASSEMBLER::line(record.address, record.bytes, DISASSEMBLER::length(record.bytes[0])) << record.text() << '\n';
+				}
+			}
+
+			uint64_t total = 0;		// instructions recorded since construction, kept or not
+		private:
+			TRACE_SINK *next;
+			std::vector<INSTRUCTION_RECORD> records;
+			size_t mask;
+			INSTRUCTION_RECORD *current = nullptr;		// record still taking fetched bytes
+	}; // struct INSTRUCTION_TRACE_SINK : public TRACE_SINK
+} // namespace m6502
+
+#endif // ifndef _DISASM_H
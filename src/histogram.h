@@ -0,0 +1,120 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+namespace m6502 {
+
+	typedef uint8_t BYTE;	// uint8_t (1 byte)
+	typedef uint16_t WORD;	// uint16_t (2 bytes)
+
+	// execution counters fed by a CPU compiled with M6502_HISTOGRAM defined (without it, the CPU contains no counting code at all) :
+	// instructions run per opcode, page crosses of the indexed addressing modes and branches taken or not, per branch opcode
+	// plain counters, not atomics : each thread counts into its own HISTOGRAM (one per CPU), and the totals are made with merge once the threads are done
+	struct HISTOGRAM {
+		public:
+			// indexed addressing modes whose reads take an extra cycle on a page cross
+			enum INDEXED : BYTE {
+				ABSOLUTE_X = 0,		// CPU::absoluteXAddressing
+				ABSOLUTE_Y = 1,		// CPU::absoluteYAddressing
+				INDIRECT_Y = 2,		// CPU::indirectYAddressing
+				INDEXED_MODES = 3
+			};
+
+			// reads through one indexed addressing mode (writes and read-modify-writes always take the extra cycle, they are not counted)
+			struct PAGE_CROSS {
+				uint64_t reads;
+				uint64_t crosses;	// reads that crossed a page and took the extra cycle
+			}; // struct PAGE_CROSS
+
+			// outcomes of one branch opcode
+			struct BRANCH {
+				uint64_t taken;
+				uint64_t notTaken;
+				uint64_t crosses;	// taken branches landing on another page (one more extra cycle)
+			}; // struct BRANCH
+
+			HISTOGRAM() {
+				clear();
+			}
+
+			// called by the CPU at each opcode fetch
+			void instruction(BYTE opcode) {
+				opcodes[opcode]++;
+				current = opcode;
+			}
+
+			// called by the indexed addressing helpers for each read. crossed : the page was crossed and the extra cycle taken
+			void indexed(INDEXED mode, bool crossed) {
+				pageCrosses[mode].reads++;
+				pageCrosses[mode].crosses += crossed;
+			}
+
+			// called by CPU::branch for the branch being run (the last opcode fetched)
+			void branch(bool taken, bool crossed) {
+				BRANCH &counts = branches[current];
+				if (taken) {
+					counts.taken++;
+					counts.crosses += crossed;
+				} else {
+					counts.notTaken++;
+				}
+			}
+
+			// adds the counts of other (another thread's histogram) to these
+			void merge(const HISTOGRAM &other) {
+				for (size_t i = 0; i < opcodes.size(); i++) {
+					opcodes[i] += other.opcodes[i];
+					branches[i].taken += other.branches[i].taken;
+					branches[i].notTaken += other.branches[i].notTaken;
+					branches[i].crosses += other.branches[i].crosses;
+				}
+				for (size_t i = 0; i < pageCrosses.size(); i++) {
+					pageCrosses[i].reads += other.pageCrosses[i].reads;
+					pageCrosses[i].crosses += other.pageCrosses[i].crosses;
+				}
+			}
+
+			// forgets every count
+			void clear() {
+				opcodes.fill(0);
+				pageCrosses.fill({0, 0});
+				branches.fill({0, 0, 0});
+				current = 0;
+			}
+
+			// returns the total of instructions counted
+			uint64_t instructions() const {
+				uint64_t total = 0;
+				for (uint64_t count : opcodes) {
+					total += count;
+				}
+				return total;
+			}
+
+			// returns the opcodes run at least once, most frequent first (the candidates for fast paths)
+			std::vector<BYTE> ranking() const {
+				std::vector<BYTE> result;
+				for (size_t i = 0; i < opcodes.size(); i++) {
+					if (opcodes[i] > 0) {
+						result.push_back((BYTE)i);
+					}
+				}
+				std::stable_sort(result.begin(), result.end(), [this](BYTE first, BYTE second) {
+					return opcodes[first] > opcodes[second];
+				});
+				return result;
+			}
+
+			std::array<uint64_t, 256> opcodes;					// instructions run per opcode
+			std::array<PAGE_CROSS, INDEXED_MODES> pageCrosses;	// per INDEXED mode
+			std::array<BRANCH, 256> branches;					// per branch opcode (zero for the others)
+		private:
+			BYTE current;	// opcode of the instruction being run
+	}; // struct HISTOGRAM
+} // namespace m6502
+
+#endif // ifndef _HISTOGRAM_H
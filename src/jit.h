@@ -0,0 +1,881 @@
+#ifndef _JIT_H
+#define _JIT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "6502.h"
+
+// compiled blocks need an x86-64 host with mmap / mprotect. Elsewhere JIT_T::execute always interprets
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define M6502_JIT_NATIVE 1
+#else
+#define M6502_JIT_NATIVE 0
+#endif
+
+namespace m6502 {
+
+	// machine state handed to a compiled block. The generated code addresses the members by their offsets
+	struct JIT_STATE {
+		BYTE acc;
+		BYTE x;
+		BYTE y;
+		BYTE stackPointer;
+		BYTE carry;					// flags (0 or 1)
+		BYTE zero;
+		BYTE interr;
+		BYTE dec;
+		BYTE oflow;
+		BYTE neg;
+		WORD programCounter;		// where the block exited
+		uint32_t cycles;			// cycles left in the slice, lowered by the block at each exit
+		uint32_t instructions;		// instructions run by the block
+	}; // struct JIT_STATE
+
+	// x86-64 encoder for the few instructions the block compiler emits
+	// byte registers are limited to al, cl, dl and r8b to r11b, so no REX prefix is needed for the others
+	struct X64_EMITTER {
+		public:
+			static constexpr int RAX = 0;
+			static constexpr int RCX = 1;
+			static constexpr int RDX = 2;
+			static constexpr int RSI = 6;
+			static constexpr int RDI = 7;
+			static constexpr int R8 = 8;
+			static constexpr int R9 = 9;
+			static constexpr int R10 = 10;
+			static constexpr int R11 = 11;
+
+			static constexpr int CC_AE = 0x3;	// condition codes of jcc and setcc
+			static constexpr int CC_E = 0x4;
+			static constexpr int CC_NE = 0x5;
+			static constexpr int CC_S = 0x8;
+			static constexpr int ALWAYS = -1;
+
+			std::vector<BYTE> code;
+
+			void emit(BYTE value) {
+				code.push_back(value);
+			}
+
+			void emit32(uint32_t value) {
+				for (int i = 0; i < 4; i++) {
+					emit(value >> (8 * i));
+				}
+			}
+
+			// movzx reg32, byte [rdi + offset]
+			void loadState8(int reg, BYTE offset) {
+				rex(false, reg, RDI);
+				emit(0x0F);
+				emit(0xB6);
+				emit(0x40 | (reg & 7) << 3 | RDI);
+				emit(offset);
+			}
+
+			// mov byte [rdi + offset], reg8
+			void storeState8(int reg, BYTE offset) {
+				rex(false, reg, RDI);
+				emit(0x88);
+				emit(0x40 | (reg & 7) << 3 | RDI);
+				emit(offset);
+			}
+
+			// mov reg32, dword [rdi + offset]
+			void loadState32(int reg, BYTE offset) {
+				rex(false, reg, RDI);
+				emit(0x8B);
+				emit(0x40 | (reg & 7) << 3 | RDI);
+				emit(offset);
+			}
+
+			// mov dword [rdi + offset], reg32
+			void storeState32(int reg, BYTE offset) {
+				rex(false, reg, RDI);
+				emit(0x89);
+				emit(0x40 | (reg & 7) << 3 | RDI);
+				emit(offset);
+			}
+
+			// mov byte [rdi + offset], value
+			void storeStateImm8(BYTE offset, BYTE value) {
+				emit(0xC6);
+				emit(0x47);
+				emit(offset);
+				emit(value);
+			}
+
+			// mov word [rdi + offset], value
+			void storeStateImm16(BYTE offset, WORD value) {
+				emit(0x66);
+				emit(0xC7);
+				emit(0x47);
+				emit(offset);
+				emit(value & 0xFF);
+				emit(value >> 8);
+			}
+
+			// add dword [rdi + offset], value
+			void addStateImm32(BYTE offset, uint32_t value) {
+				emit(0x81);
+				emit(0x47);
+				emit(offset);
+				emit32(value);
+			}
+
+			// cmp byte [rdi + offset], value
+			void compareStateImm8(BYTE offset, BYTE value) {
+				emit(0x80);
+				emit(0x7F);
+				emit(offset);
+				emit(value);
+			}
+
+			// setcc byte [rdi + offset]
+			void setState(int condition, BYTE offset) {
+				emit(0x0F);
+				emit(0x90 | condition);
+				emit(0x47);
+				emit(offset);
+			}
+
+			// mov dst8, src8
+			void move8(int dst, int src) {
+				rex(false, src, dst);
+				emit(0x88);
+				emit(0xC0 | (src & 7) << 3 | (dst & 7));
+			}
+
+			// mov reg8, value
+			void moveImm8(int reg, BYTE value) {
+				rex(false, 0, reg);
+				emit(0xB0 | (reg & 7));
+				emit(value);
+			}
+
+			// group 0x80 operation on reg8 (extension 1 : or, 4 : and, 6 : xor)
+			void aluImm8(int extension, int reg, BYTE value) {
+				rex(false, 0, reg);
+				emit(0x80);
+				emit(0xC0 | extension << 3 | (reg & 7));
+				emit(value);
+			}
+
+			// test reg8, reg8
+			void test8(int reg) {
+				rex(false, reg, reg);
+				emit(0x84);
+				emit(0xC0 | (reg & 7) << 3 | (reg & 7));
+			}
+
+			// inc reg8 or dec reg8
+			void incDec8(int reg, bool decrement) {
+				rex(false, 0, reg);
+				emit(0xFE);
+				emit(0xC0 | decrement << 3 | (reg & 7));
+			}
+
+			// byte operation between reg8 and [rdx] or [rdx + rax] (opcode 0x8A : load, 0x88 : store, 0x0A : or, 0x22 : and, 0x32 : xor)
+			void memory8(BYTE opcode, int reg, bool indexed) {
+				rex(false, reg, 0);
+				emit(opcode);
+				if (indexed) {
+					emit(0x04 | (reg & 7) << 3);
+					emit(RAX << 3 | RDX);
+				} else {
+					emit((reg & 7) << 3 | RDX);
+				}
+			}
+
+			// mov reg64, value
+			void moveImm64(int reg, uint64_t value) {
+				rex(true, 0, reg);
+				emit(0xB8 | (reg & 7));
+				emit32(value);
+				emit32(value >> 32);
+			}
+
+			// movzx dst32, src8
+			void moveZeroExtend(int dst, int src) {
+				rex(false, dst, src);
+				emit(0x0F);
+				emit(0xB6);
+				emit(0xC0 | (dst & 7) << 3 | (src & 7));
+			}
+
+			// group 0x81 operation on reg32 (extension 0 : add, 4 : and, 7 : cmp)
+			void aluImm32(int extension, int reg, uint32_t value) {
+				rex(false, 0, reg);
+				emit(0x81);
+				emit(0xC0 | extension << 3 | (reg & 7));
+				emit32(value);
+			}
+
+			// operation between two reg32 (opcode 0x01 : add, 0x29 : sub, 0x31 : xor)
+			void alu32(BYTE opcode, int dst, int src) {
+				rex(false, src, dst);
+				emit(opcode);
+				emit(0xC0 | (src & 7) << 3 | (dst & 7));
+			}
+
+			// shr reg32, count
+			void shiftRight32(int reg, BYTE count) {
+				rex(false, 0, reg);
+				emit(0xC1);
+				emit(0xE8 | (reg & 7));
+				emit(count);
+			}
+
+			// lea dst32, [base + displacement]
+			void loadAddress32(int dst, int base, uint32_t displacement) {
+				rex(false, dst, base);
+				emit(0x8D);
+				emit(0x80 | (dst & 7) << 3 | (base & 7));
+				emit32(displacement);
+			}
+
+			// jcc or jmp with a 32-bit displacement. Returns the position of the displacement for patch
+			size_t jump(int condition) {
+				if (condition == ALWAYS) {
+					emit(0xE9);
+				} else {
+					emit(0x0F);
+					emit(0x80 | condition);
+				}
+				size_t position = code.size();
+				emit32(0);
+				return position;
+			}
+
+			// points the jump whose displacement is at position to target (an offset in code)
+			void patch(size_t position, size_t target) {
+				int32_t displacement = (int32_t)(target - (position + 4));
+				std::memcpy(&code[position], &displacement, 4);
+			}
+
+			void ret() {
+				emit(0xC3);
+			}
+		private:
+			// REX prefix when a 64-bit operand or a register above rdi is used
+			void rex(bool wide, int reg, int rm) {
+				BYTE prefix = 0x40 | wide << 3 | (reg >> 3) << 2 | (rm >> 3);
+				if (prefix != 0x40) {
+					emit(prefix);
+				}
+			}
+	}; // struct X64_EMITTER
+
+	// basic-block compiler for CPU_TYPE (CPU or FAST_CPU) : runs like CPU::execute, with hot code compiled to x86-64
+	// branch and jump targets reached hotThreshold times start a block, which runs up to the first branch, jump, instruction the compiler does not handle,
+	// or the end of its page. A block ending with a branch or jump back to its start loops in native code
+	// blocks charge the exact cycles of the path taken at each exit (base costs, page crosses and taken branches), and only start when one pass fits in
+	// the remaining budget, so a run stops on the same instruction and cycle as the interpreter
+	// everything else is interpreted with CPU::step up to the next jump or taken branch : instructions not compiled, code in device pages and accesses to
+	// device pages, stores to pages holding compiled code, and the last cycles of a budget. Tracing or profiling CPUs and CPUs with a scheduler run on CPU::execute
+	// compiled code is dropped when the interpreter writes to its page (seen through CPU::decodeCache), and entirely when the memory is remapped
+	// a page rewritten MAX_PAGE_DROPS times is left to the interpreter, since recompiling it would cost more than it saves
+	template <class CPU_TYPE>
+	struct JIT_T {
+		public:
+			static constexpr uint32_t BUFFER_SIZE = 1 << 20;	// executable buffer, flushed when full
+			static constexpr uint32_t MAX_INSTRUCTIONS = 64;	// longest block
+			static constexpr uint32_t MIN_INSTRUCTIONS = 4;		// shortest block that does not loop to its own start
+			static constexpr BYTE MAX_PAGE_DROPS = 16;			// pages whose blocks were dropped this many times (code rewritten in a loop) are only interpreted
+
+			bool enabled = true;		// runtime switch : execute only interprets when false
+			BYTE hotThreshold = 8;		// times a branch or jump target is reached before its block is compiled (at most 255)
+
+			uint64_t compiledBlocks = 0;			// blocks compiled
+			uint64_t droppedBlocks = 0;				// blocks thrown away because their page was written or the memory remapped
+			uint64_t blockRuns = 0;					// entries into compiled code
+			uint64_t nativeInstructions = 0;		// instructions run by compiled code
+			uint64_t interpretedInstructions = 0;	// instructions run by CPU::step
+
+			JIT_T() : heat(MEMORY::MEM_SIZE, 0), blockAt(MEMORY::MEM_SIZE, NO_BLOCK) {}
+
+			JIT_T(const JIT_T &) = delete;
+			JIT_T &operator=(const JIT_T &) = delete;
+
+			~JIT_T() {
+#if M6502_JIT_NATIVE
+				if (buffer != nullptr) {
+					munmap(buffer, BUFFER_SIZE);
+				}
+#endif
+			}
+
+			// returns true if blocks can be compiled on this host
+			static constexpr bool available() {
+				return M6502_JIT_NATIVE;
+			}
+
+			// executes instructions at cpu.reg_programCounter while cycles is greater than 0, like cpu.execute(cycles, mem)
+			void execute(CPU_TYPE &cpu, uint32_t &cycles, MEMORY &mem) {
+				// compiled code does not report its bus accesses
+				bool traced = cpu.traced();
+#ifdef M6502_PROFILE
+				// nor its instructions
+				traced |= (cpu.profiler != nullptr);
+#endif
+#ifdef M6502_HISTOGRAM
+				// nor its opcodes
+				traced |= (cpu.histogram != nullptr);
+#endif
+				// compiled blocks do not stop at events : a machine with a scheduler is only interpreted
+				if (!enabled || !available() || traced || cpu.scheduled()) {
+					cpu.execute(cycles, mem);
+					return;
+				}
+				if (&mem != memory || &cpu != owner) {
+					std::fill(std::begin(pageDrops), std::end(pageDrops), 0);
+				}
+				if (&mem != memory || &cpu != owner || mem.generation() != generation) {
+					flush();
+					memory = &mem;
+					owner = &cpu;
+					generation = mem.generation();
+				}
+				uint32_t startCycles = cycles;
+				uint64_t instructions = 0;
+				THROTTLE::CLOCK::time_point startTime = THROTTLE::CLOCK::now();
+				cpu.throttle.start();
+				while (cycles > 0 && cycles < 0xFFFFFFFA) {
+					WORD programCounter = cpu.reg_programCounter;
+					int32_t index = blockAt[programCounter];
+					if (index == NO_BLOCK && heat[programCounter] >= hotThreshold) {
+						index = compile(cpu, mem, programCounter);
+					}
+					if (index >= 0 && cycles >= blocks[index].maxCycles) {
+						instructions += runBlock(cpu, cycles, mem, blocks[index]);
+					} else {
+						instructions += interpret(cpu, cycles, mem);
+					}
+					cpu.throttle.sync((uint32_t)(startCycles - cycles));
+				}
+				cpu.stats.instructions = instructions;
+				cpu.stats.cycles = (uint32_t)(startCycles - cycles);
+				cpu.stats.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(THROTTLE::CLOCK::now() - startTime);
+			}
+
+			// throws away every compiled block
+			void flush() {
+				for (BLOCK &block : blocks) {
+					blockAt[block.start] = NO_BLOCK;
+					droppedBlocks += block.live;
+				}
+				for (WORD address : uncompilable) {
+					blockAt[address] = NO_BLOCK;
+				}
+				blocks.clear();
+				uncompilable.clear();
+				std::fill(std::begin(blocksInPage), std::end(blocksInPage), 0);
+				used = 0;
+			}
+		private:
+			static constexpr int32_t NO_BLOCK = -1;			// blockAt of an address not compiled yet
+			static constexpr int32_t UNCOMPILABLE = -2;		// blockAt of an address whose first instruction cannot be compiled
+
+			typedef void (*ENTRY)(JIT_STATE *state);
+
+			// compiled block
+			struct BLOCK {
+				WORD start;
+				BYTE page;						// page holding all the code of the block
+				uint32_t maxCycles;				// cost of one pass with every penalty : the block only starts with this many cycles left
+				std::vector<BYTE> storePages;	// pages written by the block
+				ENTRY entry;
+				bool live;						// false once dropped
+			}; // struct BLOCK
+
+			// runs instructions in the interpreter up to the next jump or taken branch (which are the only way into a block), counts its target
+			// and drops the blocks of the pages written meanwhile. Returns the instructions it ran
+			uint64_t interpret(CPU_TYPE &cpu, uint32_t &cycles, MEMORY &mem) {
+				uint64_t invalidations = cpu.decodeCache.invalidations;
+				uint64_t skipped = cpu.idleLoop.skippedInstructions;
+				uint64_t count = 0;
+				WORD distance;
+				do {
+					WORD programCounter = cpu.reg_programCounter;
+					cpu.step(cycles, mem);
+					count++;
+					// instructions are 1 to 3 bytes long : anything else was reached by a jump or a taken branch (a branch skipping 1 byte is missed)
+					distance = cpu.reg_programCounter - programCounter;
+				} while (distance >= 1 && distance <= 3 && cycles > 0 && cycles < 0xFFFFFFFA);
+				// idle loop passes skipped by the interpreter count as interpreted instructions
+				count += cpu.idleLoop.skippedInstructions - skipped;
+				interpretedInstructions += count;
+				if (cpu.decodeCache.invalidations != invalidations) {
+					dropWrittenPages(cpu);
+				}
+				if (mem.generation() != generation) {
+					flush();
+					generation = mem.generation();
+				}
+				if ((distance < 1 || distance > 3) && heat[cpu.reg_programCounter] < 255) {
+					heat[cpu.reg_programCounter]++;
+				}
+				return count;
+			}
+
+			// runs a compiled block once (or several times if it loops) and returns the instructions it ran
+			uint64_t runBlock(CPU_TYPE &cpu, uint32_t &cycles, MEMORY &mem, const BLOCK &block) {
+				uint32_t slice = cycles;
+				if (cpu.throttle.mode != THROTTLE::UNTHROTTLED) {
+					// keeps native loops short enough for pacing
+					slice = std::min(cycles, std::max(cpu.throttle.batchCycles, block.maxCycles));
+				}
+				JIT_STATE state = {cpu.reg_acc, cpu.reg_x, cpu.reg_y, cpu.reg_stackPointer, cpu.fl_carry, cpu.fl_zero, cpu.fl_interr, cpu.fl_dec, cpu.fl_oflow, cpu.fl_neg,
+					cpu.reg_programCounter, slice, 0};
+				block.entry(&state);
+				cpu.reg_acc = state.acc;
+				cpu.reg_x = state.x;
+				cpu.reg_y = state.y;
+				cpu.reg_stackPointer = state.stackPointer;
+				cpu.fl_carry = state.carry;
+				cpu.fl_zero = state.zero;
+				cpu.fl_interr = state.interr;
+				cpu.fl_dec = state.dec;
+				cpu.fl_oflow = state.oflow;
+				cpu.fl_neg = state.neg;
+				cpu.reg_programCounter = state.programCounter;
+				uint32_t spent = slice - state.cycles;
+				cycles -= spent;
+				cpu.cycleClock += spent;
+				for (BYTE page : block.storePages) {
+					mem.markWritten(page);
+				}
+				blockRuns++;
+				nativeInstructions += state.instructions;
+				countTarget(state.programCounter, block.start);
+				return state.instructions;
+			}
+
+			// counts a visit to target if it was reached by a branch or jump (or a block exit), rather than by running on to next
+			void countTarget(WORD target, WORD next) {
+				if (target != next && heat[target] < 255) {
+					heat[target]++;
+				}
+			}
+
+			// drops the blocks of the pages whose code flag the interpreter cleared by writing to them
+			void dropWrittenPages(CPU_TYPE &cpu) {
+				for (uint32_t page = 0; page < MEMORY::PAGES; page++) {
+					if (blocksInPage[page] > 0 && !cpu.decodeCache.code[page]) {
+						dropPage(page);
+					}
+				}
+			}
+
+			void dropPage(BYTE page) {
+				if (pageDrops[page] < MAX_PAGE_DROPS) {
+					pageDrops[page]++;
+				}
+				for (BLOCK &block : blocks) {
+					if (block.live && block.page == page) {
+						kill(block);
+					}
+				}
+				for (WORD address : uncompilable) {
+					if ((address >> 8) == page) {
+						blockAt[address] = NO_BLOCK;
+					}
+				}
+			}
+
+			void kill(BLOCK &block) {
+				block.live = false;
+				blockAt[block.start] = NO_BLOCK;
+				blocksInPage[block.page]--;
+				droppedBlocks++;
+			}
+
+			// compiles the block starting at start. Returns its index in blocks, or UNCOMPILABLE
+			int32_t compile(CPU_TYPE &cpu, MEMORY &mem, WORD start) {
+				static constexpr std::array<BYTE, 256> modes = CPU::modeTable();
+				static constexpr std::array<BYTE, 256> costs = CPU::cycleTable();
+				BYTE page = start >> 8;
+				BLOCK block = {start, page, 0, {}, nullptr, true};
+				X64_EMITTER e;
+				if (!mem.isDevice(page) && pageDrops[page] < MAX_PAGE_DROPS) {
+					e.loadState8(X64_EMITTER::R8, offsetof(JIT_STATE, acc));
+					e.loadState8(X64_EMITTER::R9, offsetof(JIT_STATE, x));
+					e.loadState8(X64_EMITTER::R10, offsetof(JIT_STATE, y));
+					e.loadState8(X64_EMITTER::R11, offsetof(JIT_STATE, stackPointer));
+					e.loadState32(X64_EMITTER::RSI, offsetof(JIT_STATE, cycles));
+					size_t loopStart = e.code.size();
+					// rcx counts the page-cross cycles of the current pass
+					e.alu32(0x31, X64_EMITTER::RCX, X64_EMITTER::RCX);
+					uint32_t baseCycles = 0;
+					uint32_t maxPenalties = 0;
+					uint32_t count = 0;
+					WORD address = start;
+					bool ended = false;
+					bool loops = false;
+					while (count < MAX_INSTRUCTIONS) {
+						BYTE opcode = mem.readAt(address);
+						BYTE length = CPU::operandLength(modes[opcode]);
+						if (((address + length) >> 8) != page) {
+							break;
+						}
+						WORD operand = (length == 0 ? 0 : length == 1 ? mem.readAt(address + 1) : mem.readAt(address + 1) | mem.readAt(address + 2) << 8);
+						WORD next = address + 1 + length;
+						int flag = branchFlag(opcode);
+						if (flag >= 0) {
+							WORD target = next + (int8_t)operand;
+							loops = (target == start);
+							BYTE penalty = 1 + ((target >> 8) != (next >> 8));
+							count++;
+							baseCycles += costs[opcode];
+							block.maxCycles = baseCycles + maxPenalties + penalty;
+							// branch taken if the flag equals bit 5 of the opcode (BCS, BEQ, BMI and BVS)
+							e.compareStateImm8(flag, (opcode >> 5) & 1);
+							size_t notTaken = e.jump(X64_EMITTER::CC_NE);
+							emitExit(e, block, target, baseCycles + penalty, count, loopStart);
+							e.patch(notTaken, e.code.size());
+							emitExit(e, block, next, baseCycles, count, loopStart);
+							ended = true;
+							break;
+						}
+						if (opcode == CPU::ins_jmp_abs) {
+							loops = (operand == start);
+							count++;
+							baseCycles += costs[opcode];
+							block.maxCycles = baseCycles + maxPenalties;
+							emitExit(e, block, operand, baseCycles, count, loopStart);
+							ended = true;
+							break;
+						}
+						bool penalty = false;
+						if (!emitInstruction(e, mem, block, opcode, modes[opcode], operand, penalty)) {
+							break;
+						}
+						count++;
+						baseCycles += costs[opcode];
+						maxPenalties += penalty;
+						address = next;
+					}
+					if (!ended && count > 0) {
+						block.maxCycles = baseCycles + maxPenalties;
+						emitExit(e, block, address, baseCycles, count, loopStart);
+						ended = true;
+					}
+					// entering a short straight block costs more than interpreting it
+					if (ended && (loops || count >= MIN_INSTRUCTIONS)) {
+						block.entry = install(e.code);
+					}
+				}
+				if (block.entry == nullptr) {
+					blockAt[start] = UNCOMPILABLE;
+					uncompilable.push_back(start);
+					return UNCOMPILABLE;
+				}
+				// blocks storing into this page could now overwrite compiled code
+				for (BLOCK &other : blocks) {
+					if (other.live && std::find(other.storePages.begin(), other.storePages.end(), page) != other.storePages.end()) {
+						kill(other);
+					}
+				}
+				blocksInPage[page]++;
+				// makes the interpreter report writes to the page (see dropWrittenPages)
+				cpu.decodeCache.code[page] = true;
+				blocks.push_back(block);
+				blockAt[start] = blocks.size() - 1;
+				compiledBlocks++;
+				return blocks.size() - 1;
+			}
+
+			// returns the JIT_STATE offset of the flag tested by a branch opcode, -1 for other opcodes
+			static int branchFlag(BYTE opcode) {
+				switch (opcode) {
+					case CPU::ins_bcc:
+					case CPU::ins_bcs:
+						return offsetof(JIT_STATE, carry);
+					case CPU::ins_bne:
+					case CPU::ins_beq:
+						return offsetof(JIT_STATE, zero);
+					case CPU::ins_bpl:
+					case CPU::ins_bmi:
+						return offsetof(JIT_STATE, neg);
+					case CPU::ins_bvc:
+					case CPU::ins_bvs:
+						return offsetof(JIT_STATE, oflow);
+				}
+				return -1;
+			}
+
+			// emits an exit of the block to target after a pass costing cycles plus the page crosses counted in rcx
+			// an exit back to the start of the block loops while one more pass fits in the slice
+			void emitExit(X64_EMITTER &e, const BLOCK &block, WORD target, uint32_t cycles, uint32_t count, size_t loopStart) {
+				e.loadAddress32(X64_EMITTER::RAX, X64_EMITTER::RCX, cycles);
+				e.alu32(0x29, X64_EMITTER::RSI, X64_EMITTER::RAX);
+				e.addStateImm32(offsetof(JIT_STATE, instructions), count);
+				if (target == block.start) {
+					e.aluImm32(7, X64_EMITTER::RSI, block.maxCycles);
+					e.patch(e.jump(X64_EMITTER::CC_AE), loopStart);
+				}
+				e.storeStateImm16(offsetof(JIT_STATE, programCounter), target);
+				e.storeState8(X64_EMITTER::R8, offsetof(JIT_STATE, acc));
+				e.storeState8(X64_EMITTER::R9, offsetof(JIT_STATE, x));
+				e.storeState8(X64_EMITTER::R10, offsetof(JIT_STATE, y));
+				e.storeState8(X64_EMITTER::R11, offsetof(JIT_STATE, stackPointer));
+				e.storeState32(X64_EMITTER::RSI, offsetof(JIT_STATE, cycles));
+				e.ret();
+			}
+
+			// emits one instruction that does not change the program flow. Returns false (having emitted nothing) if it must be interpreted
+			// penalty is set for indexed reads, which cost one more cycle on a page cross
+			bool emitInstruction(X64_EMITTER &e, MEMORY &mem, BLOCK &block, BYTE opcode, BYTE mode, WORD operand, bool &penalty) {
+				const int A = X64_EMITTER::R8;
+				const int X = X64_EMITTER::R9;
+				const int Y = X64_EMITTER::R10;
+				switch (opcode) {
+					case CPU::ins_lda_im:
+					case CPU::ins_lda_zp:
+					case CPU::ins_lda_zpx:
+					case CPU::ins_lda_abs:
+					case CPU::ins_lda_absx:
+					case CPU::ins_lda_absy:
+						return emitRead(e, mem, 0x8A, A, mode, operand, penalty);
+					case CPU::ins_ldx_im:
+					case CPU::ins_ldx_zp:
+					case CPU::ins_ldx_zpy:
+					case CPU::ins_ldx_abs:
+					case CPU::ins_ldx_absy:
+						return emitRead(e, mem, 0x8A, X, mode, operand, penalty);
+					case CPU::ins_ldy_im:
+					case CPU::ins_ldy_zp:
+					case CPU::ins_ldy_zpx:
+					case CPU::ins_ldy_abs:
+					case CPU::ins_ldy_absx:
+						return emitRead(e, mem, 0x8A, Y, mode, operand, penalty);
+					case CPU::ins_and_im:
+					case CPU::ins_and_zp:
+					case CPU::ins_and_zpx:
+					case CPU::ins_and_abs:
+					case CPU::ins_and_absx:
+					case CPU::ins_and_absy:
+						return emitRead(e, mem, 0x22, A, mode, operand, penalty);
+					case CPU::ins_ora_im:
+					case CPU::ins_ora_zp:
+					case CPU::ins_ora_zpx:
+					case CPU::ins_ora_abs:
+					case CPU::ins_ora_absx:
+					case CPU::ins_ora_absy:
+						return emitRead(e, mem, 0x0A, A, mode, operand, penalty);
+					case CPU::ins_eor_im:
+					case CPU::ins_eor_zp:
+					case CPU::ins_eor_zpx:
+					case CPU::ins_eor_abs:
+					case CPU::ins_eor_absx:
+					case CPU::ins_eor_absy:
+						return emitRead(e, mem, 0x32, A, mode, operand, penalty);
+					case CPU::ins_sta_zp:
+					case CPU::ins_sta_zpx:
+					case CPU::ins_sta_abs:
+					case CPU::ins_sta_absx:
+					case CPU::ins_sta_absy:
+						return emitStore(e, mem, block, A, mode, operand);
+					case CPU::ins_stx_zp:
+					case CPU::ins_stx_zpy:
+					case CPU::ins_stx_abs:
+						return emitStore(e, mem, block, X, mode, operand);
+					case CPU::ins_sty_zp:
+					case CPU::ins_sty_zpx:
+					case CPU::ins_sty_abs:
+						return emitStore(e, mem, block, Y, mode, operand);
+					case CPU::ins_tax:
+						return emitTransfer(e, X, A);
+					case CPU::ins_txa:
+						return emitTransfer(e, A, X);
+					case CPU::ins_tya:
+						return emitTransfer(e, A, Y);
+					case CPU::ins_tsx:
+						return emitTransfer(e, X, X64_EMITTER::R11);
+					case CPU::ins_inx:
+					case CPU::ins_dex:
+						e.incDec8(X, opcode == CPU::ins_dex);
+						emitLoadFlags(e, X);
+						return true;
+					case CPU::ins_iny:
+					case CPU::ins_dey:
+						e.incDec8(Y, opcode == CPU::ins_dey);
+						emitLoadFlags(e, Y);
+						return true;
+					case CPU::ins_clc:
+					case CPU::ins_sec:
+						e.storeStateImm8(offsetof(JIT_STATE, carry), opcode == CPU::ins_sec);
+						return true;
+					case CPU::ins_cli:
+					case CPU::ins_sei:
+						e.storeStateImm8(offsetof(JIT_STATE, interr), opcode == CPU::ins_sei);
+						return true;
+					case CPU::ins_cld:
+					case CPU::ins_sed:
+						e.storeStateImm8(offsetof(JIT_STATE, dec), opcode == CPU::ins_sed);
+						return true;
+					case CPU::ins_clv:
+						e.storeStateImm8(offsetof(JIT_STATE, oflow), 0);
+						return true;
+					case CPU::ins_nop:
+						return true;
+				}
+				return false;
+			}
+
+			// load (opcode 0x8A) or logic operation (0x0A ora, 0x22 and, 0x32 eor) of a memory or immediate operand into reg, then N and Z
+			bool emitRead(X64_EMITTER &e, MEMORY &mem, BYTE opcode, int reg, BYTE mode, WORD operand, bool &penalty) {
+				if (mode == CPU::am_imm) {
+					if (opcode == 0x8A) {
+						e.moveImm8(reg, operand);
+					} else {
+						// group 0x80 extensions of or, and and xor
+						e.aluImm8(opcode == 0x0A ? 1 : opcode == 0x22 ? 4 : 6, reg, operand);
+					}
+				} else {
+					bool indexed;
+					if (!emitAddress(e, mem, nullptr, mode, operand, indexed)) {
+						return false;
+					}
+					e.memory8(opcode, reg, indexed);
+					if (mode == CPU::am_absx || mode == CPU::am_absy) {
+						// eax holds the low byte of the base plus the index : bit 8 is the page cross
+						e.shiftRight32(X64_EMITTER::RAX, 8);
+						e.alu32(0x01, X64_EMITTER::RCX, X64_EMITTER::RAX);
+						penalty = true;
+					}
+				}
+				emitLoadFlags(e, reg);
+				return true;
+			}
+
+			bool emitStore(X64_EMITTER &e, MEMORY &mem, BLOCK &block, int reg, BYTE mode, WORD operand) {
+				bool indexed;
+				if (!emitAddress(e, mem, &block, mode, operand, indexed)) {
+					return false;
+				}
+				e.memory8(0x88, reg, indexed);
+				return true;
+			}
+
+			bool emitTransfer(X64_EMITTER &e, int dst, int src) {
+				e.move8(dst, src);
+				emitLoadFlags(e, dst);
+				return true;
+			}
+
+			// sets Z and N from reg8
+			void emitLoadFlags(X64_EMITTER &e, int reg) {
+				e.test8(reg);
+				e.setState(X64_EMITTER::CC_E, offsetof(JIT_STATE, zero));
+				e.setState(X64_EMITTER::CC_S, offsetof(JIT_STATE, neg));
+			}
+
+			// emits the host address of an operand in rdx (plus rax if indexed), reading through the page table as it is now
+			// store is the block for writes (the pages are added to its storePages), nullptr for reads
+			// returns false, having emitted nothing, for device pages, pages not contiguous in host memory, wrap-around at 0xFFFF, and stores to code pages
+			bool emitAddress(X64_EMITTER &e, MEMORY &mem, BLOCK *store, BYTE mode, WORD operand, bool &indexed) {
+				int index = (mode == CPU::am_zpx || mode == CPU::am_absx ? X64_EMITTER::R9 : X64_EMITTER::R10);
+				BYTE page = operand >> 8;
+				const BYTE *host = hostPage(mem, page, store != nullptr);
+				if (host == nullptr || (store != nullptr && !storable(*store, page))) {
+					return false;
+				}
+				switch (mode) {
+					case CPU::am_zp:
+					case CPU::am_abs:
+						e.moveImm64(X64_EMITTER::RDX, (uint64_t)(host + (operand & 0xFF)));
+						indexed = false;
+						break;
+					case CPU::am_zpx:
+					case CPU::am_zpy:
+						// the index wraps within the zero page
+						e.moveZeroExtend(X64_EMITTER::RAX, index);
+						e.aluImm32(0, X64_EMITTER::RAX, operand & 0xFF);
+						e.aluImm32(4, X64_EMITTER::RAX, 0xFF);
+						e.moveImm64(X64_EMITTER::RDX, (uint64_t)host);
+						indexed = true;
+						break;
+					case CPU::am_absx:
+					case CPU::am_absy:
+						// the index may run into the next page, which must follow in host memory
+						if (page == 0xFF || hostPage(mem, page + 1, store != nullptr) != host + MEMORY::PAGE_SIZE || (store != nullptr && !storable(*store, page + 1))) {
+							return false;
+						}
+						e.moveZeroExtend(X64_EMITTER::RAX, index);
+						e.aluImm32(0, X64_EMITTER::RAX, operand & 0xFF);
+						e.moveImm64(X64_EMITTER::RDX, (uint64_t)host);
+						indexed = true;
+						if (store != nullptr) {
+							store->storePages.push_back(page + 1);
+						}
+						break;
+					default:
+						return false;
+				}
+				if (store != nullptr) {
+					store->storePages.push_back(page);
+				}
+				return true;
+			}
+
+			// returns the host bytes of page for reads or writes, nullptr for device pages
+			static const BYTE *hostPage(MEMORY &mem, BYTE page, bool write) {
+				return (write ? mem.writePage(page) : mem.readPage(page));
+			}
+
+			// returns true if block may store into page natively (neither its own page nor a page with other compiled code)
+			bool storable(const BLOCK &block, BYTE page) const {
+				return page != block.page && blocksInPage[page] == 0;
+			}
+
+			// copies code into the executable buffer. Returns nullptr if the buffer cannot be mapped
+			ENTRY install(const std::vector<BYTE> &code) {
+#if M6502_JIT_NATIVE
+				if (buffer == nullptr) {
+					void *mapping = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+					if (mapping == MAP_FAILED) {
+						return nullptr;
+					}
+					buffer = (BYTE *)mapping;
+				}
+				if (used + code.size() > BUFFER_SIZE) {
+					flush();
+				}
+				// the buffer is never writable and executable at the same time
+				if (mprotect(buffer, BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0) {
+					return nullptr;
+				}
+				std::memcpy(buffer + used, code.data(), code.size());
+				mprotect(buffer, BUFFER_SIZE, PROT_READ | PROT_EXEC);
+				ENTRY entry = (ENTRY)(buffer + used);
+				used += (code.size() + 15) & ~(size_t)15;
+				return entry;
+#else
+				return nullptr;
+#endif
+			}
+
+			std::vector<BYTE> heat;				// visits of each address as a branch or jump target
+			std::vector<int32_t> blockAt;		// index in blocks of the block starting at each address, NO_BLOCK or UNCOMPILABLE
+			std::vector<BLOCK> blocks;			// every block compiled since the last flush (dropped ones included)
+			std::vector<WORD> uncompilable;		// addresses marked UNCOMPILABLE
+			uint32_t blocksInPage[MEMORY::PAGES] = {};	// live blocks of each page
+			BYTE pageDrops[MEMORY::PAGES] = {};			// times the blocks of each page were dropped for a write (up to MAX_PAGE_DROPS)
+			BYTE *buffer = nullptr;				// executable buffer (BUFFER_SIZE bytes)
+			size_t used = 0;					// bytes of buffer holding code
+			const MEMORY *memory = nullptr;		// memory the blocks were compiled for
+			const CPU_TYPE *owner = nullptr;	// cpu whose decodeCache reports writes to code pages
+			uint32_t generation = 0;			// MEMORY::generation the blocks were compiled for
+	}; // struct JIT_T
+
+	typedef JIT_T<CPU> JIT;				// compiler for cycle-exact CPUs
+	typedef JIT_T<FAST_CPU> FAST_JIT;	// compiler for per-instruction timing CPUs
+} // namespace m6502
+
+#endif // ifndef _JIT_H
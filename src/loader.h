@@ -0,0 +1,271 @@
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "6502.h"
+
+namespace m6502 {
+
+	// read-only view of bytes owned elsewhere (what std::span<const BYTE> is in C++20)
+	struct BYTE_SPAN {
+		public:
+			BYTE_SPAN() {}
+
+			BYTE_SPAN(const BYTE *nData, size_t nSize) : data(nData), size(nSize) {}
+
+			BYTE_SPAN(const std::vector<BYTE> &bytes) : data(bytes.data()), size(bytes.size()) {}
+
+			template <size_t N>
+			BYTE_SPAN(const std::array<BYTE, N> &bytes) : data(bytes.data()), size(N) {}
+
+			const BYTE *data = nullptr;
+			size_t size = 0;
+	}; // struct BYTE_SPAN
+
+	// bytes to place at origin
+	struct SEGMENT {
+		WORD origin;
+		BYTE_SPAN bytes;
+	}; // struct SEGMENT
+
+	// read-only memory mapping of a whole file, unmapped on close or destruction
+	struct MAPPED_FILE {
+		public:
+			MAPPED_FILE() {}
+
+			MAPPED_FILE(const MAPPED_FILE &) = delete;
+			MAPPED_FILE &operator=(const MAPPED_FILE &) = delete;
+
+			~MAPPED_FILE() {
+				close();
+			}
+
+			// maps the file at path. Returns false if it cannot be read
+			bool open(const char *path) {
+				close();
+				int fd = ::open(path, O_RDONLY);
+				if (fd < 0) {
+					return false;
+				}
+				struct stat info;
+				bool opened = (fstat(fd, &info) == 0);
+				if (opened && info.st_size > 0) {
+					void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					opened = (mapping != MAP_FAILED);
+					if (opened) {
+						data = (const BYTE *)mapping;
+						size = info.st_size;
+					}
+				}
+				::close(fd);
+				return opened;
+			}
+
+			void close() {
+				if (data != nullptr) {
+					munmap((void *)data, size);
+				}
+				data = nullptr;
+				size = 0;
+			}
+
+			// returns the content of the file (empty if none is open)
+			BYTE_SPAN bytes() const {
+				return BYTE_SPAN(data, size);
+			}
+		private:
+			const BYTE *data = nullptr;
+			size_t size = 0;
+	}; // struct MAPPED_FILE
+
+	// loaders placing program images into MEMORY without going through a 64 KiB vector : only the bytes present in the image are written
+	// (straight from the span or the mapped file, like MEMORY::fill, so ROM pages are loaded too). Nothing is written from an image that does not parse
+	namespace loader {
+		// returns the value of a hexadecimal digit, -1 for any other character
+		inline int hexDigit(BYTE character) {
+			if (character >= '0' && character <= '9') {
+				return character - '0';
+			}
+			if (character >= 'A' && character <= 'F') {
+				return character - 'A' + 10;
+			}
+			if (character >= 'a' && character <= 'f') {
+				return character - 'a' + 10;
+			}
+			return -1;
+		}
+
+		// decodes the Intel HEX records of text, calling write(address, bytes, count) for each data record
+		// sets entry (if not nullptr) from a start address record. Returns false on a malformed record, a bad checksum or data past 0xFFFF
+		template <class WRITE>
+		bool parseHex(BYTE_SPAN text, WRITE write, WORD *entry) {
+			uint32_t base = 0;		// from extended segment or linear address records
+			size_t position = 0;
+			while (position < text.size) {
+				BYTE character = text.data[position];
+				if (character == '\r' || character == '\n' || character == ' ' || character == '\t') {
+					position++;
+					continue;
+				}
+				if (character != ':') {
+					return false;
+				}
+				position++;
+				// record : byte count, address (2 bytes), type, data, checksum
+				std::array<BYTE, 5 + 255> record;
+				size_t length = 0;
+				size_t expected = 5;
+				while (length < expected) {
+					if (position + 1 >= text.size) {
+						return false;
+					}
+					int high = hexDigit(text.data[position]);
+					int low = hexDigit(text.data[position + 1]);
+					if (high < 0 || low < 0) {
+						return false;
+					}
+					record[length++] = (BYTE)(high << 4 | low);
+					position += 2;
+					if (length == 1) {
+						expected = 5 + record[0];
+					}
+				}
+				BYTE sum = 0;
+				for (size_t i = 0; i < length; i++) {
+					sum += record[i];
+				}
+				if (sum != 0) {
+					return false;
+				}
+				BYTE count = record[0];
+				uint32_t address = record[1] << 8 | record[2];
+				const BYTE *bytes = record.data() + 4;
+				switch (record[3]) {
+					case 0x00:
+						if (base + address + count > MEMORY::MEM_SIZE) {
+							return false;
+						}
+						write((WORD)(base + address), bytes, count);
+						break;
+					case 0x01:
+						return true;
+					case 0x02:
+						if (count != 2) {
+							return false;
+						}
+						base = (bytes[0] << 8 | bytes[1]) << 4;
+						break;
+					case 0x04:
+						if (count != 2) {
+							return false;
+						}
+						base = (bytes[0] << 8 | bytes[1]) << 16;
+						break;
+					case 0x03:
+					case 0x05:
+						// CS:IP or a 32 bit address : only the low 16 bits address the 6502
+						if (entry != nullptr && count == 4) {
+							*entry = bytes[2] << 8 | bytes[3];
+						}
+						break;
+					default:
+						return false;
+				}
+			}
+			return true;
+		}
+
+		// decodes a segmented binary : blocks of (first address, last address, bytes from first to last), little-endian,
+		// each optionally preceded by an 0xFFFF marker (the Atari DOS binary load layout). Calls write(address, bytes, count) for each block
+		// returns false if a block is cut short or ends before it starts
+		template <class WRITE>
+		bool parseSegments(BYTE_SPAN image, WRITE write) {
+			size_t position = 0;
+			while (position < image.size) {
+				if (position + 1 < image.size && image.data[position] == 0xFF && image.data[position + 1] == 0xFF) {
+					position += 2;
+					continue;
+				}
+				if (position + 4 > image.size) {
+					return false;
+				}
+				WORD first = image.data[position] | image.data[position + 1] << 8;
+				WORD last = image.data[position + 2] | image.data[position + 3] << 8;
+				size_t count = (size_t)last - first + 1;
+				position += 4;
+				if (last < first || position + count > image.size) {
+					return false;
+				}
+				write(first, image.data + position, count);
+				position += count;
+			}
+			return true;
+		}
+	} // namespace loader
+
+	// writes bytes at origin (the bytes past 0xFFFF are dropped)
+	inline void loadRaw(MEMORY &mem, WORD origin, BYTE_SPAN bytes) {
+		mem.load(origin, bytes.data, bytes.size);
+	}
+
+	// writes each segment at its origin, in order
+	inline void loadSegments(MEMORY &mem, const std::vector<SEGMENT> &segments) {
+		for (const SEGMENT &segment : segments) {
+			mem.load(segment.origin, segment.bytes.data, segment.bytes.size);
+		}
+	}
+
+	// writes the data records of the Intel HEX text. Sets entry (if not nullptr) from a start address record
+	// returns false, without writing anything, if the text does not parse
+	inline bool loadHex(MEMORY &mem, BYTE_SPAN text, WORD *entry = nullptr) {
+		// a first pass checks the whole text, so a bad record cannot leave the memory half loaded
+		auto ignore = [](WORD, const BYTE *, size_t) {};
+		if (!loader::parseHex(text, ignore, nullptr)) {
+			return false;
+		}
+		return loader::parseHex(text, [&mem](WORD address, const BYTE *bytes, size_t count) {
+			mem.load(address, bytes, count);
+		}, entry);
+	}
+
+	// writes the blocks of a segmented binary (see loader::parseSegments). Returns false, without writing anything, if it does not parse
+	inline bool loadSegmented(MEMORY &mem, BYTE_SPAN image) {
+		auto ignore = [](WORD, const BYTE *, size_t) {};
+		if (!loader::parseSegments(image, ignore)) {
+			return false;
+		}
+		return loader::parseSegments(image, [&mem](WORD address, const BYTE *bytes, size_t count) {
+			mem.load(address, bytes, count);
+		});
+	}
+
+	// same as loadRaw, loadHex and loadSegmented, from a file mapped for the duration of the load. Return false if the file cannot be read
+	inline bool loadRawFile(MEMORY &mem, const char *path, WORD origin) {
+		MAPPED_FILE file;
+		if (!file.open(path)) {
+			return false;
+		}
+		loadRaw(mem, origin, file.bytes());
+		return true;
+	}
+
+	inline bool loadHexFile(MEMORY &mem, const char *path, WORD *entry = nullptr) {
+		MAPPED_FILE file;
+		return file.open(path) && loadHex(mem, file.bytes(), entry);
+	}
+
+	inline bool loadSegmentedFile(MEMORY &mem, const char *path) {
+		MAPPED_FILE file;
+		return file.open(path) && loadSegmented(mem, file.bytes());
+	}
+} // namespace m6502
+
+#endif // ifndef _LOADER_H
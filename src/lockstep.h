@@ -0,0 +1,693 @@
+#ifndef _LOCKSTEP_H
+#define _LOCKSTEP_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <memory>
+
+#include "6502.h"
+
+namespace m6502 {
+
+	// one byte per lane, as a GCC vector extension. Compiles to AVX2 with -mavx2, to SSE2 otherwise
+	template <int LANES>
+	struct LANE_VECTOR;
+
+	template <>
+	struct LANE_VECTOR<16> {
+		typedef BYTE TYPE __attribute__((vector_size(16)));
+	}; // struct LANE_VECTOR<16>
+
+	template <>
+	struct LANE_VECTOR<32> {
+		typedef BYTE TYPE __attribute__((vector_size(32)));
+	}; // struct LANE_VECTOR<32>
+
+	// runs LANES machines with the same program in lockstep, for sweeps over a few inputs
+	// registers and flags are stored as struct-of-arrays, one vector per register holding it for every lane (reg_acc[lane] is the accumulator of a lane),
+	// and memory as one vector per address (memory[address][lane]), so an access to the same address in every lane is one vector load or store
+	// while every lane is at the same programCounter, one step decodes the instruction once and executes it for all lanes with vector operations
+	// a lane leaving the common path (other branch outcome, return address, jump target or code bytes, decimal arithmetic, BRK, RTI) is taken out of the
+	// vector and finished on its own by a FAST_CPU. Memory is plain RAM in every lane (no page table, ROM or devices)
+	template <int LANES>
+	struct LOCKSTEP_T {
+		public:
+			typedef typename LANE_VECTOR<LANES>::TYPE VECTOR;
+
+			static constexpr int LANE_COUNT = LANES;
+
+			LOCKSTEP_T() : memory(MEMORY::MEM_SIZE) {}
+
+			// copies image (up to 64 KiB) into the memory of every lane
+			void load(const std::vector<BYTE> &image) {
+				for (uint32_t address = 0; address < image.size() && address < MEMORY::MEM_SIZE; address++) {
+					memory[address] = broadcast(image[address]);
+				}
+			}
+
+			// returns a byte of the memory of one lane
+			BYTE read(int lane, WORD address) const {
+				return memory[address][lane];
+			}
+
+			// writes a byte to the memory of one lane (to set the inputs of each lane)
+			void write(int lane, WORD address, BYTE value) {
+				memory[address][lane] = value;
+			}
+
+			// resets every lane like CPU::reset. The reset vector is taken from lane 0
+			void reset() {
+				reg_acc = reg_x = reg_y = broadcast(0);
+				reg_stackPointer = broadcast(0xFD);
+				fl_carry = fl_zero = fl_interr = fl_dec = fl_oflow = fl_neg = broadcast(0);
+				WORD start = memory[0xFFFC][0] | memory[0xFFFD][0] << 8;
+				for (int lane = 0; lane < LANES; lane++) {
+					reg_programCounter[lane] = start;
+				}
+			}
+
+			// runs every lane for a budget of cycles, like CPU::execute on LANES separate machines
+			// lanes must all be at the same programCounter (true after reset and after a run that no lane left)
+			void execute(uint32_t cycles) {
+				budget = cycles;
+				elapsed = 0;
+				maxLag = 0;
+				pc = reg_programCounter[0];
+				for (int lane = 0; lane < LANES; lane++) {
+					lag[lane] = 0;
+					laneCycles[lane] = 0;
+					ejected[lane] = false;
+				}
+				active = broadcast(0xFF);
+				activeLanes = LANES;
+				first = 0;
+				while (activeLanes > 0) {
+					steps++;
+					instructions += activeLanes;
+					step();
+					if (elapsed + maxLag >= budget) {
+						retireFinished();
+					}
+				}
+				finishEjected();
+			}
+
+			VECTOR reg_acc;						// accumulator of every lane
+			VECTOR reg_x;						// x register of every lane
+			VECTOR reg_y;						// y register of every lane
+			VECTOR reg_stackPointer;			// stack pointer of every lane
+			WORD reg_programCounter[LANES];		// program counter of every lane (after execute)
+
+			VECTOR fl_carry;					// flags of every lane (0 or 1)
+			VECTOR fl_zero;
+			VECTOR fl_interr;
+			VECTOR fl_dec;
+			VECTOR fl_oflow;
+			VECTOR fl_neg;
+
+			uint32_t laneCycles[LANES];			// cycles run by each lane in the last execute
+			uint64_t steps = 0;					// vector steps (one instruction for every active lane)
+			uint64_t instructions = 0;			// instructions of all lanes, vector and scalar
+			uint64_t ejections = 0;				// lanes finished by a scalar CPU
+		private:
+			// decoded opcode : operation, addressing mode (CPU::am_*) and base cycles, from the CPU descriptor table
+			typedef CPU::DESCRIPTOR DECODED;
+
+			// executes the instruction at pc for every active lane
+			void step() {
+				static constexpr std::array<DECODED, 256> table = CPU::descriptorTable();
+				WORD start = pc;
+				VECTOR opcodes = memory[pc];
+				if (!uniform(opcodes)) {
+					// self-modified or patched code : lanes running other code leave before executing it
+					ejectBefore(differs(opcodes), start);
+					return;
+				}
+				const DECODED &decoded = table[opcodes[first]];
+				BYTE length = CPU::operandLength(decoded.mode);
+				VECTOR operandLow = memory[(WORD)(pc + 1)];
+				VECTOR operandHigh = (length == 2 ? memory[(WORD)(pc + 2)] : broadcast(0));
+				bool control = (decoded.operation == JMP && decoded.mode == CPU::am_abs) || decoded.operation == JSR || (decoded.operation >= BCC && decoded.operation <= BVS);
+				if (control && !(uniform(operandLow) && uniform(operandHigh))) {
+					ejectBefore(differs(operandLow) | differs(operandHigh), start);
+					return;
+				}
+				if (decoded.operation == BRK || decoded.operation == RTI) {
+					ejectBefore(active, start);
+					return;
+				}
+				if ((decoded.operation == ADC || decoded.operation == SBC) && !none(fl_dec & active)) {
+					// decimal arithmetic is left to the scalar CPU
+					ejectBefore((VECTOR)(fl_dec != 0), start);
+					return;
+				}
+				pc += 1 + length;
+
+				// effective address (low and high byte per lane) and page-cross penalty of indexed reads
+				VECTOR low = operandLow;
+				VECTOR high = operandHigh;
+				VECTOR extra = broadcast(0);
+				switch (decoded.mode) {
+					case CPU::am_zpx:
+						low = operandLow + reg_x;
+						break;
+					case CPU::am_zpy:
+						low = operandLow + reg_y;
+						break;
+					case CPU::am_absx:
+						low = operandLow + reg_x;
+						extra = (VECTOR)(low < reg_x);
+						high = operandHigh - extra;
+						extra &= 1;
+						break;
+					case CPU::am_absy:
+						low = operandLow + reg_y;
+						extra = (VECTOR)(low < reg_y);
+						high = operandHigh - extra;
+						extra &= 1;
+						break;
+					case CPU::am_indx:
+						low = loadAt(operandLow + reg_x, broadcast(0));
+						high = loadAt(operandLow + reg_x + 1, broadcast(0));
+						break;
+					case CPU::am_indy:
+						low = loadAt(operandLow, broadcast(0)) + reg_y;
+						extra = (VECTOR)(low < reg_y);
+						high = loadAt(operandLow + 1, broadcast(0)) - extra;
+						extra &= 1;
+						break;
+					case CPU::am_ind:
+						// the pointer does not carry into the next page, like on an original 6502
+						low = loadAt(operandLow, operandHigh);
+						high = loadAt(operandLow + 1, operandHigh);
+						break;
+				}
+
+				VECTOR value;
+				VECTOR taken;
+				VECTOR leaving = broadcast(0);
+				WORD targets[LANES];
+				switch (decoded.operation) {
+					case LDA:
+						assign(reg_acc, operand(decoded, low, high));
+						setLoadFlags(reg_acc);
+						break;
+					case LDX:
+						assign(reg_x, operand(decoded, low, high));
+						setLoadFlags(reg_x);
+						break;
+					case LDY:
+						assign(reg_y, operand(decoded, low, high));
+						setLoadFlags(reg_y);
+						break;
+					case STA:
+						storeAt(low, high, reg_acc);
+						break;
+					case STX:
+						storeAt(low, high, reg_x);
+						break;
+					case STY:
+						storeAt(low, high, reg_y);
+						break;
+					case TAX:
+						assign(reg_x, reg_acc);
+						setLoadFlags(reg_x);
+						break;
+					case TAY:
+						assign(reg_y, reg_acc);
+						setLoadFlags(reg_y);
+						break;
+					case TXA:
+						assign(reg_acc, reg_x);
+						setLoadFlags(reg_acc);
+						break;
+					case TYA:
+						assign(reg_acc, reg_y);
+						setLoadFlags(reg_acc);
+						break;
+					case TSX:
+						assign(reg_x, reg_stackPointer);
+						setLoadFlags(reg_x);
+						break;
+					case TXS:
+						assign(reg_stackPointer, reg_x);
+						break;
+					case PHA:
+						push(reg_acc);
+						break;
+					case PHP:
+						push(fl_carry | fl_zero << 1 | fl_interr << 2 | fl_dec << 3 | 0b00110000 | fl_oflow << 6 | fl_neg << 7);
+						break;
+					case PLA:
+						assign(reg_acc, pull());
+						setLoadFlags(reg_acc);
+						break;
+					case PLP:
+						value = pull();
+						assign(fl_carry, value & 1);
+						assign(fl_zero, (value >> 1) & 1);
+						assign(fl_interr, (value >> 2) & 1);
+						assign(fl_dec, (value >> 3) & 1);
+						assign(fl_oflow, (value >> 6) & 1);
+						assign(fl_neg, value >> 7);
+						break;
+					case AND:
+						assign(reg_acc, reg_acc & operand(decoded, low, high));
+						setLoadFlags(reg_acc);
+						break;
+					case EOR:
+						assign(reg_acc, reg_acc ^ operand(decoded, low, high));
+						setLoadFlags(reg_acc);
+						break;
+					case ORA:
+						assign(reg_acc, reg_acc | operand(decoded, low, high));
+						setLoadFlags(reg_acc);
+						break;
+					case BIT:
+						value = loadAt(low, high);
+						assign(fl_zero, (VECTOR)((reg_acc & value) == 0) & 1);
+						assign(fl_oflow, (value >> 6) & 1);
+						assign(fl_neg, value >> 7);
+						break;
+					case ADC:
+						add(operand(decoded, low, high));
+						break;
+					case SBC:
+						add(~operand(decoded, low, high));
+						break;
+					case CMP:
+						compare(reg_acc, operand(decoded, low, high));
+						break;
+					case CPX:
+						compare(reg_x, operand(decoded, low, high));
+						break;
+					case CPY:
+						compare(reg_y, operand(decoded, low, high));
+						break;
+					case INC:
+						value = loadAt(low, high) + 1;
+						storeAt(low, high, value);
+						setLoadFlags(value);
+						break;
+					case DEC:
+						value = loadAt(low, high) - 1;
+						storeAt(low, high, value);
+						setLoadFlags(value);
+						break;
+					case INX:
+						assign(reg_x, reg_x + 1);
+						setLoadFlags(reg_x);
+						break;
+					case INY:
+						assign(reg_y, reg_y + 1);
+						setLoadFlags(reg_y);
+						break;
+					case DEX:
+						assign(reg_x, reg_x - 1);
+						setLoadFlags(reg_x);
+						break;
+					case DEY:
+						assign(reg_y, reg_y - 1);
+						setLoadFlags(reg_y);
+						break;
+					case ASL:
+					case LSR:
+					case ROL:
+					case ROR:
+						value = (decoded.mode == CPU::am_imp ? reg_acc : loadAt(low, high));
+						value = shift(decoded.operation, value);
+						if (decoded.mode == CPU::am_imp) {
+							assign(reg_acc, value);
+						} else {
+							storeAt(low, high, value);
+						}
+						setLoadFlags(value);
+						break;
+					case JMP:
+						jump(low, high, leaving, targets);
+						break;
+					case JSR:
+						// pushes the address of the next instruction, like CPU::op<JSR, am_abs>
+						push(broadcast(pc >> 8));
+						push(broadcast(pc & 0xFF));
+						pc = low[first] | high[first] << 8;
+						break;
+					case RTS:
+						value = pull();
+						jump(value, pull(), leaving, targets);
+						break;
+					case BCC:
+					case BCS:
+					case BEQ:
+					case BMI:
+					case BNE:
+					case BPL:
+					case BVC:
+					case BVS:
+						taken = branchTaken(decoded.operation);
+						branch(operandLow[first], taken, extra, leaving, targets);
+						break;
+					case CLC:
+						assign(fl_carry, broadcast(0));
+						break;
+					case CLD:
+						assign(fl_dec, broadcast(0));
+						break;
+					case CLI:
+						assign(fl_interr, broadcast(0));
+						break;
+					case CLV:
+						assign(fl_oflow, broadcast(0));
+						break;
+					case SEC:
+						assign(fl_carry, broadcast(1));
+						break;
+					case SED:
+						assign(fl_dec, broadcast(1));
+						break;
+					case SEI:
+						assign(fl_interr, broadcast(1));
+						break;
+				}
+				// only indexed reads pay for a page cross (stores and read-modify-writes include it in their base cost). Branches set their own penalties
+				bool reads = (decoded.operation <= LDY || (decoded.operation >= AND && decoded.operation <= CPY));
+				bool branches = (decoded.operation >= BCC && decoded.operation <= BVS);
+				charge(decoded.cycles, (reads || branches ? extra : broadcast(0)));
+				if (!none(leaving)) {
+					ejectAfter(leaving, targets);
+				}
+			}
+
+			// returns the value read by an instruction : the operand itself in immediate mode, memory otherwise
+			VECTOR operand(const DECODED &decoded, const VECTOR &low, const VECTOR &high) {
+				return (decoded.mode == CPU::am_imm ? low : loadAt(low, high));
+			}
+
+			// reads the byte at (high << 8 | low) of every lane : one vector load if all active lanes use the same address, a gather otherwise
+			VECTOR loadAt(const VECTOR &low, const VECTOR &high) {
+				if (uniform(low) && uniform(high)) {
+					return memory[low[first] | high[first] << 8];
+				}
+				VECTOR value;
+				for (int lane = 0; lane < LANES; lane++) {
+					value[lane] = memory[low[lane] | high[lane] << 8][lane];
+				}
+				return value;
+			}
+
+			// writes value at (high << 8 | low) for every active lane
+			void storeAt(const VECTOR &low, const VECTOR &high, const VECTOR &value) {
+				if (uniform(low) && uniform(high)) {
+					VECTOR &cell = memory[low[first] | high[first] << 8];
+					cell = (value & active) | (cell & ~active);
+					return;
+				}
+				for (int lane = 0; lane < LANES; lane++) {
+					if (active[lane]) {
+						memory[low[lane] | high[lane] << 8][lane] = value[lane];
+					}
+				}
+			}
+
+			void push(const VECTOR &value) {
+				storeAt(reg_stackPointer, broadcast(0x01), value);
+				assign(reg_stackPointer, reg_stackPointer - 1);
+			}
+
+			VECTOR pull() {
+				assign(reg_stackPointer, reg_stackPointer + 1);
+				return loadAt(reg_stackPointer, broadcast(0x01));
+			}
+
+			// sets target to value in active lanes only
+			void assign(VECTOR &target, const VECTOR &value) {
+				target = (value & active) | (target & ~active);
+			}
+
+			void setLoadFlags(const VECTOR &value) {
+				assign(fl_zero, (VECTOR)(value == 0) & 1);
+				assign(fl_neg, value >> 7);
+			}
+
+			// binary add with carry (SBC adds the complement)
+			void add(const VECTOR &input) {
+				VECTOR sum = reg_acc + input;
+				VECTOR carry = (VECTOR)(sum < reg_acc);
+				VECTOR result = sum + fl_carry;
+				carry |= (VECTOR)(result < sum);
+				assign(fl_oflow, ((reg_acc ^ result) & (input ^ result)) >> 7);
+				assign(fl_carry, carry & 1);
+				assign(reg_acc, result);
+				setLoadFlags(reg_acc);
+			}
+
+			void compare(const VECTOR &reg, const VECTOR &input) {
+				assign(fl_carry, (VECTOR)(reg >= input) & 1);
+				setLoadFlags(reg - input);
+			}
+
+			VECTOR shift(BYTE operation, const VECTOR &value) {
+				VECTOR carry = fl_carry;
+				switch (operation) {
+					case ASL:
+						assign(fl_carry, value >> 7);
+						return value << 1;
+					case LSR:
+						assign(fl_carry, value & 1);
+						return value >> 1;
+					case ROL:
+						assign(fl_carry, value >> 7);
+						return value << 1 | carry;
+					default:
+						assign(fl_carry, value & 1);
+						return value >> 1 | carry << 7;
+				}
+			}
+
+			// returns 0xFF in the lanes where a branch is taken
+			VECTOR branchTaken(BYTE operation) {
+				static constexpr BYTE flagSet[] = {0, 1, 1, 1, 0, 0, 0, 1};	// BCC BCS BEQ BMI BNE BPL BVC BVS
+				VECTOR flag;
+				switch (operation) {
+					case BCC:
+					case BCS:
+						flag = fl_carry;
+						break;
+					case BEQ:
+					case BNE:
+						flag = fl_zero;
+						break;
+					case BMI:
+					case BPL:
+						flag = fl_neg;
+						break;
+					default:
+						flag = fl_oflow;
+				}
+				return (VECTOR)(flag == flagSet[operation - BCC]);
+			}
+
+			// follows the path of the majority of the active lanes. The others leave at their own target after the instruction
+			void branch(BYTE offset, const VECTOR &taken, VECTOR &extra, VECTOR &leaving, WORD *targets) {
+				WORD target = pc + (int8_t)offset;
+				BYTE penalty = 1 + ((target >> 8) != (pc >> 8));
+				extra = taken & penalty;
+				int takenLanes = count(taken & active);
+				if (takenLanes == 0) {
+					return;
+				}
+				if (takenLanes < activeLanes) {
+					bool follow = (2 * takenLanes >= activeLanes);
+					leaving = (follow ? ~taken : taken) & active;
+					for (int lane = 0; lane < LANES; lane++) {
+						targets[lane] = (follow ? pc : target);
+					}
+					if (!follow) {
+						return;
+					}
+				}
+				pc = target;
+			}
+
+			// jumps to (high << 8 | low). Lanes with another target than the first active lane leave there after the instruction
+			void jump(const VECTOR &low, const VECTOR &high, VECTOR &leaving, WORD *targets) {
+				if (!(uniform(low) && uniform(high))) {
+					leaving = differs(low) | differs(high);
+					for (int lane = 0; lane < LANES; lane++) {
+						targets[lane] = low[lane] | high[lane] << 8;
+					}
+				}
+				pc = low[first] | high[first] << 8;
+			}
+
+			// charges every active lane base cycles plus its own penalty
+			void charge(BYTE cycles, const VECTOR &extra) {
+				elapsed += cycles;
+				VECTOR penalty = extra & active;
+				if (none(penalty)) {
+					return;
+				}
+				if (uniform(penalty)) {
+					elapsed += penalty[first];
+					return;
+				}
+				for (int lane = 0; lane < LANES; lane++) {
+					lag[lane] += penalty[lane];
+					maxLag = (lag[lane] > maxLag ? lag[lane] : maxLag);
+				}
+			}
+
+			// stops the active lanes whose budget is spent
+			void retireFinished() {
+				for (int lane = 0; lane < LANES; lane++) {
+					if (active[lane] && elapsed + lag[lane] >= budget) {
+						reg_programCounter[lane] = pc;
+						deactivate(lane);
+					}
+				}
+			}
+
+			// takes lanes out of the vector before the instruction at start, which the scalar CPU runs instead
+			void ejectBefore(const VECTOR &lanes, WORD start) {
+				for (int lane = 0; lane < LANES; lane++) {
+					if (active[lane] && lanes[lane]) {
+						reg_programCounter[lane] = start;
+						ejected[lane] = true;
+						deactivate(lane);
+					}
+				}
+			}
+
+			// takes lanes out of the vector after the current instruction, each continuing at its own target
+			void ejectAfter(const VECTOR &lanes, const WORD *targets) {
+				for (int lane = 0; lane < LANES; lane++) {
+					if (active[lane] && lanes[lane]) {
+						reg_programCounter[lane] = targets[lane];
+						ejected[lane] = true;
+						deactivate(lane);
+					}
+				}
+			}
+
+			void deactivate(int lane) {
+				laneCycles[lane] = elapsed + lag[lane];
+				active[lane] = 0;
+				activeLanes--;
+				while (first < LANES - 1 && !active[first]) {
+					first++;
+				}
+			}
+
+			// finishes every ejected lane with a scalar CPU on a copy of its memory, then copies the machine back into its lane
+			void finishEjected() {
+				std::unique_ptr<MEMORY> mem;
+				uint32_t cycles;
+				for (int lane = 0; lane < LANES; lane++) {
+					if (!ejected[lane]) {
+						continue;
+					}
+					ejections++;
+					if (!mem) {
+						mem = std::make_unique<MEMORY>();
+					}
+					mem->init(&cycles);
+					for (uint32_t address = 0; address < MEMORY::MEM_SIZE; address++) {
+						mem->at(address) = memory[address][lane];
+					}
+					FAST_CPU cpu;
+					cpu.throttle.mode = THROTTLE::UNTHROTTLED;
+					cpu.reg_programCounter = reg_programCounter[lane];
+					cpu.reg_stackPointer = reg_stackPointer[lane];
+					cpu.reg_acc = reg_acc[lane];
+					cpu.reg_x = reg_x[lane];
+					cpu.reg_y = reg_y[lane];
+					cpu.fl_carry = fl_carry[lane];
+					cpu.fl_zero = fl_zero[lane];
+					cpu.fl_interr = fl_interr[lane];
+					cpu.fl_dec = fl_dec[lane];
+					cpu.fl_oflow = fl_oflow[lane];
+					cpu.fl_neg = fl_neg[lane];
+					if (laneCycles[lane] < budget) {
+						cycles = budget - laneCycles[lane];
+						cpu.execute(cycles, *mem);
+						laneCycles[lane] += cpu.stats.cycles;
+						instructions += cpu.stats.instructions;
+					}
+					reg_programCounter[lane] = cpu.reg_programCounter;
+					reg_stackPointer[lane] = cpu.reg_stackPointer;
+					reg_acc[lane] = cpu.reg_acc;
+					reg_x[lane] = cpu.reg_x;
+					reg_y[lane] = cpu.reg_y;
+					fl_carry[lane] = cpu.fl_carry;
+					fl_zero[lane] = cpu.fl_zero;
+					fl_interr[lane] = cpu.fl_interr;
+					fl_dec[lane] = cpu.fl_dec;
+					fl_oflow[lane] = cpu.fl_oflow;
+					fl_neg[lane] = cpu.fl_neg;
+					for (uint32_t address = 0; address < MEMORY::MEM_SIZE; address++) {
+						memory[address][lane] = mem->at(address);
+					}
+				}
+			}
+
+			static VECTOR broadcast(BYTE value) {
+				VECTOR vector = {};
+				return vector + value;
+			}
+
+			// returns true if every lane of vector is 0
+			static bool none(const VECTOR &vector) {
+				uint64_t words[LANES / 8];
+				std::memcpy(words, &vector, LANES);
+				uint64_t any = 0;
+				for (int i = 0; i < LANES / 8; i++) {
+					any |= words[i];
+				}
+				return any == 0;
+			}
+
+			// returns the number of lanes set in a 0x00 / 0xFF mask
+			static int count(const VECTOR &mask) {
+				uint64_t words[LANES / 8];
+				std::memcpy(words, &mask, LANES);
+				int lanes = 0;
+				for (int i = 0; i < LANES / 8; i++) {
+					lanes += __builtin_popcountll(words[i]) / 8;
+				}
+				return lanes;
+			}
+
+			// returns 0xFF in the active lanes where vector differs from the first active lane
+			VECTOR differs(const VECTOR &vector) {
+				return (VECTOR)(vector != broadcast(vector[first])) & active;
+			}
+
+			// returns true if vector holds the same value in every active lane
+			bool uniform(const VECTOR &vector) {
+				return none((vector ^ broadcast(vector[first])) & active);
+			}
+
+			std::vector<VECTOR> memory;		// memory[address][lane]
+			WORD pc;						// program counter shared by the active lanes
+			VECTOR active;					// 0xFF for lanes still running in the vector
+			int activeLanes;
+			int first;						// first active lane (whose values stand for all lanes on the common path)
+			uint32_t budget;
+			uint32_t elapsed;				// cycles run by the active lanes, except their own penalties
+			uint32_t lag[LANES];			// penalty cycles of each lane on top of elapsed
+			uint32_t maxLag;
+			bool ejected[LANES];			// lanes left to the scalar CPU
+	}; // struct LOCKSTEP_T
+
+	// one vector register per register of the 6502 : 32 lanes with AVX2 (-mavx2), 16 lanes with SSE2
+	// (wider vectors than the target supports are passed and returned in memory, an ABI the compiler warns about)
+#ifdef __AVX2__
+	typedef LOCKSTEP_T<32> LOCKSTEP;
+#else
+	typedef LOCKSTEP_T<16> LOCKSTEP;
+#endif
+} // namespace m6502
+
+#endif // ifndef _LOCKSTEP_H
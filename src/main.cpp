@@ -1,97 +1,165 @@
+#define M6502_TRACE
+#define M6502_PROFILE
+#define M6502_HISTOGRAM
 #include "6502.h"
+#include "tracefile.h"
+#include "loader.h"
+#include "disasm.h"
 #include <fstream>
 #include <vector>
 #include <iostream>
+#include <cstring>
+#include <memory>
+#include <cstdlib>
 
-/*
-constexpr char *instructions[0xFF] = {
-	"brk", "ora indx", "0x02", "0x03", "0x04", "ora zp", "asl zp", "0x07", "php", "ora im", "asl acc", "0x0B", "0x0C", "ora abs", "asl abs", "0x0F"
-	"bpl", "ora indy", "0x12", "0x13", "0x14", "ora zpx", "asl zpx", "0x17", "clc", "ora absy", "0x1A", "0x1B", "0x1C", "ora absx", "asl absx", "0x1F",
-	"jsr abs", "and indx", "0x22", "0x23", "bit zp", "and zp", "rol zp", "0x27", "plp", "and im", "rol acc", "0x2B", "bit abs", "and abs", "rol abs", "0x2F",
-	"bmi rel", "and indy", "0x32", "0x33", "0x34", "and zpgx", "rol zpx", "0x37", "sec", "and absy", "0x3A", "0x3B", "0x3C", "and absx", "rol abs", "0x3F",
-	"rti", "eor indx", "0x42", "0x43", "0x44", "eor zp", "lsr zp", "0x47", "pha", "eor im", "lsr acc", "0x4B", "jmp abs", "eor abs", "lsr abs", "0x4F",
-	"bvc", "eor indy", "0x52", "0x53", "0x54", "eor zpx", "lsr zpx", "0x57", "cli", "eor absx", "0x5A", "0x5B", "0x5C", "eor absx", "lsr absx",
-	"rts", "adc indx", "0x62", "0x63", "0x64", "adc zp", "ror zp", "0x67", "pla", "adc im", "ror acc", "0x6B", "jmp ind", "adc abs", "ror abs", "0x6F",
-	"bvs", "adc indy", "0x72", "0x73", "0x74", "adc zpx", "ror zpx", "0x77", "sei", "adc absy", "0x7A", "0x7B", "0x7C", "adc absx", "ror absx",
-	"0x80", "sta indx", "0x82", "0x83", "sty zp", "sta zp", "stx zp", "0x87", "dey", "0x89", "txa", "0x8B", "sty abs", "sta abs", "stx abs", "0x8F",
-	"bcc", "sta indy", "0x92", "0x93", "sty zpx", "sta zpx", "stx zpy", "0x97", "tya", "sta absy", "txs", "0x9B", "0x9C", "sta absx", "0x9E", "0x9F",
-	"ldy im", "lda indx", "ldx im", "0xA3", "sty zpx", "sta zpx", "stx zpy", "0xA7", "tay", "lda im", "tax", "0xAB", "ldy abs", "lda abs", "ldx abs", "0xAF",
-	"bcs", "lda indy", "0xB2", "0xB3", "ldy zpx", "lda zpx", "ldx zpy", "0xB7", "clv", "lda absx", "tsx", "0xBB", "ldy absx", "lda absx", "ldx absy", "0xBF",
-	"cpy im", "cmp indx", "0xC2", "0xC3", "cpy zp", "cmp zp", "dec zp", "0xC7", "iny", "cmp im", "dex", "0xCB", "cpy abs", "cmp abs", "dec abs", "0xCF",
-	"bne", "cmp indy", "0xD2", "0xD3", "0xD4", "cmp zpx", "dec zpx", "0xD7", "cld", "cmp absy", "0xDA", "0xDB", "0xDC", "cmp absx", "dec absx", "0xDF",
-	"cpx im", "sbc indx", "0xE2", "0xE3", "cpx zp", "sbc zp", "inc zp", "0xE7", "inx", "sbc im", "nop", "0xEB", "cpx abs", "sbc abs", "inc abs", "0xEF",
-	"beq", "sbc indy", "0xF2", "0xF3", "0xF4", "sbc zpx", "inc zpx", "0xF7", "sed", "sbc absy", "0xFA", "0xFB", "0xFC", "sbc absx", "inc absx", "0xFF"
-};
-*/
-
-int main() {
-	std::vector<m6502::BYTE> code;
-
-	for (m6502::WORD i = 0; i < 0xFFFF; i++) {
-		code.push_back(0xEA);
+// usage : main [--max-speed] [--trace-file path] [--disassemble] [--profile path] [--histogram] [--hex path | --raw path origin]
+// prints every bus access, unless --max-speed is given : runs unthrottled without the bus log and prints run statistics
+// --trace-file writes the bus accesses to a binary trace (read back with traceDump) instead of printing them
+// --disassemble prints the instructions executed after the run (recorded as raw bytes, disassembled once the run is over)
+// --profile writes the cycles of each call stack to path as folded stacks (for flamegraph.pl) and prints the cycles of each function
+// --histogram prints how many times each opcode ran (most frequent first), the page crosses of the indexed addressing modes and the branch outcomes
+// --hex and --raw run an Intel HEX file, or a raw binary loaded at origin (hexadecimal), instead of the built-in program. The image must set the reset vector
+int main(int argc, char **argv) {
+	bool maxSpeed = false;
+	bool disassemble = false;
+	bool countOpcodes = false;
+	const char *profileFile = nullptr;
+	const char *traceFile = nullptr;
+	const char *hexFile = nullptr;
+	const char *rawFile = nullptr;
+	m6502::WORD rawOrigin = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--max-speed") == 0) {
+			maxSpeed = true;
+		} else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			profileFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--histogram") == 0) {
+			countOpcodes = true;
+		} else if (std::strcmp(argv[i], "--disassemble") == 0) {
+			disassemble = true;
+		} else if (std::strcmp(argv[i], "--trace-file") == 0 && i + 1 < argc) {
+			traceFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--hex") == 0 && i + 1 < argc) {
+			hexFile = argv[++i];
+		} else if (std::strcmp(argv[i], "--raw") == 0 && i + 2 < argc) {
+			rawFile = argv[++i];
+			rawOrigin = (m6502::WORD)std::strtoul(argv[++i], nullptr, 16);
+		}
 	}
-	code.push_back(0xEA);
 
-	code[0xFFFC] = 0x08;
-	code[0xFFFD] = 0x20;
-	
 	// compute first 16 values of the fibonacci sequence until the end of time
-	// sets x to zero and jumps to subroutine
-	code[0x2008] = m6502::CPU::ins_ldx_im;
-	code[0x2009] = 0x00;
-	code[0x200A] = m6502::CPU::ins_jsr_abs;
-	code[0x200B] = 0x06;
-	code[0x200C] = 0x30;
-	// if x == 0xFF, continue. Otherwise, branch to jump to subroutine
-	code[0x200D] = m6502::CPU::ins_cpx_im;
-	code[0x200E] = 0xFF;
-	code[0x200F] = m6502::CPU::ins_bne;
-	code[0x2010] = 0xF9;
-	// sets x to zero and branch to jump to subroutine
-	code[0x2011] = m6502::CPU::ins_ldx_im;
-	code[0x2012] = 0x00;
-	code[0x2013] = m6502::CPU::ins_sec;
-	code[0x2014] = m6502::CPU::ins_bcc;
-	code[0x2015] = 0xF4;
-	
-	// subroutine branch if x == 0 or x == 1 : loads 1 into a and stores it at $0,X
-	code[0x3000] = m6502::CPU::ins_lda_im;
-	code[0x3001] = 0x01;
-	code[0x3002] = m6502::CPU::ins_sta_zpx;
-	code[0x3003] = 0x00;
-	// increments x and returns from subroutine
-	code[0x3004] = m6502::CPU::ins_inx;
-	code[0x3005] = m6502::CPU::ins_rts;
+	std::vector<m6502::BYTE> program = {
+		// sets x to zero and jumps to subroutine
+		m6502::CPU::ins_ldx_im, 0x00,			// 2008 : ldx #0
+		m6502::CPU::ins_jsr_abs, 0x06, 0x30,	// 200A : jsr $3006
+		// if x == 0xFF, continue. Otherwise, branch to jump to subroutine
+		m6502::CPU::ins_cpx_im, 0xFF,			// 200D : cpx #$FF
+		m6502::CPU::ins_bne, 0xF9,				// 200F : bne $200A
+		// sets x to zero and branch to jump to subroutine
+		m6502::CPU::ins_ldx_im, 0x00,			// 2011 : ldx #0
+		m6502::CPU::ins_sec,					// 2013 : sec
+		m6502::CPU::ins_bcc, 0xF4				// 2014 : bcc $200A
+	};
+	std::vector<m6502::BYTE> subroutine = {
+		// subroutine branch if x == 0 or x == 1 : loads 1 into a and stores it at $0,X
+		m6502::CPU::ins_lda_im, 0x01,			// 3000 : lda #1
+		m6502::CPU::ins_sta_zpx, 0x00,			// 3002 : sta $0,x
+		// increments x and returns from subroutine
+		m6502::CPU::ins_inx,					// 3004 : inx
+		m6502::CPU::ins_rts,					// 3005 : rts
+		// checks if x == 0 or x == 1. If so, branch to $3000
+		m6502::CPU::ins_cpx_im, 0x00,			// 3006 : cpx #0
+		m6502::CPU::ins_beq, 0xF6,				// 3008 : beq $3000
+		m6502::CPU::ins_cpx_im, 0x01,			// 300A : cpx #1
+		m6502::CPU::ins_beq, 0xF2,				// 300C : beq $3000
+		// loads $FF,X into a and adds $FE,X
+		m6502::CPU::ins_lda_zpx, 0xFF,			// 300E : lda $FF,x
+		m6502::CPU::ins_clc,					// 3010 : clc
+		m6502::CPU::ins_adc_zpx, 0xFE,			// 3011 : adc $FE,x
+		// stores a into $0,X, increments x and returns from subroutine
+		m6502::CPU::ins_sta_zpx, 0x00,			// 3013 : sta $0,x
+		m6502::CPU::ins_inx,					// 3015 : inx
+		m6502::CPU::ins_rts						// 3016 : rts
+	};
+	std::vector<m6502::BYTE> resetVector = {0x08, 0x20};
 
-	// checks if x == 0 or x == 1. If so, branch to $3000
-	code[0x3006] = m6502::CPU::ins_cpx_im;
-	code[0x3007] = 0x00;
-	code[0x3008] = m6502::CPU::ins_beq;
-	code[0x3009] = 0xF6;
-	code[0x300A] = m6502::CPU::ins_cpx_im;
-	code[0x300B] = 0x01;
-	code[0x300C] = m6502::CPU::ins_beq;
-	code[0x300D] = 0xF2;
-	// loads $FF,X into a and adds $FE,X
-	code[0x300E] = m6502::CPU::ins_lda_zpx;
-	code[0x300F] = 0xFF;
-	code[0x3010] = m6502::CPU::ins_clc;
-	code[0x3011] = m6502::CPU::ins_adc_zpx;
-	code[0x3012] = 0xFE;
-	// stores a into $0,X, increments x and returns from subroutine
-	code[0x3013] = m6502::CPU::ins_sta_zpx;
-	code[0x3014] = 0x00;
-	code[0x3015] = m6502::CPU::ins_inx;
-	code[0x3016] = m6502::CPU::ins_rts;
-	
 	uint32_t cycles = 0x00000FFC;
 	m6502::CPU cpu;
 	m6502::MEMORY mem;
 	
 	mem.init(&cycles);
-	mem.fill(code);
+	if (hexFile != nullptr) {
+		if (!m6502::loadHexFile(mem, hexFile)) {
+			std::cerr << "cannot load " << hexFile << std::endl;
+			return 1;
+		}
+	} else if (rawFile != nullptr) {
+		if (!m6502::loadRawFile(mem, rawFile, rawOrigin)) {
+			std::cerr << "cannot load " << rawFile << std::endl;
+			return 1;
+		}
+	} else {
+		m6502::loadSegments(mem, {{0x2008, program}, {0x3000, subroutine}, {0xFFFC, resetVector}});
+	}
+	m6502::TEXT_TRACE_SINK busLog(std::cout);
+	std::unique_ptr<m6502::BINARY_TRACE_SINK> binaryLog;
+	if (traceFile != nullptr) {
+		binaryLog.reset(new m6502::BINARY_TRACE_SINK(traceFile));
+		cpu.traceSink = binaryLog.get();
+	} else if (!maxSpeed) {
+		cpu.traceSink = &busLog;
+	}
+	// records the instructions in front of the bus log (if any)
+	m6502::INSTRUCTION_TRACE_SINK instructionLog(cpu.traceSink != &m6502::nullTraceSink ? cpu.traceSink : nullptr);
+	if (disassemble) {
+		cpu.traceSink = &instructionLog;
+	}
+	m6502::PROFILER profiler;
+	if (profileFile != nullptr) {
+		cpu.profiler = &profiler;
+	}
+	m6502::HISTOGRAM histogram;
+	if (countOpcodes) {
+		cpu.histogram = &histogram;
+	}
+	if (maxSpeed) {
+		cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+	}
 	cpu.reset(cycles, mem);
 	cpu.execute(cycles, mem);
+	busLog.flush();
+	if (binaryLog) {
+		binaryLog->close();
+	}
+	if (disassemble) {
+		instructionLog.write(std::cout);
+	}
+	if (profileFile != nullptr) {
+		std::ofstream folded(profileFile);
+		profiler.writeFolded(folded);
+		for (const m6502::PROFILER::FUNCTION &function : profiler.functions()) {
+			std::cout << profiler.name(function.address) << " : " << std::dec << function.calls << " calls, " << function.inclusive << " cycles inclusive, "
+				<< function.exclusive << " exclusive" << std::endl;
+		}
+	}
+	if (countOpcodes) {
+		static constexpr std::array<const char *, 256> names = m6502::opcodeNameTable();
+		for (m6502::BYTE opcode : histogram.ranking()) {
+			std::cout << (names[opcode] != nullptr ? names[opcode] : "???") << " : " << std::dec << histogram.opcodes[opcode];
+			const m6502::HISTOGRAM::BRANCH &branch = histogram.branches[opcode];
+			if (branch.taken + branch.notTaken > 0) {
+				std::cout << " (" << branch.taken << " taken, " << branch.crosses << " across a page, " << branch.notTaken << " not taken)";
+			}
+			std::cout << std::endl;
+		}
+		const char *modes[m6502::HISTOGRAM::INDEXED_MODES] = {"absolute X", "absolute Y", "indirect Y"};
+		for (int mode = 0; mode < m6502::HISTOGRAM::INDEXED_MODES; mode++) {
+			std::cout << modes[mode] << " reads : " << histogram.pageCrosses[mode].reads << ", " << histogram.pageCrosses[mode].crosses << " across a page" << std::endl;
+		}
+	}
+	if (maxSpeed) {
+		cpu.stats.report(std::cout);
+	}
 	for (m6502::BYTE i = 0; i < 0xFF; i++) {
 		std::cout << std::dec << (int)mem[i] << std::endl;
 	}
@@ -0,0 +1,111 @@
+#ifndef _MAPPER_H
+#define _MAPPER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "6502.h"
+
+namespace m6502 {
+
+	// bank-switching mapper : shows one bank of a memory larger than the window through a range of MEMORY pages
+	// the mapper is also a device on its register page. Writing any address of that page selects a bank, reading returns the selected bank
+	// selecting a bank only swaps the page pointers of the window (one per 256 bytes), nothing is copied
+	struct MAPPER : public DEVICE {
+		public:
+			// banks is the whole banked memory, cut in banks of nBankSize bytes (a multiple of the page size)
+			MAPPER(std::vector<BYTE> nBanks, uint32_t nBankSize, BYTE nWindowPage, bool nWritable)
+				: banks(nBanks), bankSize(nBankSize), windowPage(nWindowPage), writable(nWritable) {
+				banks.resize((banks.size() + bankSize - 1) / bankSize * bankSize);
+				banksTotal = banks.size() / bankSize;
+			}
+
+			// maps the register page and the window (showing bank 0) into nMem. The mapper must outlive the mapping
+			// returns false, mapping nothing, if there is no bank
+			virtual bool attach(MEMORY &nMem, BYTE registerPage) {
+				if (banksTotal == 0) {
+					return false;
+				}
+				mem = &nMem;
+				mem->mapDevice(registerPage, registerPage, this);
+				select(0);
+				return true;
+			}
+
+			// shows bank (modulo the number of banks) in the window
+			void select(uint32_t bank) {
+				selectedBank = (banksTotal > 0 ? bank % banksTotal : 0);
+				BYTE *bankData = banks.data() + selectedBank * bankSize;
+				BYTE lastPage = windowPage + bankSize / MEMORY::PAGE_SIZE - 1;
+				if (writable) {
+					mem->mapRam(windowPage, lastPage, bankData);
+				} else {
+					mem->mapRom(windowPage, lastPage, bankData);
+				}
+				switches++;
+			}
+
+			// returns the bank shown in the window
+			uint32_t bank() const {
+				return selectedBank;
+			}
+
+			// returns the number of banks
+			uint32_t bankCount() const {
+				return banksTotal;
+			}
+
+			// returns the banked memory (to inspect banks not currently selected)
+			const std::vector<BYTE> &bankedMemory() const {
+				return banks;
+			}
+
+			BYTE read(WORD) {
+				return selectedBank;
+			}
+
+			void write(WORD, BYTE value) {
+				select(value);
+			}
+
+			uint64_t switches = 0;	// bank selections since construction
+		protected:
+			MEMORY *mem = nullptr;
+			std::vector<BYTE> banks;	// banked memory
+			uint32_t bankSize;			// bytes per bank and size of the window
+			uint32_t banksTotal;		// number of banks
+			uint32_t selectedBank = 0;
+			BYTE windowPage;			// first page of the window
+			bool writable;				// RAM banks if true, ROM banks otherwise
+	}; // struct MAPPER : public DEVICE
+
+	// ROM cartridge in 16 KiB banks : a switchable window at 0x8000-0xBFFF and the last bank fixed at 0xC000-0xFFFF
+	// the fixed bank holds the vectors and the code that switches banks
+	struct ROM16_MAPPER : public MAPPER {
+		public:
+			static constexpr uint32_t BANK_SIZE = 0x4000;
+
+			ROM16_MAPPER(std::vector<BYTE> rom) : MAPPER(rom, BANK_SIZE, 0x80, false), romSize(rom.size()) {}
+
+			// returns false, mapping nothing, if the ROM is shorter than one bank (it would have no fixed bank with the vectors)
+			bool attach(MEMORY &nMem, BYTE registerPage) {
+				if (romSize < BANK_SIZE || !MAPPER::attach(nMem, registerPage)) {
+					return false;
+				}
+				mem->mapRom(0xC0, 0xFF, banks.data() + (banksTotal - 1) * bankSize);
+				return true;
+			}
+		private:
+			size_t romSize;	// bytes in the ROM image, before padding to a whole bank
+	}; // struct ROM16_MAPPER : public MAPPER
+
+	// banked RAM in 8 KiB banks shown through a switchable window (0xA000-0xBFFF by default)
+	struct RAM8_MAPPER : public MAPPER {
+		public:
+			static constexpr uint32_t BANK_SIZE = 0x2000;
+
+			RAM8_MAPPER(uint32_t nBankCount, BYTE nWindowPage = 0xA0) : MAPPER(std::vector<BYTE>(nBankCount * BANK_SIZE, 0), BANK_SIZE, nWindowPage, true) {}
+	}; // struct RAM8_MAPPER : public MAPPER
+} // namespace m6502
+
+#endif // ifndef _MAPPER_H
@@ -0,0 +1,234 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+#include <algorithm>
+
+namespace m6502 {
+
+	typedef uint8_t BYTE;	// uint8_t (1 byte)
+	typedef uint16_t WORD;	// uint16_t (2 bytes)
+
+	// guest profiler fed by a CPU compiled with M6502_PROFILE defined (without it, the CPU contains no profiling code at all)
+	// counts instructions and cycles per PC in flat 64K-entry arrays, and builds a call tree from JSR / RTS pairs : a function is the address a JSR
+	// (or an interrupt) lands on, and each node of the tree is a function reached through one chain of calls
+	// the cycles of an instruction are the time from its opcode fetch to the next one, so they include its page-cross and branch penalties
+	// interrupt handlers are entered like calls and left by RTI. The 7 cycles of the interrupt sequence count in the interrupted function (at no PC)
+	struct PROFILER {
+		public:
+			static constexpr BYTE OPCODE_JSR = 0x20;	// CPU::ins_jsr_abs
+			static constexpr BYTE OPCODE_RTS = 0x60;	// CPU::ins_rts
+			static constexpr BYTE OPCODE_RTI = 0x40;	// CPU::ins_rti
+			static constexpr size_t MAX_DEPTH = 1024;	// deeper calls (a JSR never returned from, in a loop) count in the deepest function
+
+			// totals of one function over every node of the call tree
+			struct FUNCTION {
+				WORD address;
+				uint64_t calls;			// times entered
+				uint64_t exclusive;		// cycles spent in the function itself
+				uint64_t inclusive;		// cycles spent in the function and everything it called (recursive calls counted once)
+			}; // struct FUNCTION
+
+			PROFILER() : instructions(0x10000, 0), cycles(0x10000, 0) {
+				clear();
+			}
+
+			// called by the CPU at each opcode fetch, at time (see CPU::now), for the instruction at address
+			void instruction(uint64_t time, WORD address, BYTE opcode) {
+				if (running) {
+					charge(time);
+				}
+				start(address);
+				if (pendingCall) {
+					enter(address);
+				} else if (pendingReturn) {
+					leave();
+				}
+				pendingCall = (opcode == OPCODE_JSR);
+				pendingReturn = (opcode == OPCODE_RTS || opcode == OPCODE_RTI);
+				instructions[address]++;
+				lastAddress = address;
+				lastTime = time;
+				running = true;
+				sequence = false;
+			}
+
+			// called by the CPU when it takes an interrupt at time, with the program counter at address : the next instruction is the entry of the handler
+			void interrupt(uint64_t time, WORD address) {
+				if (running) {
+					charge(time);
+				}
+				start(address);
+				// the transfer of the last instruction is done before the handler is entered
+				if (pendingCall) {
+					enter(address);
+				} else if (pendingReturn) {
+					leave();
+				}
+				pendingCall = true;
+				pendingReturn = false;
+				lastTime = time;
+				// the interrupt sequence is charged to the interrupted function, not to an instruction
+				running = true;
+				sequence = true;
+			}
+
+			// called by the CPU at the end of each run : charges the last instruction up to time
+			void finish(uint64_t time) {
+				if (running) {
+					charge(time);
+					running = false;
+				}
+			}
+
+			// forgets everything measured (the symbols are kept)
+			void clear() {
+				std::fill(instructions.begin(), instructions.end(), 0);
+				std::fill(cycles.begin(), cycles.end(), 0);
+				nodes.assign(1, {0, NO_NODE, 0, 0, NO_NODE, NO_NODE});
+				stack.assign(1, 0);
+				overflow = 0;
+				pendingCall = pendingReturn = running = sequence = false;
+			}
+
+			// returns the name of the function at address : its symbol, or "$xxxx"
+			std::string name(WORD address) const {
+				std::map<WORD, std::string>::const_iterator symbol = symbols.find(address);
+				if (symbol != symbols.end()) {
+					return symbol->second;
+				}
+				char text[8];
+				std::snprintf(text, sizeof(text), "$%04x", address);
+				return text;
+			}
+
+			// returns the totals of every function reached, by decreasing inclusive cycles
+			std::vector<FUNCTION> functions() const {
+				std::vector<uint64_t> inclusive(nodes.size(), 0);
+				for (size_t node = nodes.size(); node-- > 0;) {
+					// children are created after their parent : summing backwards completes each subtree before its parent is reached
+					inclusive[node] += nodes[node].self;
+					if (nodes[node].parent != NO_NODE) {
+						inclusive[nodes[node].parent] += inclusive[node];
+					}
+				}
+				std::map<WORD, FUNCTION> totals;
+				for (uint32_t node = 0; node < nodes.size(); node++) {
+					FUNCTION &function = totals.emplace(nodes[node].function, FUNCTION{nodes[node].function, 0, 0, 0}).first->second;
+					function.calls += nodes[node].calls;
+					function.exclusive += nodes[node].self;
+					if (!calledFromItself(node)) {
+						function.inclusive += inclusive[node];
+					}
+				}
+				std::vector<FUNCTION> result;
+				for (const std::pair<const WORD, FUNCTION> &total : totals) {
+					result.push_back(total.second);
+				}
+				std::stable_sort(result.begin(), result.end(), [](const FUNCTION &first, const FUNCTION &second) {
+					return first.inclusive > second.inclusive;
+				});
+				return result;
+			}
+
+			// writes the call tree as folded stacks ("root;caller;callee cycles" lines), the input of flamegraph.pl and compatible tools
+			void writeFolded(std::ostream &out) const {
+				std::vector<std::string> paths(nodes.size());
+				for (uint32_t node = 0; node < nodes.size(); node++) {
+					paths[node] = (nodes[node].parent == NO_NODE ? "" : paths[nodes[node].parent] + ";") + name(nodes[node].function);
+					if (nodes[node].self > 0) {
+						out << paths[node] << ' ' << nodes[node].self << '\n';
+					}
+				}
+			}
+
+			std::vector<uint64_t> instructions;		// instructions executed at each address
+			std::vector<uint64_t> cycles;			// cycles spent by the instructions at each address
+			std::map<WORD, std::string> symbols;	// optional function names, by address
+		private:
+			static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+			// one function reached through one chain of calls
+			struct NODE {
+				WORD function;
+				uint32_t parent;
+				uint64_t self;			// cycles spent in the function itself along this chain
+				uint64_t calls;
+				uint32_t firstChild;
+				uint32_t nextSibling;
+			}; // struct NODE
+
+			// names the root of the call tree after the address profiling starts at
+			void start(WORD address) {
+				if (nodes[0].calls == 0) {
+					nodes[0].function = address;
+					nodes[0].calls = 1;
+				}
+			}
+
+			// charges the instruction at lastAddress with the cycles up to time
+			void charge(uint64_t time) {
+				uint64_t elapsed = time - lastTime;
+				if (!sequence) {
+					cycles[lastAddress] += elapsed;
+				}
+				nodes[stack.back()].self += elapsed;
+			}
+
+			// enters function from the current node
+			void enter(WORD function) {
+				if (stack.size() >= MAX_DEPTH) {
+					overflow++;
+					return;
+				}
+				uint32_t parent = stack.back();
+				uint32_t child = nodes[parent].firstChild;
+				while (child != NO_NODE && nodes[child].function != function) {
+					child = nodes[child].nextSibling;
+				}
+				if (child == NO_NODE) {
+					child = nodes.size();
+					nodes.push_back({function, parent, 0, 0, NO_NODE, nodes[parent].firstChild});
+					nodes[parent].firstChild = child;
+				}
+				nodes[child].calls++;
+				stack.push_back(child);
+			}
+
+			// goes back to the caller. A return with no call (a guest leaving the function profiling started in) stays at the root
+			void leave() {
+				if (overflow > 0) {
+					overflow--;
+				} else if (stack.size() > 1) {
+					stack.pop_back();
+				}
+			}
+
+			// returns true if an ancestor of node is the same function (its cycles are already in the ancestor's inclusive total)
+			bool calledFromItself(uint32_t node) const {
+				for (uint32_t ancestor = nodes[node].parent; ancestor != NO_NODE; ancestor = nodes[ancestor].parent) {
+					if (nodes[ancestor].function == nodes[node].function) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			std::vector<NODE> nodes;		// call tree, node 0 being the root
+			std::vector<uint32_t> stack;	// nodes of the calls in progress, the current function last
+			size_t overflow = 0;			// calls past MAX_DEPTH not returned from
+			WORD lastAddress = 0;			// instruction being charged
+			uint64_t lastTime = 0;			// time of its opcode fetch
+			bool pendingCall = false;		// the last instruction was a JSR, or an interrupt was taken : the next one enters a function
+			bool pendingReturn = false;		// the last instruction was an RTS or RTI
+			bool running = false;			// an instruction (or an interrupt sequence) is being charged
+			bool sequence = false;			// what is being charged is an interrupt sequence
+	}; // struct PROFILER
+} // namespace m6502
+
+#endif // ifndef _PROFILER_H
@@ -0,0 +1,172 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace m6502 {
+
+	typedef uint8_t BYTE;	// uint8_t (1 byte)
+
+	// receives the events it scheduled
+	struct EVENT_HANDLER {
+		public:
+			virtual ~EVENT_HANDLER() {}
+
+			// called between two instructions, at the first boundary at or after time (the absolute emulated time it was scheduled for)
+			virtual void fire(uint64_t time) = 0;
+	}; // struct EVENT_HANDLER
+
+	// future events keyed on absolute emulated time (cycles since power-on, see CPU::now), and the interrupt lines of the CPU
+	// devices schedule what they will do next instead of being ticked every cycle. CPU::execute runs slices of instructions up to the next event,
+	// fires the events due between two slices, and only then looks at the interrupt lines : nothing is polled per instruction or per cycle
+	// IRQ is level-triggered (taken while any source holds it and the interrupt flag is clear), NMI is edge-triggered (latched when a first source asserts it)
+	struct SCHEDULER {
+		public:
+			typedef uint64_t EVENT_ID;
+
+			static constexpr uint64_t NEVER = UINT64_MAX;	// nextTime with no event scheduled
+
+			// schedules handler to fire at time. Events due at the same time fire in scheduling order. Returns an id for cancel
+			EVENT_ID schedule(uint64_t time, EVENT_HANDLER *handler) {
+				EVENT_ID id = nextId++;
+				events.push_back({time, id, handler});
+				std::push_heap(events.begin(), events.end(), later);
+				// the running slice ends after the new event : cut it so the CPU gets back to the scheduler in time
+				if (budget != nullptr && time < sliceEnd) {
+					interruptSlice();
+				}
+				return id;
+			}
+
+			// cancels an event not fired yet. Returns false if it already fired or was cancelled
+			bool cancel(EVENT_ID id) {
+				for (EVENT &event : events) {
+					if (event.id == id && event.handler != nullptr) {
+						// left in the heap, skipped when it comes out
+						event.handler = nullptr;
+						return true;
+					}
+				}
+				return false;
+			}
+
+			// returns the time of the next event, NEVER if there is none
+			uint64_t nextTime() {
+				dropCancelled();
+				return (events.empty() ? NEVER : events.front().time);
+			}
+
+			// fires every event due at time, including those scheduled meanwhile by the handlers. Returns the number fired
+			uint32_t runDue(uint64_t time) {
+				sliceEnd = time;
+				uint32_t count = 0;
+				while (nextTime() <= time) {
+					std::pop_heap(events.begin(), events.end(), later);
+					EVENT event = events.back();
+					events.pop_back();
+					event.handler->fire(event.time);
+					count++;
+				}
+				fired += count;
+				return count;
+			}
+
+			// returns the number of events waiting (cancelled ones included until they come out)
+			size_t pending() const {
+				return events.size();
+			}
+
+			// drives the IRQ line of source (0 to 31) : the line is held while any source asserts it
+			void irq(BYTE source, bool asserted) {
+				uint32_t previous = irqLines;
+				irqLines = (asserted ? irqLines | 1u << source : irqLines & ~(1u << source));
+				if (previous == 0 && irqLines != 0) {
+					interruptSlice();
+				}
+			}
+
+			// drives the NMI line of source (0 to 31) : an NMI is latched when the line goes from released to held
+			void nmi(BYTE source, bool asserted) {
+				uint32_t previous = nmiLines;
+				nmiLines = (asserted ? nmiLines | 1u << source : nmiLines & ~(1u << source));
+				if (previous == 0 && nmiLines != 0) {
+					nmiPending = true;
+					interruptSlice();
+				}
+			}
+
+			// returns true while a source holds the IRQ line
+			bool irqAsserted() const {
+				return irqLines != 0;
+			}
+
+			// returns the absolute emulated time : the current access with cycle-exact timing, the start of the current instruction with per-instruction timing
+			uint64_t now() const {
+				// the budget wraps below 0 when the last instruction of a slice overruns it
+				return (budget != nullptr ? sliceEnd - (int32_t)*budget - cut : sliceEnd);
+			}
+
+			// ends the running slice at the end of the current instruction (on a line change, or when the interrupt flag is cleared with IRQ held)
+			void interruptSlice() {
+				if (budget != nullptr && *budget > 0 && *budget < 0xFFFFFFFA) {
+					cut += *budget;
+					*budget = 0;
+				}
+			}
+
+			// called by the CPU before running a slice on nBudget, starting at time start
+			void enter(uint32_t *nBudget, uint64_t start) {
+				budget = nBudget;
+				sliceEnd = start + *nBudget;
+				cut = 0;
+			}
+
+			// called by the CPU after the slice. Returns the cycles cut from its budget by interruptSlice
+			uint32_t leave() {
+				sliceEnd = now();
+				budget = nullptr;
+				uint32_t cutCycles = cut;
+				cut = 0;
+				return cutCycles;
+			}
+
+			// returns the cycles cut from the running slice so far
+			uint32_t cutCycles() const {
+				return cut;
+			}
+
+			bool nmiPending = false;	// NMI latched, cleared when the CPU takes it
+			uint64_t fired = 0;			// events fired since construction
+		private:
+			struct EVENT {
+				uint64_t time;
+				EVENT_ID id;				// also orders events due at the same time
+				EVENT_HANDLER *handler;		// nullptr once cancelled
+			}; // struct EVENT
+
+			// heap order : the earliest event (then the first scheduled) on top
+			static bool later(const EVENT &first, const EVENT &second) {
+				return first.time > second.time || (first.time == second.time && first.id > second.id);
+			}
+
+			// pops the cancelled events off the top of the heap
+			void dropCancelled() {
+				while (!events.empty() && events.front().handler == nullptr) {
+					std::pop_heap(events.begin(), events.end(), later);
+					events.pop_back();
+				}
+			}
+
+			std::vector<EVENT> events;		// binary heap (see later)
+			EVENT_ID nextId = 0;
+			uint32_t irqLines = 0;			// one bit per source holding IRQ
+			uint32_t nmiLines = 0;			// one bit per source holding NMI
+			uint32_t *budget = nullptr;		// cycle budget of the running slice, nullptr between slices
+			uint64_t sliceEnd = 0;			// time at which the running slice ends (before any cut), the current time between slices
+			uint32_t cut = 0;				// cycles taken from the budget by interruptSlice
+	}; // struct SCHEDULER
+} // namespace m6502
+
+#endif // ifndef _SCHEDULER_H
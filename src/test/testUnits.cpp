@@ -1,29 +1,31 @@
 #include <cassert>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <random>
 
+#define M6502_TRACE
+#define M6502_PROFILE
+#define M6502_HISTOGRAM
 #include "../6502.h"
+#include "../tracefile.h"
+#include "../mapper.h"
+#include "../batch.h"
+#include "../lockstep.h"
+#include "../jit.h"
+#include "../via.h"
+#include "../loader.h"
+#include "../disasm.h"
 
 std::vector<m6502::BYTE> constructProgram(std::vector<m6502::BYTE> program, std::vector<m6502::BYTE> zp) {
-	std::vector<m6502::BYTE> data;
-	for (m6502::WORD i = 0; i < 0xFFFF; i++) {
-		data.push_back(0xEA);
-	}
-	data.push_back(0xEA);
+	std::vector<m6502::BYTE> data(m6502::MEMORY::MEM_SIZE, 0xEA);
 	data[0xFFFC] = 0x00;
 	data[0xFFFD] = 0x20;
 	data[0xFFFE] = 0x00;
 	data[0xFFFF] = 0xFF;
-	for (m6502::BYTE i = 0x00; i < zp.size(); i++) {
-		data[i] = zp[i];
-		if (i = 0xFF) {
-			break;
-		}
-	}
-	for (m6502::WORD i = 0x2000; i < program.size() + 0x2000; i++) {
-		if (i == 0xFF00) {
-			break;
-		}
-		data[i] = program[i - 0x2000];
-	}
+	std::copy(zp.begin(), zp.begin() + std::min(zp.size(), (size_t)0x100), data.begin());
+	std::copy(program.begin(), program.begin() + std::min(program.size(), (size_t)(0xFF00 - 0x2000)), data.begin() + 0x2000);
 	return data;
 }
 
@@ -178,6 +180,1768 @@ class H : public testUnit {
 		}
 }; // class H : public testUnit
 
+// test unit for trace sinks
+class I : public testUnit {
+	public:
+		void test() {
+			std::cout << "test I started" << std::endl;
+			m6502::RING_TRACE_SINK<4> ring;
+			cpu.traceSink = &ring;
+			cpu.rw(mem, 0x1234, m6502::CPU::WRITE, 0x42);
+			assert(cpu.rw(mem, 0x1234, m6502::CPU::READ) == 0x42);
+			m6502::TRACE_RECORD record;
+			assert(ring.pop(record) && record.address == 0x1234 && !record.read && record.value == 0x42);
+			assert(ring.pop(record) && record.address == 0x1234 && record.read && record.value == 0x42);
+			assert(!ring.pop(record));
+			std::cout << "test I : first assert passed" << std::endl;
+			for (int i = 0; i < 6; i++) {
+				cpu.rw(mem, i, m6502::CPU::READ);
+			}
+			assert(ring.size() == 4 && ring.dropped == 2);
+			std::cout << "test I : second assert passed" << std::endl;
+			std::ostringstream text;
+			m6502::TEXT_TRACE_SINK textSink(text);
+			cpu.traceSink = &textSink;
+			cpu.rw(mem, 0xBEEF, m6502::CPU::WRITE, 0x0A);
+			textSink.flush();
+			assert(text.str() == "beef W 0a\n");
+			std::cout << "test I : third assert passed" << std::endl;
+			cpu.traceSink = &m6502::nullTraceSink;
+			std::cout << "test I completed" << std::endl;
+		}
+}; // class I : public testUnit
+
+// test unit for binary trace files
+class J : public testUnit {
+	public:
+		void test() {
+			std::cout << "test J started" << std::endl;
+			const char *path = "testUnitJ.trc";
+			{
+				// 3 records per chunk so that seeking has to use the index
+				m6502::BINARY_TRACE_SINK sink(path, 3);
+				sink.access(10, 0x2000, true, 0xA9);
+				sink.access(11, 0x2001, true, 0x42);
+				sink.access(12, 0x0042, false, 0x42);
+				sink.access(12, 0x0043, false, 0x00);
+				sink.access(500, 0xBEEF, true, 0xFF);
+				sink.access(70000, 0xBEF0, true, 0x01);
+				sink.access(70001, 0xBEF0, false, 0x02);
+				// accesses after close are ignored
+				sink.close();
+				sink.access(70002, 0xBEF1, true, 0x03);
+			}
+			m6502::TRACE_READER reader;
+			assert(reader.open(path));
+			assert(reader.chunks() == 3);
+			std::cout << "test J : first assert passed" << std::endl;
+			m6502::TRACE_RECORD record;
+			int count = 0;
+			while (reader.next(record)) {
+				count++;
+			}
+			assert(count == 7 && record.cycle == 0);
+			reader.seek(0);
+			assert(reader.next(record) && record.cycle == 10 && record.address == 0x2000 && record.read && record.value == 0xA9);
+			std::cout << "test J : second assert passed" << std::endl;
+			reader.seek(12);
+			assert(reader.next(record) && record.cycle == 12 && record.address == 0x0042 && !record.read);
+			assert(reader.next(record) && record.cycle == 12 && record.address == 0x0043);
+			reader.seek(501);
+			assert(reader.next(record) && record.cycle == 70000 && record.address == 0xBEF0 && record.value == 0x01);
+			assert(reader.next(record) && record.cycle == 70001 && record.address == 0xBEF0 && !record.read && record.value == 0x02);
+			assert(!reader.next(record));
+			std::cout << "test J : third assert passed" << std::endl;
+			reader.close();
+			std::vector<char> bytes;
+			{
+				std::ifstream in(path, std::ios::binary);
+				bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			}
+			// first chunk byte length past the index : rejected by open
+			assert(writePatched(path, bytes, m6502::tracefile::FILE_HEADER_SIZE + 12, 0x7F) && !reader.open(path));
+			// first chunk cut to 1 byte : its first record (tag, full address and value) stops at the end of the chunk
+			assert(writePatched(path, bytes, m6502::tracefile::FILE_HEADER_SIZE + 12, 0x01) && reader.open(path));
+			assert(!reader.next(record) && record.cycle == 0);
+			reader.close();
+			std::remove(path);
+			std::cout << "test J completed" << std::endl;
+		}
+	private:
+		// writes bytes back to path with bytes[at] replaced by value. Returns true once written
+		static bool writePatched(const char *path, std::vector<char> bytes, size_t at, char value) {
+			bytes[at] = value;
+			std::ofstream out(path, std::ios::binary | std::ios::trunc);
+			out.write(bytes.data(), bytes.size());
+			return out.good();
+		}
+}; // class J : public testUnit
+
+// test unit for cycle accounting : per-access and per-instruction timing must charge the same cycles for every instruction
+class K : public testUnit {
+	public:
+		void test() {
+			std::cout << "test K started" << std::endl;
+			for (const OPCODE &opcode : opcodes) {
+				// no page cross, branch not taken : base cycles of the table
+				assert(run<m6502::CPU>(opcode.instruction, NO_PENALTY) == opcode.cycles);
+			}
+			std::cout << "test K : first assert passed" << std::endl;
+			for (const OPCODE &opcode : opcodes) {
+				for (int scenario = NO_PENALTY; scenario <= BRANCH_PAGE_CROSS; scenario++) {
+					assert(run<m6502::CPU>(opcode.instruction, scenario) == run<m6502::FAST_CPU>(opcode.instruction, scenario));
+				}
+			}
+			std::cout << "test K : second assert passed" << std::endl;
+			for (int instruction = 0x00; instruction <= 0xFF; instruction++) {
+				assert(run<m6502::CPU>(instruction, NO_PENALTY) == run<m6502::FAST_CPU>(instruction, NO_PENALTY));
+			}
+			std::cout << "test K completed" << std::endl;
+		}
+	private:
+		enum SCENARIO {
+			NO_PENALTY,			// indexed accesses stay in their page, branches are not taken
+			PAGE_CROSS,			// indexed accesses cross a page, branches are not taken
+			BRANCH_TAKEN,		// branches are taken within their page
+			BRANCH_PAGE_CROSS	// branches are taken to another page
+		};
+
+		struct OPCODE {
+			m6502::BYTE instruction;
+			uint32_t cycles;
+		};
+
+		#define K_OPCODE(name, operation, mode, cycles) {m6502::CPU::ins_##name, cycles},
+		static constexpr OPCODE opcodes[] = {M6502_OPCODES(K_OPCODE)};
+		#undef K_OPCODE
+
+		// executes one instruction at 0x20F0 and returns the cycles it took
+		template <class CPU_TYPE>
+		uint32_t run(m6502::BYTE instruction, int scenario) {
+			uint32_t runCycles = 7;
+			m6502::MEMORY runMem;
+			CPU_TYPE runCpu;
+			runMem.init(&runCycles);
+			runCpu.reset(runCycles, runMem);
+			runCpu.reg_programCounter = 0x20F0;
+			runCpu.reg_stackPointer = 0xF0;
+			runMem.at(0x20F0) = instruction;
+			// bcs, beq, bmi and bvs (bit 5 set) branch on a set flag, the other branches on a clear one
+			bool taken = (scenario == BRANCH_TAKEN || scenario == BRANCH_PAGE_CROSS);
+			runCpu.fl_carry = runCpu.fl_zero = runCpu.fl_neg = runCpu.fl_oflow = ((instruction & 0x20) ? taken : !taken);
+			if (scenario == NO_PENALTY || scenario == PAGE_CROSS) {
+				// operand 0x3010 (absolute) or 0x10 (zero page), indirect pointer 0x10 to 0x3010
+				runMem.at(0x20F1) = 0x10;
+				runMem.at(0x20F2) = 0x30;
+				runMem.at(0x10) = 0x10;
+				runMem.at(0x11) = 0x30;
+				runCpu.reg_x = runCpu.reg_y = (scenario == PAGE_CROSS ? 0xF0 : 0x01);
+			} else {
+				// branch offset from 0x20F2 : +2 stays in page 0x20, +0x10 crosses into page 0x21
+				runMem.at(0x20F1) = (scenario == BRANCH_TAKEN ? 0x02 : 0x10);
+			}
+			runCycles = 1000;
+			runCpu.step(runCycles, runMem);
+			return 1000 - runCycles;
+		}
+}; // class K : public testUnit
+
+// test unit for the paged memory bus : RAM, ROM and device pages
+class L : public testUnit {
+	public:
+		void test() {
+			std::cout << "test L started" << std::endl;
+			// the whole 64 KiB are addressable, 0xFFFF included
+			cpu.rw(mem, 0xFFFE, m6502::CPU::WRITE, 0x12);
+			cpu.rw(mem, 0xFFFF, m6502::CPU::WRITE, 0x34);
+			assert(mem.at(0xFFFE) == 0x12 && mem.at(0xFFFF) == 0x34);
+			std::cout << "test L : first assert passed" << std::endl;
+			mem.at(0xE000) = 0x42;
+			mem.mapRom(0xE0, 0xFF);
+			cpu.rw(mem, 0xE000, m6502::CPU::WRITE, 0x00);
+			assert(cpu.rw(mem, 0xE000, m6502::CPU::READ) == 0x42 && mem.at(0xE000) == 0x42);
+			std::cout << "test L : second assert passed" << std::endl;
+			LATCH latch;
+			mem.mapDevice(0xD0, 0xD0, &latch);
+			uint32_t startCycles = cycles;
+			cpu.rw(mem, 0xD012, m6502::CPU::WRITE, 0x99);
+			assert(latch.address == 0xD012 && latch.value == 0x99);
+			assert(cpu.rw(mem, 0xD0FF, m6502::CPU::READ) == 0x99 && latch.address == 0xD0FF);
+			assert(startCycles - cycles == 2);
+			std::cout << "test L : third assert passed" << std::endl;
+			// pages around the device are still RAM
+			cpu.rw(mem, 0xCFFF, m6502::CPU::WRITE, 0x01);
+			cpu.rw(mem, 0xD100, m6502::CPU::WRITE, 0x02);
+			assert(mem.at(0xCFFF) == 0x01 && mem.at(0xD100) == 0x02);
+			mem.mapRam(0xD0, 0xD0);
+			cpu.rw(mem, 0xD012, m6502::CPU::WRITE, 0x03);
+			assert(mem.at(0xD012) == 0x03 && latch.value == 0x99);
+			std::cout << "test L : fourth assert passed" << std::endl;
+			std::cout << "test L completed" << std::endl;
+		}
+	private:
+		// device remembering the last access
+		struct LATCH : public m6502::DEVICE {
+			m6502::BYTE read(m6502::WORD nAddress) {
+				address = nAddress;
+				return value;
+			}
+
+			void write(m6502::WORD nAddress, m6502::BYTE nValue) {
+				address = nAddress;
+				value = nValue;
+			}
+
+			m6502::WORD address = 0;
+			m6502::BYTE value = 0;
+		};
+}; // class L : public testUnit
+
+// test unit for bank-switching mappers
+class M : public testUnit {
+	public:
+		void test() {
+			std::cout << "test M started" << std::endl;
+			// 4 banks of 16 KiB, each starting with its number
+			std::vector<m6502::BYTE> rom(4 * m6502::ROM16_MAPPER::BANK_SIZE, 0xEA);
+			for (int bank = 0; bank < 4; bank++) {
+				rom[bank * m6502::ROM16_MAPPER::BANK_SIZE] = bank;
+			}
+			// an empty ROM, or one shorter than its fixed bank, maps nothing
+			m6502::ROM16_MAPPER empty({});
+			m6502::ROM16_MAPPER truncated(std::vector<m6502::BYTE>(m6502::ROM16_MAPPER::BANK_SIZE - 1, 0xEA));
+			assert(!empty.attach(mem, 0x7F) && !truncated.attach(mem, 0x7F) && !mem.isDevice(0x7F));
+			m6502::ROM16_MAPPER cartridge(rom);
+			assert(cartridge.attach(mem, 0x7F));
+			assert(cpu.rw(mem, 0x8000, m6502::CPU::READ) == 0 && cpu.rw(mem, 0xC000, m6502::CPU::READ) == 3);
+			std::cout << "test M : first assert passed" << std::endl;
+			cpu.rw(mem, 0x7F00, m6502::CPU::WRITE, 2);
+			assert(cpu.rw(mem, 0x8000, m6502::CPU::READ) == 2 && cpu.rw(mem, 0xC000, m6502::CPU::READ) == 3);
+			assert(cpu.rw(mem, 0x7F42, m6502::CPU::READ) == 2 && cartridge.bank() == 2);
+			cpu.rw(mem, 0x8000, m6502::CPU::WRITE, 0x55);
+			assert(cpu.rw(mem, 0x8000, m6502::CPU::READ) == 2);
+			std::cout << "test M : second assert passed" << std::endl;
+			m6502::RAM8_MAPPER expansion(3);
+			assert(expansion.attach(mem, 0x9F));
+			cpu.rw(mem, 0xA010, m6502::CPU::WRITE, 0x10);
+			cpu.rw(mem, 0x9F00, m6502::CPU::WRITE, 1);
+			cpu.rw(mem, 0xBFFF, m6502::CPU::WRITE, 0x11);
+			assert(cpu.rw(mem, 0xA010, m6502::CPU::READ) == 0x00);
+			cpu.rw(mem, 0x9F00, m6502::CPU::WRITE, 3);
+			assert(expansion.bank() == 0 && cpu.rw(mem, 0xA010, m6502::CPU::READ) == 0x10);
+			assert(expansion.bankedMemory()[2 * m6502::RAM8_MAPPER::BANK_SIZE - 1] == 0x11);
+			assert(mem.at(0xA010) == 0x00);
+			std::cout << "test M : third assert passed" << std::endl;
+			std::cout << "test M completed" << std::endl;
+		}
+}; // class M : public testUnit
+
+// test unit for save states
+class N : public testUnit {
+	public:
+		void test() {
+			std::cout << "test N started" << std::endl;
+			cpu.reg_acc = 1;
+			cpu.fl_carry = false;
+			m6502::CPU::STATE first = cpu.save(mem);
+			assert(mem.dirtyPages() == 0);
+			cpu.rw(mem, 0x3000, m6502::CPU::WRITE, 0x11);
+			cpu.rw(mem, 0x3001, m6502::CPU::WRITE, 0x12);
+			cpu.rw(mem, 0x5000, m6502::CPU::WRITE, 0x13);
+			assert(mem.dirtyPages() == 2);
+			std::cout << "test N : first assert passed" << std::endl;
+			cpu.reg_acc = 2;
+			cpu.fl_carry = true;
+			m6502::CPU::STATE second = cpu.save(mem);
+			// unwritten pages are shared between the two snapshots
+			assert(second.memory.pages[0x10] == first.memory.pages[0x10] && second.memory.pages[0x30] != first.memory.pages[0x30]);
+			std::cout << "test N : second assert passed" << std::endl;
+			cpu.rw(mem, 0x6000, m6502::CPU::WRITE, 0x14);
+			cpu.restore(first, mem);
+			assert(cpu.reg_acc == 1 && !cpu.fl_carry);
+			assert(cpu.rw(mem, 0x3000, m6502::CPU::READ) == 0 && cpu.rw(mem, 0x5000, m6502::CPU::READ) == 0 && cpu.rw(mem, 0x6000, m6502::CPU::READ) == 0);
+			std::cout << "test N : third assert passed" << std::endl;
+			cpu.restore(second, mem);
+			assert(cpu.reg_acc == 2 && cpu.fl_carry);
+			assert(cpu.rw(mem, 0x3001, m6502::CPU::READ) == 0x12 && cpu.rw(mem, 0x5000, m6502::CPU::READ) == 0x13 && cpu.rw(mem, 0x6000, m6502::CPU::READ) == 0);
+			assert(mem.dirtyPages() == 0);
+			std::cout << "test N : fourth assert passed" << std::endl;
+			// the flags are the bits of the status register, as pushed on the stack
+			cpu.reg_status = 0;
+			cpu.fl_carry = cpu.fl_dec = cpu.fl_oflow = cpu.fl_neg = true;
+			assert(cpu.reg_status == 0b11001001 && cpu.status(0b00110000) == 0b11111001);
+			cpu.setStatus(0b00110110);
+			assert(cpu.reg_status == 0b00000110 && !cpu.fl_carry && cpu.fl_zero && cpu.fl_interr && !cpu.fl_dec && !cpu.fl_oflow && !cpu.fl_neg);
+			m6502::CPU::STATE third = cpu.save(mem);
+			cpu.reg_status = 0;
+			cpu.restore(third, mem);
+			assert(cpu.reg_status == 0b00000110 && cpu.reg_acc == 2);
+			std::cout << "test N : fifth assert passed" << std::endl;
+			// each flag on its own bit, both ways
+			for (m6502::BYTE bit : {0b00000001, 0b00000010, 0b00000100, 0b00001000, 0b01000000, 0b10000000}) {
+				cpu.reg_status = bit;
+				assert(flags(cpu) == bit);
+				cpu.reg_status = 0;
+				setFlag(cpu, bit);
+				assert(cpu.reg_status == bit);
+			}
+			std::cout << "test N : sixth assert passed" << std::endl;
+			std::cout << "test N completed" << std::endl;
+		}
+	private:
+		// returns the fl_* bitfields of registers as NV--DIZC, read one by one
+		static m6502::BYTE flags(const m6502::REGISTERS &registers) {
+			return registers.fl_neg << 7 | registers.fl_oflow << 6 | registers.fl_dec << 3 | registers.fl_interr << 2 | registers.fl_zero << 1 | registers.fl_carry;
+		}
+
+		// sets the fl_* bitfield standing for bit (of NV--DIZC) in registers
+		static void setFlag(m6502::REGISTERS &registers, m6502::BYTE bit) {
+			switch (bit) {
+				case 0b00000001: registers.fl_carry = true; break;
+				case 0b00000010: registers.fl_zero = true; break;
+				case 0b00000100: registers.fl_interr = true; break;
+				case 0b00001000: registers.fl_dec = true; break;
+				case 0b01000000: registers.fl_oflow = true; break;
+				case 0b10000000: registers.fl_neg = true; break;
+			}
+		}
+}; // class N : public testUnit
+
+// test unit for the batch runner
+class O : public testUnit {
+	public:
+		void test() {
+			std::cout << "test O started" << std::endl;
+			// adds the two input bytes at 0x10, stores the sum at 0x20 and halts with it, or loops forever if the first input is 0xFF
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_lda_zp, 0x10,			// 2000 : lda $10
+				m6502::CPU::ins_cmp_im, 0xFF,			// 2002 : cmp #$FF
+				m6502::CPU::ins_beq, 0xFE,				// 2004 : beq $2004
+				m6502::CPU::ins_clc,					// 2006 : clc
+				m6502::CPU::ins_adc_zp, 0x11,			// 2007 : adc $11
+				m6502::CPU::ins_sta_zp, 0x20,			// 2009 : sta $20
+				m6502::CPU::ins_sta_abs, 0x00, 0xDF,	// 200B : sta $DF00 (halt)
+				m6502::CPU::ins_jmp_abs, 0x0E, 0x20		// 200E : jmp $200E
+			};
+			std::shared_ptr<std::vector<m6502::BYTE>> image = std::make_shared<std::vector<m6502::BYTE>>(constructProgram(program, {}));
+			std::vector<m6502::BATCH_JOB> jobs(100);
+			for (int i = 0; i < 100; i++) {
+				jobs[i].image = image;
+				jobs[i].inputAddress = 0x10;
+				jobs[i].input = {(m6502::BYTE)(i == 42 ? 0xFF : i), 3};
+				jobs[i].cycles = 50000;
+				jobs[i].outputAddress = 0x20;
+				jobs[i].outputLength = 1;
+			}
+			m6502::BATCH_RUNNER runner(4);
+			std::vector<m6502::BATCH_RESULT> results = runner.run(jobs);
+			assert(results.size() == 100);
+			for (int i = 0; i < 100; i++) {
+				if (i == 42) {
+					continue;
+				}
+				assert(results[i].halted && results[i].haltCode == i + 3 && results[i].output[0] == i + 3);
+				// lda 3, cmp 2, beq 2, clc 2, adc 3, sta 3, sta 4
+				assert(results[i].cycles == 19);
+			}
+			std::cout << "test O : first assert passed" << std::endl;
+			assert(!results[42].halted && results[42].cycles >= 50000 && results[42].cycles < 50004 && results[42].programCounter == 0x2004);
+			std::cout << "test O : second assert passed" << std::endl;
+			// the runner and its workers are reused for a second run
+			jobs.resize(10);
+			results = runner.run(jobs);
+			assert(results.size() == 10 && results[9].halted && results[9].haltCode == 12);
+			std::cout << "test O : third assert passed" << std::endl;
+			// workers restore the image between jobs : nothing written by a job (its input, its sum) is seen by the next one, on either image
+			std::vector<m6502::BYTE> zp(0x12, 0);
+			zp[0x11] = 5;
+			std::shared_ptr<std::vector<m6502::BYTE>> other = std::make_shared<std::vector<m6502::BYTE>>(constructProgram(program, zp));
+			for (int i = 0; i < 10; i++) {
+				jobs[i].image = (i % 2 == 0 ? image : other);
+				jobs[i].input = (i % 4 == 0 ? std::vector<m6502::BYTE>{(m6502::BYTE)i, 3} : std::vector<m6502::BYTE>{});
+			}
+			results = runner.run(jobs);
+			for (int i = 0; i < 10; i++) {
+				// without input, the first image adds its fill bytes (0xEA + 0xEA), the other one 0 + 5
+				assert(results[i].halted && results[i].haltCode == (i % 4 == 0 ? i + 3 : i % 2 == 0 ? 0xD4 : 5));
+			}
+			std::cout << "test O : fourth assert passed" << std::endl;
+			std::cout << "test O completed" << std::endl;
+		}
+}; // class O : public testUnit
+
+// test unit for the lockstep engine : every lane must end like the same program run alone on a FAST_CPU
+class P : public testUnit {
+	public:
+		void test() {
+			std::cout << "test P started" << std::endl;
+			// lanes differ by their input at 0x10 : indexed reads cross a page in some lanes, branches and loop counts split the lanes
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldx_zp, 0x10,			// 2000 : ldx $10
+				m6502::CPU::ins_lda_absx, 0xF0, 0x30,	// 2002 : lda $30F0,x
+				m6502::CPU::ins_sta_zp, 0x40,			// 2005 : sta $40
+				m6502::CPU::ins_txa,					// 2007 : txa
+				m6502::CPU::ins_and_im, 0x03,			// 2008 : and #$03
+				m6502::CPU::ins_beq, 0x04,				// 200A : beq $2010
+				m6502::CPU::ins_ora_im, 0x50,			// 200C : ora #$50
+				m6502::CPU::ins_sta_zp, 0x41,			// 200E : sta $41
+				m6502::CPU::ins_lda_im, 0x00,			// 2010 : lda #$00
+				m6502::CPU::ins_eor_zp, 0x40,			// 2012 : eor $40
+				m6502::CPU::ins_sta_absx, 0x00, 0x50,	// 2014 : sta $5000,x
+				m6502::CPU::ins_inx,					// 2017 : inx
+				m6502::CPU::ins_dex,					// 2018 : dex
+				m6502::CPU::ins_beq, 0x05,				// 2019 : beq $2020
+				m6502::CPU::ins_dex,					// 201B : dex
+				m6502::CPU::ins_bne, 0xFD,				// 201C : bne $201B
+				m6502::CPU::ins_ldy_im, 0x07,			// 201E : ldy #$07
+				m6502::CPU::ins_sty_zp, 0x42,			// 2020 : sty $42
+				m6502::CPU::ins_jmp_abs, 0x22, 0x20		// 2022 : jmp $2022
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			for (int i = 0; i < 0x20; i++) {
+				image[0x30F0 + i] = 0x80 + i;
+			}
+			std::unique_ptr<m6502::LOCKSTEP> lockstep = std::make_unique<m6502::LOCKSTEP>();
+			lockstep->load(image);
+			for (int lane = 0; lane < LANES; lane++) {
+				lockstep->write(lane, 0x10, input(lane));
+			}
+			lockstep->reset();
+			lockstep->execute(400);
+			// the last quarter of the lanes follows lane 5 without leaving the vector, the branches eject the others
+			assert(lockstep->ejections > 0 && lockstep->ejections < LANES);
+			std::cout << "test P : first assert passed" << std::endl;
+			for (int lane = 0; lane < LANES; lane++) {
+				image[0x10] = input(lane);
+				mem.init(&cycles);
+				mem.fill(image);
+				m6502::FAST_CPU scalar;
+				scalar.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+				cycles = 7;
+				scalar.reset(cycles, mem);
+				cycles = 400;
+				scalar.execute(cycles, mem);
+				assert(lockstep->reg_acc[lane] == scalar.reg_acc && lockstep->reg_x[lane] == scalar.reg_x && lockstep->reg_y[lane] == scalar.reg_y);
+				assert(lockstep->fl_zero[lane] == scalar.fl_zero && lockstep->fl_neg[lane] == scalar.fl_neg && lockstep->reg_stackPointer[lane] == scalar.reg_stackPointer);
+				assert(lockstep->reg_programCounter[lane] == scalar.reg_programCounter && lockstep->laneCycles[lane] == scalar.stats.cycles);
+				for (m6502::WORD address : {0x40, 0x41, 0x42, 0x5000 + lane, 0x5005}) {
+					assert(lockstep->read(lane, address) == mem.readAt(address));
+				}
+			}
+			std::cout << "test P : second assert passed" << std::endl;
+			std::cout << "test P completed" << std::endl;
+		}
+	private:
+		static constexpr int LANES = m6502::LOCKSTEP::LANE_COUNT;
+
+		// returns the input of lane at 0x10
+		static m6502::BYTE input(int lane) {
+			return (m6502::BYTE)(lane < LANES * 3 / 4 ? lane : 5);
+		}
+}; // class P : public testUnit
+
+// test unit for the cached dispatch engine : self-modifying code and remapped code must run like with the switch engine
+class Q : public testUnit {
+	public:
+		void test() {
+			std::cout << "test Q started" << std::endl;
+			// each pass patches the immediate operand of the lda run by the next pass
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldx_im, 0x05,			// 2000 : ldx #5
+				m6502::CPU::ins_lda_im, 0x00,			// 2002 : lda #0 (operand patched)
+				m6502::CPU::ins_sta_zpx, 0x40,			// 2004 : sta $40,x
+				m6502::CPU::ins_dex,					// 2006 : dex
+				m6502::CPU::ins_stx_abs, 0x03, 0x20,	// 2007 : stx $2003
+				m6502::CPU::ins_bne, 0xF6,				// 200A : bne $2002
+				m6502::CPU::ins_jmp_abs, 0x0C, 0x20		// 200C : jmp $200C
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			RESULT cached = run<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image);
+			assert(mem.at(0x45) == 0 && mem.at(0x44) == 4 && mem.at(0x43) == 3 && mem.at(0x42) == 2 && mem.at(0x41) == 1);
+			assert((cached == run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image)));
+			std::cout << "test Q : first assert passed" << std::endl;
+			RESULT fastCached = run<m6502::FAST_CPU, m6502::CPU::DISPATCH_CACHED>(image);
+			assert((fastCached == run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image)) && fastCached == cached);
+			std::cout << "test Q : second assert passed" << std::endl;
+			// code in a banked window : selecting another bank replaces the decoded instructions
+			m6502::RAM8_MAPPER mapper(2);
+			mem.init(&cycles);
+			mem.fill(constructProgram({m6502::CPU::ins_jmp_abs, 0x00, 0xA0}, {}));
+			mapper.attach(mem, 0x9F);
+			for (int bank = 0; bank < 2; bank++) {
+				mapper.select(bank);
+				std::vector<m6502::BYTE> code = {m6502::CPU::ins_lda_im, (m6502::BYTE)(0x11 * (bank + 1)), m6502::CPU::ins_jmp_abs, 0x02, 0xA0};
+				for (int i = 0; i < 5; i++) {
+					mem.writeAt(0xA000 + i, code[i]);
+				}
+			}
+			m6502::CPU cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			// runs every pass of the jmp loop through the cache
+			cpu.idleLoop.enabled = false;
+			for (int bank = 0; bank < 2; bank++) {
+				mapper.select(bank);
+				cycles = 7;
+				cpu.reset(cycles, mem);
+				cycles = 100;
+				cpu.executeWith<m6502::CPU::DISPATCH_CACHED>(cycles, mem);
+				assert(cpu.reg_acc == 0x11 * (bank + 1));
+			}
+			assert(cpu.decodeCache.hits > cpu.decodeCache.misses);
+			std::cout << "test Q completed" << std::endl;
+		}
+	private:
+		struct RESULT {
+			m6502::BYTE acc, x, memory[5];
+			m6502::WORD programCounter;
+			uint64_t cycles;
+
+			bool operator==(const RESULT &other) const {
+				return acc == other.acc && x == other.x && std::equal(memory, memory + 5, other.memory) && programCounter == other.programCounter && cycles == other.cycles;
+			}
+		}; // struct RESULT
+
+		template <class CPU_TYPE, int DISPATCH>
+		RESULT run(const std::vector<m6502::BYTE> &image) {
+			mem.init(&cycles);
+			mem.fill(image);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = 200;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			if (DISPATCH == m6502::CPU::DISPATCH_CACHED) {
+				assert(cpu.decodeCache.invalidations >= 5 && cpu.decodeCache.hits > 0);
+			}
+			RESULT result = {cpu.reg_acc, cpu.reg_x, {}, cpu.reg_programCounter, cpu.stats.cycles};
+			for (int i = 0; i < 5; i++) {
+				result.memory[i] = mem.at(0x41 + i);
+			}
+			return result;
+		}
+}; // class Q : public testUnit
+
+// test unit for the block compiler : every run must end in the same state as the interpreter, on the same cycle
+class R : public testUnit {
+	public:
+		void test() {
+			std::cout << "test R started" << std::endl;
+			// an inner loop with page-crossing indexed accesses, and an outer loop patching the eor operand of the inner one
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldy_im, 0x00,			// 2000 : ldy #0
+				m6502::CPU::ins_ldx_im, 0x20,			// 2002 : ldx #$20
+				m6502::CPU::ins_lda_absy, 0xF0, 0x30,	// 2004 : lda $30F0,y
+				m6502::CPU::ins_eor_im, 0x5A,			// 2007 : eor #$5A (operand patched)
+				m6502::CPU::ins_sta_absy, 0x00, 0x40,	// 2009 : sta $4000,y
+				m6502::CPU::ins_iny,					// 200C : iny
+				m6502::CPU::ins_dex,					// 200D : dex
+				m6502::CPU::ins_bne, 0xF4,				// 200E : bne $2004
+				m6502::CPU::ins_sty_abs, 0x08, 0x20,	// 2010 : sty $2008
+				m6502::CPU::ins_jmp_abs, 0x02, 0x20		// 2013 : jmp $2002
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			for (int i = 0; i < 0x200; i++) {
+				image[0x30F0 + i] = i * 7;
+			}
+			m6502::JIT jit;
+			m6502::FAST_JIT fastJit;
+			for (uint32_t budget : {10u, 1000u, 4321u, 100000u}) {
+				assert((run<m6502::CPU>(image, budget, nullptr) == run<m6502::CPU>(image, budget, &jit)));
+				assert((run<m6502::FAST_CPU>(image, budget, nullptr) == run<m6502::FAST_CPU>(image, budget, &fastJit)));
+			}
+			assert(jit.compiledBlocks > 0 && jit.droppedBlocks > 0 && jit.nativeInstructions > 0);
+			std::cout << "test R : first assert passed" << std::endl;
+			// without the patch (sty $50), the loops stay compiled and most instructions run natively
+			image[0x2011] = 0x50;
+			image[0x2012] = 0x00;
+			m6502::FAST_JIT stableJit;
+			assert((run<m6502::FAST_CPU>(image, 100000, nullptr) == run<m6502::FAST_CPU>(image, 100000, &stableJit)));
+			assert(stableJit.droppedBlocks == 0 && stableJit.nativeInstructions > stableJit.interpretedInstructions);
+			// switched off, the compiler only interprets
+			fastJit.enabled = false;
+			uint64_t blockRuns = fastJit.blockRuns;
+			assert((run<m6502::FAST_CPU>(image, 5000, nullptr) == run<m6502::FAST_CPU>(image, 5000, &fastJit)));
+			assert(fastJit.blockRuns == blockRuns);
+			std::cout << "test R completed" << std::endl;
+		}
+	private:
+		struct RESULT {
+			m6502::BYTE acc, x, y, flags;
+			m6502::WORD programCounter;
+			uint64_t cycles, instructions;
+			std::vector<m6502::BYTE> memory;
+
+			bool operator==(const RESULT &other) const {
+				return acc == other.acc && x == other.x && y == other.y && flags == other.flags && programCounter == other.programCounter && cycles == other.cycles
+					&& instructions == other.instructions && memory == other.memory;
+			}
+		}; // struct RESULT
+
+		// runs image for budget cycles on the interpreter (jit == nullptr) or through jit
+		template <class CPU_TYPE>
+		RESULT run(const std::vector<m6502::BYTE> &image, uint32_t budget, m6502::JIT_T<CPU_TYPE> *jit) {
+			mem.init(&cycles);
+			mem.fill(image);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = budget;
+			if (jit != nullptr) {
+				jit->execute(cpu, cycles, mem);
+			} else {
+				cpu.execute(cycles, mem);
+			}
+			RESULT result = {cpu.reg_acc, cpu.reg_x, cpu.reg_y, (m6502::BYTE)(cpu.fl_carry | cpu.fl_zero << 1 | cpu.fl_neg << 7), cpu.reg_programCounter, cpu.stats.cycles, cpu.stats.instructions, {}};
+			for (uint32_t address = 0x4000; address < 0x4200; address++) {
+				result.memory.push_back(mem.readAt(address));
+			}
+			result.memory.push_back(mem.readAt(0x2008));
+			return result;
+		}
+}; // class R : public testUnit
+
+// test unit for idle loop skipping : a run skipping passes must end in the same state, on the same cycle, as one running every pass
+class S : public testUnit {
+	public:
+		void test() {
+			std::cout << "test S started" << std::endl;
+			std::vector<std::vector<m6502::BYTE>> idle = {
+				{m6502::CPU::ins_jmp_abs, 0x00, 0x20},										// 2000 : jmp $2000
+				{m6502::CPU::ins_lda_zp, 0x10, m6502::CPU::ins_and_im, 0x80, m6502::CPU::ins_beq, 0xFA},	// 2000 : lda $10, and #$80, beq $2000
+				{m6502::CPU::ins_ldx_im, 0x03, m6502::CPU::ins_lda_absx, 0xFE, 0x30, m6502::CPU::ins_cmp_im, 0x7F, m6502::CPU::ins_bne, 0xF9}	// 2000 : ldx #3, lda $30FE,x, cmp #$7F, bne $2002
+			};
+			for (const std::vector<m6502::BYTE> &program : idle) {
+				std::vector<m6502::BYTE> image = constructProgram(program, {});
+				image[0x10] = 0x00;
+				image[0x3101] = 0x00;
+				for (uint32_t budget : {40u, 1001u, 123457u, 5000000u}) {
+					assert((run<m6502::CPU>(image, budget, false) == run<m6502::CPU>(image, budget, true)));
+					assert((run<m6502::FAST_CPU>(image, budget, false) == run<m6502::FAST_CPU>(image, budget, true)));
+				}
+				assert(skips > 0 && skippedInstructions > 5000000 / 10);
+			}
+			std::cout << "test S : first assert passed" << std::endl;
+			// a loop writing memory, and one polling a device, run every pass
+			std::vector<std::vector<m6502::BYTE>> busy = {
+				{m6502::CPU::ins_inc_zp, 0x10, m6502::CPU::ins_jmp_abs, 0x00, 0x20},		// 2000 : inc $10, jmp $2000
+				{m6502::CPU::ins_lda_abs, 0x00, 0xD0, m6502::CPU::ins_beq, 0xFB}			// 2000 : lda $D000, beq $2000
+			};
+			for (const std::vector<m6502::BYTE> &program : busy) {
+				std::vector<m6502::BYTE> image = constructProgram(program, {});
+				assert((run<m6502::CPU>(image, 100000, false) == run<m6502::CPU>(image, 100000, true)));
+				assert(skips == 0);
+				assert((run<m6502::FAST_CPU>(image, 100000, false) == run<m6502::FAST_CPU>(image, 100000, true)));
+				assert(skips == 0);
+			}
+			std::cout << "test S completed" << std::endl;
+		}
+	private:
+		// device reading 0 and counting its reads
+		struct ZERO_DEVICE : public m6502::DEVICE {
+			m6502::BYTE read(m6502::WORD) {
+				reads++;
+				return 0;
+			}
+
+			void write(m6502::WORD, m6502::BYTE) {}
+
+			uint64_t reads = 0;
+		}; // struct ZERO_DEVICE : public m6502::DEVICE
+
+		struct RESULT {
+			m6502::BYTE acc, x, y, flags;
+			m6502::WORD programCounter;
+			uint64_t cycles, instructions, clock, reads;
+
+			bool operator==(const RESULT &other) const {
+				return acc == other.acc && x == other.x && y == other.y && flags == other.flags && programCounter == other.programCounter && cycles == other.cycles
+					&& instructions == other.instructions && clock == other.clock && reads == other.reads;
+			}
+		}; // struct RESULT
+
+		// runs image for budget cycles with a ZERO_DEVICE on page 0xD0, skipping idle passes or not
+		template <class CPU_TYPE>
+		RESULT run(const std::vector<m6502::BYTE> &image, uint32_t budget, bool skip) {
+			ZERO_DEVICE device;
+			mem.init(&cycles);
+			mem.fill(image);
+			mem.mapDevice(0xD0, 0xD0, &device);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cpu.idleLoop.enabled = skip;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = budget;
+			cpu.execute(cycles, mem);
+			if (skip) {
+				skips = cpu.idleLoop.skips;
+				skippedInstructions = cpu.idleLoop.skippedInstructions;
+			}
+			return {cpu.reg_acc, cpu.reg_x, cpu.reg_y, (m6502::BYTE)(cpu.fl_carry | cpu.fl_zero << 1 | cpu.fl_neg << 7), cpu.reg_programCounter, cpu.stats.cycles,
+				cpu.stats.instructions, cpu.cycleClock, device.reads};
+		}
+
+		uint64_t skips = 0;					// counters of the last skipping run
+		uint64_t skippedInstructions = 0;
+}; // class S : public testUnit
+
+// test unit for the event scheduler : timer interrupts, NMI edges, interrupts held while masked, event order and cancellation
+class T : public testUnit {
+	public:
+		void test() {
+			std::cout << "test T started" << std::endl;
+			// cli, then an idle loop interrupted every 1000 cycles. The IRQ handler acknowledges the timer and counts in X
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_cli,					// 2000 : cli
+				m6502::CPU::ins_jmp_abs, 0x01, 0x20		// 2001 : jmp $2001
+			};
+			std::vector<m6502::BYTE> image = withHandlers(constructProgram(program, {}));
+			RESULT reference = run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, false);
+			assert(reference.x == 100 && reference.interrupts == 100 && reference.programCounter == 0x2001);
+			assert((reference == run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, true)));
+			assert(skips > 0);
+			assert((reference == run<m6502::CPU, m6502::CPU::DISPATCH_THREADED>(image, 100500, true)));
+			assert((reference == run<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image, 100500, true)));
+			assert((reference == run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, true)));
+			assert((reference == run<m6502::FAST_CPU, m6502::CPU::DISPATCH_TABLE>(image, 100500, false)));
+			std::cout << "test T : first assert passed" << std::endl;
+			// with the interrupt flag set, the timer is ignored but both NMI edges are taken (counted in Y)
+			image[0x2000] = m6502::CPU::ins_sei;
+			nmiEdges = true;
+			RESULT masked = run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 20000, true);
+			nmiEdges = false;
+			assert(masked.x == 0 && masked.y == 2 && masked.interrupts == 2);
+			std::cout << "test T : second assert passed" << std::endl;
+			// IRQ held while masked is taken right after cli : the loop polls $10, which an event sets along with the line
+			program = {
+				m6502::CPU::ins_sei,					// 2000 : sei
+				m6502::CPU::ins_lda_zp, 0x10,			// 2001 : lda $10
+				m6502::CPU::ins_beq, 0xFC,				// 2003 : beq $2001
+				m6502::CPU::ins_cli,					// 2005 : cli
+				m6502::CPU::ins_jmp_abs, 0x06, 0x20		// 2006 : jmp $2006
+			};
+			image = withHandlers(constructProgram(program, {}));
+			image[0x10] = 0x00;
+			pollFlag = true;
+			RESULT late = run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image, 3500, true);
+			pollFlag = false;
+			assert(late.x == 1 && late.interrupts == 1 && acknowledged > 3000 && acknowledged < 3000 + 30);
+			// same time events fire in scheduling order, cancelled ones never
+			m6502::SCHEDULER scheduler;
+			std::vector<int> order;
+			RECORDER first(order, 1), second(order, 2), third(order, 3);
+			scheduler.schedule(50, &third);
+			scheduler.schedule(10, &first);
+			m6502::SCHEDULER::EVENT_ID cancelled = scheduler.schedule(10, &third);
+			scheduler.schedule(10, &second);
+			assert(scheduler.cancel(cancelled) && !scheduler.cancel(cancelled));
+			assert(scheduler.nextTime() == 10 && scheduler.runDue(49) == 2 && scheduler.nextTime() == 50);
+			assert(scheduler.runDue(50) == 1 && scheduler.nextTime() == m6502::SCHEDULER::NEVER);
+			assert((order == std::vector<int>{1, 2, 3}));
+			std::cout << "test T completed" << std::endl;
+		}
+	private:
+		// raises IRQ every 1000 cycles (from 1000). With nmiEdges, also pulses NMI at 5000 and 6000, with pollFlag, sets 0x10 at 3000
+		struct TIMER : public m6502::EVENT_HANDLER {
+			TIMER(T &nOwner) : owner(nOwner) {}
+
+			void fire(uint64_t time) {
+				owner.scheduler.irq(0, true);
+				owner.scheduler.schedule(time + 1000, this);
+				if (owner.nmiEdges && (time == 5000 || time == 6000)) {
+					// the line is only released at the second edge : a held line is taken once
+					owner.scheduler.nmi(1, false);
+					owner.scheduler.nmi(1, true);
+				}
+				if (owner.pollFlag && time == 3000) {
+					owner.mem.writeAt(0x10, 0x01);
+				}
+			}
+
+			T &owner;
+		}; // struct TIMER : public m6502::EVENT_HANDLER
+
+		// timer acknowledge register : reading it releases IRQ
+		struct ACK_PORT : public m6502::DEVICE {
+			ACK_PORT(T &nOwner) : owner(nOwner) {}
+
+			m6502::BYTE read(m6502::WORD) {
+				owner.scheduler.irq(0, false);
+				owner.acknowledged = owner.scheduler.now();
+				return 0;
+			}
+
+			void write(m6502::WORD, m6502::BYTE) {}
+
+			T &owner;
+		}; // struct ACK_PORT : public m6502::DEVICE
+
+		// appends its number to order when fired
+		struct RECORDER : public m6502::EVENT_HANDLER {
+			RECORDER(std::vector<int> &nOrder, int nNumber) : order(nOrder), number(nNumber) {}
+
+			void fire(uint64_t) {
+				order.push_back(number);
+			}
+
+			std::vector<int> &order;
+			int number;
+		}; // struct RECORDER : public m6502::EVENT_HANDLER
+
+		struct RESULT {
+			m6502::BYTE x, y;
+			m6502::WORD programCounter;
+			uint64_t cycles, clock, interrupts;
+
+			bool operator==(const RESULT &other) const {
+				return x == other.x && y == other.y && programCounter == other.programCounter && cycles == other.cycles && clock == other.clock && interrupts == other.interrupts;
+			}
+		}; // struct RESULT
+
+		// adds the IRQ handler at 0x2100 (ldy $D000, inx, rti) and the NMI handler at 0x2200 (iny, rti) to image
+		static std::vector<m6502::BYTE> withHandlers(std::vector<m6502::BYTE> image) {
+			std::vector<m6502::BYTE> irq = {m6502::CPU::ins_lda_abs, 0x00, 0xD0, m6502::CPU::ins_inx, m6502::CPU::ins_rti};
+			std::copy(irq.begin(), irq.end(), image.begin() + 0x2100);
+			image[0x2200] = m6502::CPU::ins_iny;
+			image[0x2201] = m6502::CPU::ins_rti;
+			image[0xFFFA] = 0x00;
+			image[0xFFFB] = 0x22;
+			image[0xFFFE] = 0x00;
+			image[0xFFFF] = 0x21;
+			return image;
+		}
+
+		// runs image for budget cycles with the timer and the acknowledge port on page 0xD0
+		template <class CPU_TYPE, int DISPATCH>
+		RESULT run(const std::vector<m6502::BYTE> &image, uint32_t budget, bool skip) {
+			scheduler = m6502::SCHEDULER();
+			TIMER timer(*this);
+			ACK_PORT port(*this);
+			mem.init(&cycles);
+			mem.fill(image);
+			mem.mapDevice(0xD0, 0xD0, &port);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cpu.idleLoop.enabled = skip;
+			cpu.scheduler = &scheduler;
+			scheduler.schedule(1000, &timer);
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = budget;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			if (skip) {
+				skips = cpu.idleLoop.skips;
+			}
+			return {cpu.reg_x, cpu.reg_y, cpu.reg_programCounter, cpu.stats.cycles, cpu.cycleClock, cpu.interrupts};
+		}
+
+		m6502::SCHEDULER scheduler;
+		bool nmiEdges = false;			// TIMER pulses NMI
+		bool pollFlag = false;			// TIMER sets 0x10 at 3000
+		uint64_t acknowledged = 0;		// time of the last read of ACK_PORT
+		uint64_t skips = 0;				// idle loop skips of the last skipping run
+}; // class T : public testUnit
+
+// test unit for the VIA timers : counters computed from the time, underflow events and interrupts, and a guest driven by timer 1
+class U : public testUnit {
+	public:
+		void test() {
+			std::cout << "test U started" << std::endl;
+			// time is driven by runDue (no CPU) : timer 1 loaded with 100 at time 0 underflows at 101
+			m6502::SCHEDULER scheduler;
+			m6502::VIA via(&scheduler);
+			via.write(m6502::VIA::IER, m6502::VIA::INT_ANY | m6502::VIA::INT_T1);
+			via.write(m6502::VIA::T1C_L, 100);
+			via.write(m6502::VIA::T1C_H, 0);
+			scheduler.runDue(50);
+			assert(via.counter1() == 50 && via.underflows == 0 && !scheduler.irqAsserted());
+			scheduler.runDue(101);
+			assert(via.counter1() == 0xFFFF && via.underflows == 1 && scheduler.irqAsserted());
+			assert(via.read(m6502::VIA::IFR) == (m6502::VIA::INT_ANY | m6502::VIA::INT_T1));
+			// one-shot : no other underflow, reading the low counter acknowledges
+			scheduler.runDue(1000);
+			assert(via.underflows == 1 && via.counter1() == (m6502::WORD)(100 - 1000));
+			via.read(m6502::VIA::T1C_L);
+			assert(!scheduler.irqAsserted() && via.read(m6502::VIA::IFR) == 0);
+			std::cout << "test U : first assert passed" << std::endl;
+			// free-running : reloads the latch the cycle after each underflow (a period of latch + 2), reads between events are exact
+			via.write(m6502::VIA::ACR, m6502::VIA::ACR_T1_FREE_RUN);
+			via.write(m6502::VIA::T1C_H, 0);
+			assert(scheduler.nextTime() == 1101);
+			scheduler.runDue(1101);
+			assert(via.counter1() == 0xFFFF);
+			scheduler.runDue(1102);
+			assert(via.counter1() == 100);
+			scheduler.runDue(1102 + 102 * 3 + 7);
+			assert(via.underflows == 5 && via.counter1() == 100 - 7);
+			// timer 2 runs on its own, a new load cancels the pending underflow
+			via.write(m6502::VIA::T2C_L, 0x34);
+			via.write(m6502::VIA::T2C_H, 0x12);
+			scheduler.runDue(1102 + 102 * 3 + 7 + 0x1000);
+			assert(via.counter2() == 0x0234);
+			via.write(m6502::VIA::T2C_H, 0x12);
+			scheduler.runDue(1102 + 102 * 3 + 7 + 0x1235);
+			assert(!(via.read(m6502::VIA::IFR) & m6502::VIA::INT_T2));
+			scheduler.runDue(1102 + 102 * 3 + 7 + 0x1000 + 0x1235);
+			assert(via.read(m6502::VIA::IFR) & m6502::VIA::INT_T2);
+			std::cout << "test U : second assert passed" << std::endl;
+			// a counter read 4 cycles after the load, with both timings
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_lda_im, 0x10,			// 2000 : lda #$10
+				m6502::CPU::ins_sta_abs, 0x09, 0xD0,	// 2002 : sta $D009
+				m6502::CPU::ins_lda_abs, 0x08, 0xD0,	// 2005 : lda $D008
+				m6502::CPU::ins_jmp_abs, 0x08, 0x20		// 2008 : jmp $2008
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			assert((run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100, true).acc == 0xFC));
+			assert((run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100, true).acc == 0xFC));
+			// timer 1 free-running every 1000 cycles, acknowledged by the IRQ handler, which counts in X
+			program = {
+				m6502::CPU::ins_lda_im, 0x40,			// 2000 : lda #$40
+				m6502::CPU::ins_sta_abs, 0x0B, 0xD0,	// 2002 : sta $D00B
+				m6502::CPU::ins_lda_im, 0xE6,			// 2005 : lda #$E6
+				m6502::CPU::ins_sta_abs, 0x04, 0xD0,	// 2007 : sta $D004
+				m6502::CPU::ins_lda_im, 0x03,			// 200A : lda #$03
+				m6502::CPU::ins_sta_abs, 0x05, 0xD0,	// 200C : sta $D005
+				m6502::CPU::ins_lda_im, 0xC0,			// 200F : lda #$C0
+				m6502::CPU::ins_sta_abs, 0x0E, 0xD0,	// 2011 : sta $D00E
+				m6502::CPU::ins_cli,					// 2014 : cli
+				m6502::CPU::ins_jmp_abs, 0x15, 0x20		// 2015 : jmp $2015
+			};
+			image = constructProgram(program, {});
+			std::vector<m6502::BYTE> irq = {m6502::CPU::ins_lda_abs, 0x04, 0xD0, m6502::CPU::ins_inx, m6502::CPU::ins_rti};
+			std::copy(irq.begin(), irq.end(), image.begin() + 0x2100);
+			image[0xFFFE] = 0x00;
+			image[0xFFFF] = 0x21;
+			RESULT exact = run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, false);
+			assert(exact.x == 100 && exact.underflows == 100 && exact.programCounter == 0x2015);
+			assert((exact == run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, true)));
+			assert((exact == run<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image, 100500, true)));
+			RESULT fast = run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100500, false);
+			assert(fast.x == 100 && fast.underflows == 100 && fast.programCounter == 0x2015);
+			assert((fast == run<m6502::FAST_CPU, m6502::CPU::DISPATCH_THREADED>(image, 100500, true)));
+			std::cout << "test U completed" << std::endl;
+		}
+	private:
+		struct RESULT {
+			m6502::BYTE acc, x;
+			m6502::WORD programCounter;
+			uint64_t cycles, clock, underflows;
+
+			bool operator==(const RESULT &other) const {
+				return acc == other.acc && x == other.x && programCounter == other.programCounter && cycles == other.cycles && clock == other.clock
+					&& underflows == other.underflows;
+			}
+		}; // struct RESULT
+
+		// runs image for budget cycles with a VIA on page 0xD0
+		template <class CPU_TYPE, int DISPATCH>
+		RESULT run(const std::vector<m6502::BYTE> &image, uint32_t budget, bool skip) {
+			m6502::SCHEDULER scheduler;
+			m6502::VIA via(&scheduler);
+			mem.init(&cycles);
+			mem.fill(image);
+			via.attach(mem, 0xD0);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cpu.idleLoop.enabled = skip;
+			cpu.scheduler = &scheduler;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cycles = budget;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			return {cpu.reg_acc, cpu.reg_x, cpu.reg_programCounter, cpu.stats.cycles, cpu.cycleClock, via.underflows};
+		}
+}; // class U : public testUnit
+
+// test unit for the loaders : raw bytes and segments at their origin, Intel HEX and segmented binaries (from memory and from files), rejected images
+class V : public testUnit {
+	public:
+		void test() {
+			std::cout << "test V started" << std::endl;
+			// only the bytes present are written, and only their pages are marked as written
+			mem.save();
+			std::array<m6502::BYTE, 3> raw = {0x11, 0x22, 0x33};
+			std::vector<m6502::BYTE> tail = {0x44, 0x55, 0x66, 0x77};
+			m6502::loadRaw(mem, 0x12FF, raw);
+			m6502::loadSegments(mem, {{0x4000, tail}, {0xFFFE, tail}});
+			assert(mem.readAt(0x12FE) == 0x00 && mem.readAt(0x12FF) == 0x11 && mem.readAt(0x1301) == 0x33 && mem.readAt(0x1302) == 0x00);
+			assert(mem.readAt(0x4003) == 0x77 && mem.readAt(0xFFFE) == 0x44 && mem.readAt(0xFFFF) == 0x55 && mem.readAt(0x0000) == 0x00);
+			assert(mem.dirtyPages() == 4);
+			std::cout << "test V : first assert passed" << std::endl;
+			// Intel HEX : data records, an extended segment address inside 64 KiB, a start address, lower case digits
+			std::string hex =
+				":0300300002337A1E\r\n"
+				":020000020100FB\n"
+				":02000000abcd86\n"
+				":04000003000020F0E9\n"
+				":00000001FF\n";
+			m6502::WORD entry = 0;
+			assert(m6502::loadHex(mem, bytes(hex), &entry));
+			assert(mem.readAt(0x0030) == 0x02 && mem.readAt(0x0031) == 0x33 && mem.readAt(0x0032) == 0x7A);
+			assert(mem.readAt(0x1000) == 0xAB && mem.readAt(0x1001) == 0xCD && entry == 0x20F0);
+			// a bad checksum on the last record, or data past 0xFFFF, writes nothing
+			std::string bad = ":015000009916\n:0150010099FF\n";
+			assert(!m6502::loadHex(mem, bytes(bad)) && mem.readAt(0x5000) == 0x00);
+			assert(!m6502::loadHex(mem, bytes(std::string(":02FFFF00AABB9B\n"))));
+			// segmented binary : marker, two blocks, then a block cut short
+			std::vector<m6502::BYTE> segmented = {0xFF, 0xFF, 0x00, 0x60, 0x01, 0x60, 0xA9, 0x01, 0x00, 0x70, 0x00, 0x70, 0x60};
+			assert(m6502::loadSegmented(mem, segmented));
+			assert(mem.readAt(0x6000) == 0xA9 && mem.readAt(0x6001) == 0x01 && mem.readAt(0x7000) == 0x60);
+			segmented.insert(segmented.end(), {0x00, 0x71, 0x10, 0x71, 0xEA});
+			assert(!m6502::loadSegmented(mem, segmented) && mem.readAt(0x7100) == 0x00);
+			std::cout << "test V : second assert passed" << std::endl;
+			// the same from files, loaded through a mapping
+			const char *path = "testUnitV.bin";
+			write(path, tail);
+			assert(m6502::loadRawFile(mem, path, 0x8000));
+			assert(mem.readAt(0x8000) == 0x44 && mem.readAt(0x8003) == 0x77 && mem.readAt(0x8004) == 0x00);
+			write(path, std::vector<m6502::BYTE>(hex.begin(), hex.end()));
+			entry = 0;
+			assert(m6502::loadHexFile(mem, path, &entry) && entry == 0x20F0);
+			std::remove(path);
+			assert(!m6502::loadRawFile(mem, path, 0x8000) && !m6502::loadHexFile(mem, path));
+			// a program loaded without a 64 KiB image runs like one built by constructProgram
+			m6502::MEMORY loaded;
+			uint32_t loadedCycles = 0;
+			loaded.init(&loadedCycles);
+			std::vector<m6502::BYTE> program = {m6502::CPU::ins_lda_im, 0x42, m6502::CPU::ins_sta_zp, 0x10};
+			std::vector<m6502::BYTE> resetVector = {0x00, 0x20};
+			m6502::loadSegments(loaded, {{0x2000, program}, {0xFFFC, resetVector}});
+			m6502::CPU loadedCpu;
+			loadedCycles = 7;
+			loadedCpu.reset(loadedCycles, loaded);
+			loadedCycles = 5;
+			loadedCpu.execute(loadedCycles, loaded);
+			assert(loaded.readAt(0x10) == 0x42);
+			std::cout << "test V completed" << std::endl;
+		}
+	private:
+		static m6502::BYTE_SPAN bytes(const std::string &text) {
+			return m6502::BYTE_SPAN((const m6502::BYTE *)text.data(), text.size());
+		}
+
+		static void write(const char *path, const std::vector<m6502::BYTE> &content) {
+			std::ofstream out(path, std::ios::binary);
+			out.write((const char *)content.data(), content.size());
+		}
+}; // class V : public testUnit
+
+// test unit for the disassembler : every addressing mode, listings from memory, and instruction traces recorded by every engine
+class W : public testUnit {
+	public:
+		void test() {
+			std::cout << "test W started" << std::endl;
+			std::vector<std::pair<std::vector<m6502::BYTE>, std::string>> cases = {
+				{{m6502::CPU::ins_lda_im, 0x42}, "lda #$42"},
+				{{m6502::CPU::ins_sta_zpx, 0x10}, "sta $10,x"},
+				{{m6502::CPU::ins_ldx_zpy, 0x10}, "ldx $10,y"},
+				{{m6502::CPU::ins_jsr_abs, 0x34, 0x12}, "jsr $1234"},
+				{{m6502::CPU::ins_lda_absx, 0x34, 0x12}, "lda $1234,x"},
+				{{m6502::CPU::ins_sta_absy, 0x34, 0x12}, "sta $1234,y"},
+				{{m6502::CPU::ins_jmp_ind, 0xFE, 0x30}, "jmp ($30fe)"},
+				{{m6502::CPU::ins_lda_indx, 0x10}, "lda ($10,x)"},
+				{{m6502::CPU::ins_sta_indy, 0x10}, "sta ($10),y"},
+				{{m6502::CPU::ins_asl_acc}, "asl a"},
+				{{m6502::CPU::ins_inx}, "inx"},
+				{{m6502::CPU::ins_bne, 0xFB}, "bne $1ffd"},
+				{{m6502::CPU::ins_bcs, 0x05}, "bcs $2007"},
+				{{0x02}, ".byte $02"}
+			};
+			for (auto &testCase : cases) {
+				testCase.first.resize(3);
+				assert(m6502::DISASSEMBLER::format(0x2000, testCase.first.data()) == testCase.second);
+			}
+			for (int opcode = 0; opcode < 256; opcode++) {
+				m6502::BYTE length = m6502::DISASSEMBLER::length(opcode);
+				assert(length >= 1 && length <= 3);
+			}
+			assert(m6502::DISASSEMBLER::length(m6502::CPU::ins_lda_abs) == 3 && m6502::DISASSEMBLER::length(m6502::CPU::ins_ldx_zpy) == 2);
+			std::cout << "test W : first assert passed" << std::endl;
+			// listing from memory, device pages are not read
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldx_im, 0x00,			// 2000 : ldx #0
+				m6502::CPU::ins_inx,					// 2002 : inx
+				m6502::CPU::ins_cpx_im, 0x03,			// 2003 : cpx #3
+				m6502::CPU::ins_bne, 0xFB,				// 2005 : bne $2002
+				m6502::CPU::ins_stx_abs, 0x00, 0x40,	// 2007 : stx $4000
+				m6502::CPU::ins_jmp_abs, 0x0A, 0x20		// 200A : jmp $200A
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			mem.init(&cycles);
+			mem.fill(image);
+			std::ostringstream listing;
+			m6502::DISASSEMBLER::list(listing, mem, 0x2000, 3);
+			assert(listing.str() == "2000  a2 00     ldx #$00\n2002  e8        inx\n2003  e0 03     cpx #$03\n");
+			RECORDING_DEVICE device;
+			mem.mapDevice(0xD0, 0xD0, &device);
+			assert(m6502::DISASSEMBLER::format(mem, 0xD000) == "???" && device.reads == 0);
+			std::cout << "test W : second assert passed" << std::endl;
+			// instruction traces : the same records from every engine and both timings, and the bus trace passed through unchanged
+			std::vector<m6502::INSTRUCTION_RECORD> reference = trace<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image);
+			assert(reference.size() > 11 && reference[0].address == 0x2000 && reference[0].text() == "ldx #$00");
+			assert(reference[3].text() == "bne $2002" && reference[10].text() == "stx $4000" && reference[11].text() == "jmp $200a");
+			assert(reference[11].cycle - reference[10].cycle == 4);
+			assert(same(reference, trace<m6502::CPU, m6502::CPU::DISPATCH_TABLE>(image), true));
+			assert(same(reference, trace<m6502::CPU, m6502::CPU::DISPATCH_THREADED>(image), true));
+			assert(same(reference, trace<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image), true));
+			assert(same(reference, trace<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image), false));
+			assert(same(reference, trace<m6502::FAST_CPU, m6502::CPU::DISPATCH_CACHED>(image), false));
+			// a small ring keeps the last instructions
+			m6502::INSTRUCTION_TRACE_SINK last(nullptr, 4);
+			for (const m6502::INSTRUCTION_RECORD &record : reference) {
+				last.instruction(record.cycle, record.address);
+				for (m6502::BYTE i = 0; i < record.fetched; i++) {
+					last.access(record.cycle + i, record.address + i, true, record.bytes[i]);
+				}
+			}
+			assert(last.size() == 4 && last.total == reference.size() && last[3].text() == reference.back().text() && last[0].cycle == reference[reference.size() - 4].cycle);
+			std::cout << "test W completed" << std::endl;
+		}
+	private:
+		// device counting its reads
+		struct RECORDING_DEVICE : public m6502::DEVICE {
+			m6502::BYTE read(m6502::WORD) {
+				reads++;
+				return 0;
+			}
+
+			void write(m6502::WORD, m6502::BYTE) {}
+
+			uint64_t reads = 0;
+		}; // struct RECORDING_DEVICE : public m6502::DEVICE
+
+		// counts the accesses passed on by INSTRUCTION_TRACE_SINK
+		struct COUNTING_SINK : public m6502::TRACE_SINK {
+			void access(uint64_t, m6502::WORD, bool, m6502::BYTE) {
+				accesses++;
+			}
+
+			uint64_t accesses = 0;
+		}; // struct COUNTING_SINK : public m6502::TRACE_SINK
+
+		// returns the instructions executed by image in 100 cycles, checking that the bus trace behind the instruction trace sees every access
+		template <class CPU_TYPE, int DISPATCH>
+		std::vector<m6502::INSTRUCTION_RECORD> trace(const std::vector<m6502::BYTE> &image) {
+			COUNTING_SINK bus;
+			m6502::INSTRUCTION_TRACE_SINK instructions(&bus);
+			mem.init(&cycles);
+			mem.fill(image);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cpu.traceSink = &instructions;
+			cycles = 100;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			std::vector<m6502::INSTRUCTION_RECORD> records;
+			uint64_t fetches = 0;
+			for (size_t i = 0; i < instructions.size(); i++) {
+				records.push_back(instructions[i]);
+				fetches += instructions[i].fetched;
+			}
+			assert(instructions.total == records.size() && bus.accesses >= fetches && bus.accesses > records.size());
+			return records;
+		}
+
+		// compares two instruction traces (cycles too if withCycles)
+		static bool same(const std::vector<m6502::INSTRUCTION_RECORD> &first, const std::vector<m6502::INSTRUCTION_RECORD> &second, bool withCycles) {
+			if (first.size() != second.size()) {
+				return false;
+			}
+			for (size_t i = 0; i < first.size(); i++) {
+				if (first[i].address != second[i].address || first[i].text() != second[i].text() || (withCycles && first[i].cycle != second[i].cycle)) {
+					return false;
+				}
+			}
+			return true;
+		}
+}; // class W : public testUnit
+
+// test unit for the profiler : cycles per PC adding up to the run, the call tree of nested subroutines, engines agreeing, and interrupt handlers as calls
+class X : public testUnit {
+	public:
+		void test() {
+			std::cout << "test X started" << std::endl;
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_jsr_abs, 0x00, 0x21,	// 2000 : jsr $2100
+				m6502::CPU::ins_jsr_abs, 0x00, 0x22,	// 2003 : jsr $2200
+				m6502::CPU::ins_jmp_abs, 0x00, 0x20		// 2006 : jmp $2000
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			std::vector<m6502::BYTE> outer = {m6502::CPU::ins_jsr_abs, 0x00, 0x22, m6502::CPU::ins_rts};	// 2100 : jsr $2200, rts
+			std::vector<m6502::BYTE> inner = {m6502::CPU::ins_ldy_im, 0x04, m6502::CPU::ins_dey, m6502::CPU::ins_bne, 0xFD, m6502::CPU::ins_rts};	// 2200 : ldy #4, dey, bne $2202, rts
+			std::copy(outer.begin(), outer.end(), image.begin() + 0x2100);
+			std::copy(inner.begin(), inner.end(), image.begin() + 0x2200);
+			m6502::PROFILER profiler;
+			uint64_t ran = run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, 100000, profiler, false);
+			uint64_t total = 0;
+			for (uint64_t count : profiler.cycles) {
+				total += count;
+			}
+			uint64_t passes = profiler.instructions[0x2006];
+			assert(total == ran && passes > 100 && profiler.instructions[0x2202] == 4 * profiler.instructions[0x2200]);
+			assert(profiler.instructions[0x2200] == 2 * passes || profiler.instructions[0x2200] == 2 * passes + 1 || profiler.instructions[0x2200] == 2 * passes + 2);
+			std::cout << "test X : first assert passed" << std::endl;
+			// $2200 is called from $2100 and from the loop : two nodes, one function
+			profiler.symbols[0x2100] = "outer";
+			std::vector<m6502::PROFILER::FUNCTION> functions = profiler.functions();
+			assert(functions.size() == 3 && functions[0].address == 0x2000 && functions[0].inclusive == total);
+			m6502::PROFILER::FUNCTION outerTotals = find(functions, 0x2100), innerTotals = find(functions, 0x2200);
+			assert(innerTotals.calls == profiler.instructions[0x2200] && innerTotals.inclusive == innerTotals.exclusive);
+			assert(outerTotals.inclusive > outerTotals.exclusive && functions[0].exclusive + outerTotals.exclusive + innerTotals.exclusive == total);
+			std::ostringstream folded;
+			profiler.writeFolded(folded);
+			uint64_t foldedTotal = 0;
+			std::istringstream lines(folded.str());
+			std::string stack;
+			uint64_t count;
+			std::vector<std::string> stacks;
+			while (lines >> stack >> count) {
+				stacks.push_back(stack);
+				foldedTotal += count;
+			}
+			std::sort(stacks.begin(), stacks.end());
+			assert(foldedTotal == total && (stacks == std::vector<std::string>{"$2000", "$2000;$2200", "$2000;outer", "$2000;outer;$2200"}));
+			// the same counts from the other engines
+			m6502::PROFILER cached, threaded;
+			run<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image, 100000, cached, false);
+			run<m6502::CPU, m6502::CPU::DISPATCH_THREADED>(image, 100000, threaded, false);
+			assert(cached.instructions == profiler.instructions && cached.cycles == profiler.cycles && threaded.cycles == profiler.cycles);
+			std::cout << "test X : second assert passed" << std::endl;
+			// an interrupt handler ($2300 : lda $D000, rti) is a call from the interrupted function, its sequence counts at no PC
+			std::vector<m6502::BYTE> handler = {m6502::CPU::ins_lda_abs, 0x00, 0xD0, m6502::CPU::ins_rti};
+			std::copy(handler.begin(), handler.end(), image.begin() + 0x2300);
+			image[0xFFFE] = 0x00;
+			image[0xFFFF] = 0x23;
+			image[0x2000] = m6502::CPU::ins_cli;
+			image[0x2001] = m6502::CPU::ins_nop;
+			image[0x2002] = m6502::CPU::ins_nop;
+			m6502::PROFILER interrupted;
+			ran = run<m6502::FAST_CPU, m6502::CPU::DISPATCH_SWITCH>(image, 20000, interrupted, true);
+			total = 0;
+			for (uint64_t cycles : interrupted.cycles) {
+				total += cycles;
+			}
+			functions = interrupted.functions();
+			assert(find(functions, 0x2300).calls == 1 && interrupted.instructions[0x2303] == 1 && total == ran - 7 && functions[0].inclusive == ran);
+			std::cout << "test X completed" << std::endl;
+		}
+	private:
+		// raises IRQ once, released by reading its page
+		struct ONE_IRQ : public m6502::EVENT_HANDLER, public m6502::DEVICE {
+			ONE_IRQ(m6502::SCHEDULER &nScheduler) : scheduler(nScheduler) {}
+
+			void fire(uint64_t) {
+				scheduler.irq(0, true);
+			}
+
+			m6502::BYTE read(m6502::WORD) {
+				scheduler.irq(0, false);
+				return 0;
+			}
+
+			void write(m6502::WORD, m6502::BYTE) {}
+
+			m6502::SCHEDULER &scheduler;
+		}; // struct ONE_IRQ : public m6502::EVENT_HANDLER, public m6502::DEVICE
+
+		static m6502::PROFILER::FUNCTION find(const std::vector<m6502::PROFILER::FUNCTION> &functions, m6502::WORD address) {
+			for (const m6502::PROFILER::FUNCTION &function : functions) {
+				if (function.address == address) {
+					return function;
+				}
+			}
+			return {address, 0, 0, 0};
+		}
+
+		// runs image for budget cycles under profiler, with an IRQ at 5000 if irq. Returns the cycles run
+		template <class CPU_TYPE, int DISPATCH>
+		uint64_t run(const std::vector<m6502::BYTE> &image, uint32_t budget, m6502::PROFILER &profiler, bool irq) {
+			m6502::SCHEDULER scheduler;
+			ONE_IRQ source(scheduler);
+			mem.init(&cycles);
+			mem.fill(image);
+			mem.mapDevice(0xD0, 0xD0, &source);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			if (irq) {
+				scheduler.schedule(5000, &source);
+				cpu.scheduler = &scheduler;
+			}
+			cpu.profiler = &profiler;
+			cycles = budget;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			return cpu.stats.cycles;
+		}
+}; // class X : public testUnit
+
+// test unit for the opcode histogram : exact counts from every engine, and the merge of per-worker counts by the batch runner
+class Y : public testUnit {
+	public:
+		void test() {
+			std::cout << "test Y started" << std::endl;
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_ldx_im, 0x10,			// 2000 : ldx #$10
+				m6502::CPU::ins_ldy_im, 0x20,			// 2002 : ldy #$20
+				m6502::CPU::ins_lda_absx, 0xF8, 0x30,	// 2004 : lda $30F8,x (crosses)
+				m6502::CPU::ins_lda_absx, 0x00, 0x30,	// 2007 : lda $3000,x
+				m6502::CPU::ins_lda_absy, 0xF0, 0x30,	// 200A : lda $30F0,y (crosses)
+				m6502::CPU::ins_lda_indy, 0x40,			// 200D : lda ($40),y (crosses)
+				m6502::CPU::ins_lda_indy, 0x42,			// 200F : lda ($42),y
+				m6502::CPU::ins_sta_absx, 0xF8, 0x30,	// 2011 : sta $30F8,x (a write : not counted)
+				m6502::CPU::ins_dex,					// 2014 : dex
+				m6502::CPU::ins_bne, 0xFD,				// 2015 : bne $2014
+				m6502::CPU::ins_jmp_abs, 0xFC, 0x20		// 2017 : jmp $20FC
+			};
+			std::vector<m6502::BYTE> image = constructProgram(program, {0});
+			image[0x40] = 0xF0;
+			image[0x41] = 0x30;
+			image[0x42] = 0x00;
+			image[0x43] = 0x30;
+			// 20FC : beq $2100 (taken, crosses), 2100 : jmp $2100
+			std::vector<m6502::BYTE> tail = {m6502::CPU::ins_beq, 0x02, m6502::CPU::ins_nop, m6502::CPU::ins_nop, m6502::CPU::ins_jmp_abs, 0x00, 0x21};
+			std::copy(tail.begin(), tail.end(), image.begin() + 0x20FC);
+			m6502::HISTOGRAM counts;
+			run<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(image, counts);
+			assert(counts.opcodes[m6502::CPU::ins_ldx_im] == 1 && counts.opcodes[m6502::CPU::ins_lda_absx] == 2 && counts.opcodes[m6502::CPU::ins_dex] == 16);
+			assert(counts.opcodes[m6502::CPU::ins_bne] == 16 && counts.opcodes[m6502::CPU::ins_beq] == 1 && counts.opcodes[m6502::CPU::ins_jmp_abs] > 100);
+			assert(counts.instructions() == 41 + counts.opcodes[m6502::CPU::ins_jmp_abs] && counts.ranking()[0] == m6502::CPU::ins_jmp_abs);
+			std::cout << "test Y : first assert passed" << std::endl;
+			assert(counts.pageCrosses[m6502::HISTOGRAM::ABSOLUTE_X].reads == 2 && counts.pageCrosses[m6502::HISTOGRAM::ABSOLUTE_X].crosses == 1);
+			assert(counts.pageCrosses[m6502::HISTOGRAM::ABSOLUTE_Y].reads == 1 && counts.pageCrosses[m6502::HISTOGRAM::ABSOLUTE_Y].crosses == 1);
+			assert(counts.pageCrosses[m6502::HISTOGRAM::INDIRECT_Y].reads == 2 && counts.pageCrosses[m6502::HISTOGRAM::INDIRECT_Y].crosses == 1);
+			const m6502::HISTOGRAM::BRANCH &bne = counts.branches[m6502::CPU::ins_bne], &beq = counts.branches[m6502::CPU::ins_beq];
+			assert(bne.taken == 15 && bne.notTaken == 1 && bne.crosses == 0 && beq.taken == 1 && beq.notTaken == 0 && beq.crosses == 1);
+			std::cout << "test Y : second assert passed" << std::endl;
+			// the same counts from the other engines and timing (the jmp loop runs as many times as the budget allows)
+			m6502::HISTOGRAM table, threaded, cached, fast;
+			run<m6502::CPU, m6502::CPU::DISPATCH_TABLE>(image, table);
+			run<m6502::CPU, m6502::CPU::DISPATCH_THREADED>(image, threaded);
+			run<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(image, cached);
+			run<m6502::FAST_CPU, m6502::FAST_CPU::DISPATCH_SWITCH>(image, fast);
+			for (m6502::HISTOGRAM *other : {&table, &threaded, &cached, &fast}) {
+				assert(other->opcodes == counts.opcodes);
+				for (int mode = 0; mode < m6502::HISTOGRAM::INDEXED_MODES; mode++) {
+					assert(other->pageCrosses[mode].reads == counts.pageCrosses[mode].reads && other->pageCrosses[mode].crosses == counts.pageCrosses[mode].crosses);
+				}
+				assert(other->branches[m6502::CPU::ins_bne].taken == 15 && other->branches[m6502::CPU::ins_beq].crosses == 1);
+			}
+			// merging adds every counter
+			table.merge(counts);
+			assert(table.opcodes[m6502::CPU::ins_dex] == 32 && table.pageCrosses[m6502::HISTOGRAM::INDIRECT_Y].crosses == 2 && table.branches[m6502::CPU::ins_bne].notTaken == 2);
+			std::cout << "test Y : third assert passed" << std::endl;
+			// each batch worker counts on its own, the runner merges them
+			image[0x2100] = m6502::CPU::ins_sta_abs;
+			image[0x2101] = 0x00;
+			image[0x2102] = 0xDF;
+			std::shared_ptr<std::vector<m6502::BYTE>> shared = std::make_shared<std::vector<m6502::BYTE>>(image);
+			std::vector<m6502::BATCH_JOB> jobs(20);
+			for (m6502::BATCH_JOB &job : jobs) {
+				job.image = shared;
+			}
+			m6502::BATCH_RUNNER runner(4);
+			runner.countOpcodes = true;
+			runner.run(jobs);
+			assert(runner.histogram.opcodes[m6502::CPU::ins_dex] == 20 * 16 && runner.histogram.opcodes[m6502::CPU::ins_sta_abs] == 20);
+			assert(runner.histogram.pageCrosses[m6502::HISTOGRAM::ABSOLUTE_X].reads == 20 * 2 && runner.histogram.branches[m6502::CPU::ins_beq].crosses == 20);
+			// counts are for the last run only
+			jobs.resize(3);
+			runner.run(jobs);
+			assert(runner.histogram.opcodes[m6502::CPU::ins_dex] == 3 * 16);
+			std::cout << "test Y completed" << std::endl;
+		}
+	private:
+		// runs image for 10000 cycles, counting into histogram
+		template <class CPU_TYPE, int DISPATCH>
+		void run(const std::vector<m6502::BYTE> &image, m6502::HISTOGRAM &histogram) {
+			mem.init(&cycles);
+			mem.fill(image);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cpu.histogram = &histogram;
+			cycles = 10000;
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+		}
+}; // class Y : public testUnit
+
+// test unit for lazy flags : random code must leave the same registers, flags and memory as with eager flags, run after run
+class Z : public testUnit {
+	public:
+		void test() {
+			std::cout << "test Z started" << std::endl;
+			// plp of $C3 sets N and Z together, php pushes them back ($F3)
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_lda_im, 0xC3,			// 2000 : lda #$C3
+				m6502::CPU::ins_pha,					// 2002 : pha
+				m6502::CPU::ins_plp,					// 2003 : plp
+				m6502::CPU::ins_php,					// 2004 : php
+				m6502::CPU::ins_jmp_abs, 0x05, 0x20		// 2005 : jmp $2005
+			};
+			m6502::CPU_T<m6502::EXACT_TIMING, m6502::LAZY_FLAGS> lazy;
+			mem.init(&cycles);
+			mem.fill(constructProgram(program, {}));
+			lazy.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			lazy.reset(cycles, mem);
+			cycles = 20;
+			lazy.execute(cycles, mem);
+			assert(mem[0x01FD] == 0xF3 && lazy.fl_neg && lazy.fl_zero && lazy.fl_carry && lazy.fl_oflow && !lazy.fl_dec);
+			std::cout << "test Z : first assert passed" << std::endl;
+			// flags written by the host between runs are the ones the next run starts from
+			lazy.reg_programCounter = 0x2004;
+			lazy.fl_carry = lazy.fl_zero = lazy.fl_oflow = false;
+			cycles = 3;
+			lazy.execute(cycles, mem);
+			assert(mem[0x01FC] == 0xB0);
+			std::cout << "test Z : second assert passed" << std::endl;
+			std::mt19937 random(6502);
+			for (int image = 0; image < 50; image++) {
+				std::vector<m6502::BYTE> bytes(m6502::MEMORY::MEM_SIZE);
+				for (m6502::BYTE &byte : bytes) {
+					byte = random();
+				}
+				bytes[0xFFFC] = 0x00;
+				bytes[0xFFFD] = 0x20;
+				compare<m6502::EXACT_TIMING>(bytes);
+				compare<m6502::INSTRUCTION_TIMING>(bytes);
+			}
+			std::cout << "test Z completed" << std::endl;
+		}
+	private:
+		// runs image in slices on eager and lazy flags, comparing the machines after each slice
+		template <class TIMING>
+		void compare(const std::vector<m6502::BYTE> &image) {
+			uint32_t eagerCycles = 0, lazyCycles = 0;
+			m6502::MEMORY eagerMem, lazyMem;
+			m6502::CPU_T<TIMING, m6502::EAGER_FLAGS> eager;
+			m6502::CPU_T<TIMING, m6502::LAZY_FLAGS> lazy;
+			eagerMem.init(&eagerCycles);
+			eagerMem.fill(image);
+			lazyMem.init(&lazyCycles);
+			lazyMem.fill(image);
+			eager.throttle.mode = lazy.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			eagerCycles = lazyCycles = 7;
+			eager.reset(eagerCycles, eagerMem);
+			lazy.reset(lazyCycles, lazyMem);
+			for (int slice = 0; slice < 10; slice++) {
+				eagerCycles = lazyCycles = 300;
+				eager.execute(eagerCycles, eagerMem);
+				lazy.execute(lazyCycles, lazyMem);
+				assert(eager.reg_programCounter == lazy.reg_programCounter && eager.reg_acc == lazy.reg_acc && eager.reg_x == lazy.reg_x && eager.reg_y == lazy.reg_y);
+				assert(eager.reg_stackPointer == lazy.reg_stackPointer && eagerCycles == lazyCycles);
+				assert(eager.fl_carry == lazy.fl_carry && eager.fl_zero == lazy.fl_zero && eager.fl_interr == lazy.fl_interr && eager.fl_dec == lazy.fl_dec);
+				assert(eager.fl_oflow == lazy.fl_oflow && eager.fl_neg == lazy.fl_neg);
+				for (uint32_t address = 0; address < m6502::MEMORY::MEM_SIZE; address++) {
+					assert(eagerMem[address] == lazyMem[address]);
+				}
+			}
+		}
+}; // class Z : public testUnit
+
+// test unit for decimal mode : every ADC and SBC (2 x 256 x 256 inputs) against the NMOS algorithm written digit by digit, with eager and lazy flags
+class AA : public testUnit {
+	public:
+		void test() {
+			std::cout << "test AA started" << std::endl;
+			m6502::CPU eager;
+			m6502::CPU_T<m6502::EXACT_TIMING, m6502::LAZY_FLAGS> lazy;
+			// 19 + 28 = 47, 99 + 01 = 00 carry, 00 - 01 = 99 borrow
+			assert(add(eager, false, 0x19, 0x28) == 0x47 && add(eager, false, 0x99, 0x01) == 0x00 && eager.fl_carry && eager.fl_zero == false);
+			assert(subtract(eager, true, 0x00, 0x01) == 0x99 && !eager.fl_carry && subtract(eager, true, 0x50, 0x25) == 0x25 && eager.fl_carry);
+			std::cout << "test AA : first assert passed" << std::endl;
+			for (int carry = 0; carry < 2; carry++) {
+				for (int acc = 0; acc < 0x100; acc++) {
+					for (int operand = 0; operand < 0x100; operand++) {
+						BYTE flags;
+						BYTE result = referenceAdd(carry, acc, operand, flags);
+						assert(add(eager, carry, acc, operand) == result && status(eager) == flags);
+						assert(add(lazy, carry, acc, operand) == result && status(lazy) == flags);
+					}
+				}
+			}
+			std::cout << "test AA : second assert passed" << std::endl;
+			for (int carry = 0; carry < 2; carry++) {
+				for (int acc = 0; acc < 0x100; acc++) {
+					for (int operand = 0; operand < 0x100; operand++) {
+						BYTE flags;
+						BYTE result = referenceSubtract(carry, acc, operand, flags);
+						assert(subtract(eager, carry, acc, operand) == result && status(eager) == flags);
+						assert(subtract(lazy, carry, acc, operand) == result && status(lazy) == flags);
+					}
+				}
+			}
+			std::cout << "test AA completed" << std::endl;
+		}
+	private:
+		typedef m6502::BYTE BYTE;
+
+		// runs ADC #operand in decimal mode with acc and carry, returns the accumulator
+		template <class CPU_TYPE>
+		BYTE add(CPU_TYPE &cpu, bool carry, BYTE acc, BYTE operand) {
+			start(cpu, carry, acc);
+			cpu.template op<m6502::ADC, CPU_TYPE::am_imm>(cycles, mem, operand);
+			cpu.storeLazyFlags();
+			return cpu.reg_acc;
+		}
+
+		template <class CPU_TYPE>
+		BYTE subtract(CPU_TYPE &cpu, bool carry, BYTE acc, BYTE operand) {
+			start(cpu, carry, acc);
+			cpu.template op<m6502::SBC, CPU_TYPE::am_imm>(cycles, mem, operand);
+			cpu.storeLazyFlags();
+			return cpu.reg_acc;
+		}
+
+		// sets every flag but the ones under test (so they must be kept), the decimal flag and carry
+		template <class CPU_TYPE>
+		void start(CPU_TYPE &cpu, bool carry, BYTE acc) {
+			cpu.reg_status = 0b11001111;
+			cpu.fl_carry = carry;
+			cpu.loadLazyFlags();
+			cpu.reg_acc = acc;
+		}
+
+		// returns N, V, Z and C (and checks D and I were kept)
+		template <class CPU_TYPE>
+		BYTE status(CPU_TYPE &cpu) {
+			assert(cpu.fl_dec && cpu.fl_interr);
+			return cpu.reg_status & 0b11000011;
+		}
+
+		// ADC as in the 6502.org decimal mode tutorial (appendix A) : accumulator and carry from the adjusted sum, N and V from the signed sum
+		// before the high digit is adjusted, Z from the binary sum
+		static BYTE referenceAdd(bool carry, BYTE acc, BYTE operand, BYTE &flags) {
+			int low = (acc & 0x0F) + (operand & 0x0F) + carry;
+			if (low >= 0x0A) {
+				low = ((low + 0x06) & 0x0F) + 0x10;
+			}
+			int sum = (acc & 0xF0) + (operand & 0xF0) + low;
+			int signedSum = (int8_t)(acc & 0xF0) + (int8_t)(operand & 0xF0) + low;
+			if (sum >= 0xA0) {
+				sum += 0x60;
+			}
+			flags = (sum >= 0x100 ? 0b00000001 : 0) | (((acc + operand + carry) & 0xFF) == 0 ? 0b00000010 : 0)
+				| (signedSum < -128 || signedSum > 127 ? 0b01000000 : 0) | (signedSum & 0b10000000);
+			return sum & 0xFF;
+		}
+
+		// SBC as in appendix A for the NMOS 6502 : every flag from the binary difference
+		static BYTE referenceSubtract(bool carry, BYTE acc, BYTE operand, BYTE &flags) {
+			int low = (acc & 0x0F) - (operand & 0x0F) + carry - 1;
+			if (low < 0) {
+				low = ((low - 0x06) & 0x0F) - 0x10;
+			}
+			int difference = (acc & 0xF0) - (operand & 0xF0) + low;
+			if (difference < 0) {
+				difference -= 0x60;
+			}
+			int binary = acc - operand + carry - 1;
+			int signedBinary = (int8_t)acc - (int8_t)operand + carry - 1;
+			flags = (binary >= 0 ? 0b00000001 : 0) | ((binary & 0xFF) == 0 ? 0b00000010 : 0)
+				| (signedBinary < -128 || signedBinary > 127 ? 0b01000000 : 0) | (binary & 0b10000000);
+			return difference & 0xFF;
+		}
+}; // class AA : public testUnit
+
+// test unit for the handlers generated from the opcode descriptor table : the instructions the hand-written handlers got wrong, on every engine, timing and flags policy
+class AB : public testUnit {
+	public:
+		void test() {
+			std::cout << "test AB started" << std::endl;
+			constexpr std::array<m6502::CPU::DESCRIPTOR, 256> descriptors = m6502::CPU::descriptorTable();
+			assert(descriptors[m6502::CPU::ins_adc_absy].operation == m6502::ADC && descriptors[m6502::CPU::ins_adc_absy].mode == m6502::CPU::am_absy);
+			assert(descriptors[m6502::CPU::ins_sbc_absy].operation == m6502::SBC && descriptors[m6502::CPU::ins_cmp_absy].operation == m6502::CMP);
+			assert(descriptors[m6502::CPU::ins_ror_absx].operation == m6502::ROR && descriptors[m6502::CPU::ins_ror_absx].cycles == 7);
+			// unimplemented opcodes are implied NOPs
+			assert(descriptors[0x02].operation == m6502::NOP && descriptors[0x02].mode == m6502::CPU::am_imp && descriptors[0x02].cycles == 2);
+			std::cout << "test AB : first assert passed" << std::endl;
+			for (const CASE &instruction : cases) {
+				check<m6502::CPU, m6502::CPU::DISPATCH_SWITCH>(instruction);
+				check<m6502::CPU, m6502::CPU::DISPATCH_TABLE>(instruction);
+				check<m6502::CPU, m6502::CPU::DISPATCH_THREADED>(instruction);
+				check<m6502::CPU, m6502::CPU::DISPATCH_CACHED>(instruction);
+			}
+			std::cout << "test AB : second assert passed" << std::endl;
+			typedef m6502::CPU_T<m6502::EXACT_TIMING, m6502::LAZY_FLAGS> LAZY_CPU;
+			typedef m6502::CPU_T<m6502::INSTRUCTION_TIMING, m6502::LAZY_FLAGS> LAZY_FAST_CPU;
+			for (const CASE &instruction : cases) {
+				check<m6502::FAST_CPU, m6502::FAST_CPU::DISPATCH_SWITCH>(instruction);
+				check<m6502::FAST_CPU, m6502::FAST_CPU::DISPATCH_CACHED>(instruction);
+				check<LAZY_CPU, LAZY_CPU::DISPATCH_THREADED>(instruction);
+				check<LAZY_FAST_CPU, LAZY_FAST_CPU::DISPATCH_TABLE>(instruction);
+			}
+			std::cout << "test AB completed" << std::endl;
+		}
+	private:
+		typedef m6502::BYTE BYTE;
+		typedef m6502::WORD WORD;
+
+		// one instruction at 0x2000 and what it must leave. value is stored at 0x0010, 0x3000 and 0x3001 (the zero-page, absolute and indexed operands used,
+		// indexes being 1), target is the address whose byte must be result afterwards. status holds NV--DIZC
+		struct CASE {
+			BYTE bytes[3];
+			BYTE acc, x, y, status, value;
+			BYTE resultAcc, resultX, resultY, resultStackPointer, resultStatus;
+			WORD target;
+			BYTE result;
+			WORD programCounter;
+		}; // struct CASE
+
+		static constexpr CASE cases[] = {
+			// bit : zero from A AND value, V and N from the value read (bit $10, then bit $3000)
+			{{0x24, 0x10}, 0x01, 0, 0, 0b00000000, 0xC0, 0x01, 0, 0, 0xFD, 0b11000010, 0x0010, 0xC0, 0x2002},
+			{{0x2C, 0x00, 0x30}, 0x40, 0, 0, 0b00000000, 0x40, 0x40, 0, 0, 0xFD, 0b01000000, 0x3000, 0x40, 0x2003},
+			// shifts and rotates take the carry from bit 7 or 0 and Z and N from the value written (asl $10, rol $3000, ror $10, ror $3000,x, lsr $3000, asl $3000,x)
+			{{0x06, 0x10}, 0x00, 0, 0, 0b00000000, 0x81, 0x00, 0, 0, 0xFD, 0b00000001, 0x0010, 0x02, 0x2002},
+			{{0x2E, 0x00, 0x30}, 0x00, 0, 0, 0b00000001, 0x80, 0x00, 0, 0, 0xFD, 0b00000001, 0x3000, 0x01, 0x2003},
+			{{0x66, 0x10}, 0x55, 0, 0, 0b00000000, 0x01, 0x55, 0, 0, 0xFD, 0b00000011, 0x0010, 0x00, 0x2002},
+			{{0x7E, 0x00, 0x30}, 0x00, 1, 0, 0b00000001, 0x02, 0x00, 1, 0, 0xFD, 0b10000000, 0x3001, 0x81, 0x2003},
+			{{0x4E, 0x00, 0x30}, 0x00, 0, 0, 0b00000000, 0x01, 0x00, 0, 0, 0xFD, 0b00000011, 0x3000, 0x00, 0x2003},
+			{{0x1E, 0x00, 0x30}, 0x00, 1, 0, 0b00000000, 0x40, 0x00, 1, 0, 0xFD, 0b10000000, 0x3001, 0x80, 0x2003},
+			// absolute read-modify-writes reach the whole 16-bit address (inc $3000, dec $3000,x)
+			{{0xEE, 0x00, 0x30}, 0x00, 0, 0, 0b00000000, 0xFF, 0x00, 0, 0, 0xFD, 0b00000010, 0x3000, 0x00, 0x2003},
+			{{0xDE, 0x00, 0x30}, 0x00, 1, 0, 0b00000000, 0x00, 0x00, 1, 0, 0xFD, 0b10000000, 0x3001, 0xFF, 0x2003},
+			// jmp ($30FF) takes its high byte from 0x3000 (0x12), not from 0x3100
+			{{0x6C, 0xFF, 0x30}, 0x00, 0, 0, 0b00000000, 0x12, 0x00, 0, 0, 0xFD, 0b00000000, 0x3000, 0x12, 0x1234},
+			// tay copies A to Y, txs sets no flag
+			{{0xA8}, 0x80, 0x11, 0, 0b00000000, 0x00, 0x80, 0x11, 0x80, 0xFD, 0b10000000, 0x0010, 0x00, 0x2001},
+			{{0x9A}, 0x00, 0x00, 0, 0b00000000, 0x00, 0x00, 0x00, 0, 0x00, 0b00000000, 0x0010, 0x00, 0x2001},
+			// adc : carry out of bit 7 with the carry in counted (adc #$00, adc #$50, adc $3000,y)
+			{{0x69, 0x00}, 0xFF, 0, 0, 0b00000001, 0x00, 0x00, 0, 0, 0xFD, 0b00000011, 0x0010, 0x00, 0x2002},
+			{{0x69, 0x50}, 0x50, 0, 0, 0b00000000, 0x00, 0xA0, 0, 0, 0xFD, 0b11000000, 0x0010, 0x00, 0x2002},
+			{{0x79, 0x00, 0x30}, 0x01, 0, 1, 0b00000000, 0x01, 0x02, 0, 1, 0xFD, 0b00000000, 0x3001, 0x01, 0x2003},
+			// sbc : the carry is the inverted borrow, in and out (sbc #$01, sbc #$B0, sbc $3000,y)
+			{{0xE9, 0x01}, 0x00, 0, 0, 0b00000001, 0x00, 0xFF, 0, 0, 0xFD, 0b10000000, 0x0010, 0x00, 0x2002},
+			{{0xE9, 0xB0}, 0x50, 0, 0, 0b00000001, 0x00, 0xA0, 0, 0, 0xFD, 0b11000000, 0x0010, 0x00, 0x2002},
+			{{0xF9, 0x00, 0x30}, 0x05, 0, 1, 0b00000000, 0x01, 0x03, 0, 1, 0xFD, 0b00000001, 0x3001, 0x01, 0x2003},
+			// compares : carry set if the register is greater or equal (cmp #$10, cmp $3000,y, cpx #$80, cpy $10)
+			{{0xC9, 0x10}, 0x10, 0, 0, 0b00000000, 0x00, 0x10, 0, 0, 0xFD, 0b00000011, 0x0010, 0x00, 0x2002},
+			{{0xD9, 0x00, 0x30}, 0x10, 0, 1, 0b00000001, 0x20, 0x10, 0, 1, 0xFD, 0b10000000, 0x3001, 0x20, 0x2003},
+			{{0xE0, 0x80}, 0x00, 0x00, 0, 0b00000001, 0x00, 0x00, 0x00, 0, 0xFD, 0b10000000, 0x0010, 0x00, 0x2002},
+			{{0xC4, 0x10}, 0x00, 0, 0x80, 0b00000000, 0x7F, 0x00, 0, 0x80, 0xFD, 0b00000001, 0x0010, 0x7F, 0x2002}
+		};
+
+		// runs the instruction of a case alone (its budget is its base cost, there is no page cross) and checks the machine it leaves
+		template <class CPU_TYPE, int DISPATCH>
+		void check(const CASE &instruction) {
+			std::vector<BYTE> image = constructProgram({instruction.bytes[0], instruction.bytes[1], instruction.bytes[2]}, {0, 0});
+			image[0x0010] = image[0x3000] = image[0x3001] = instruction.value;
+			image[0x30FF] = 0x34;
+			image[0x3100] = 0x56;
+			mem.init(&cycles);
+			mem.fill(image);
+			CPU_TYPE cpu;
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cpu.reg_acc = instruction.acc;
+			cpu.reg_x = instruction.x;
+			cpu.reg_y = instruction.y;
+			cpu.reg_status = instruction.status;
+			cycles = CPU_TYPE::cycleTable()[instruction.bytes[0]];
+			cpu.template executeWith<DISPATCH>(cycles, mem);
+			assert(cycles == 0 && cpu.reg_programCounter == instruction.programCounter && cpu.reg_stackPointer == instruction.resultStackPointer);
+			assert(cpu.reg_acc == instruction.resultAcc && cpu.reg_x == instruction.resultX && cpu.reg_y == instruction.resultY && cpu.reg_status == instruction.resultStatus);
+			// the 16-bit address was written, not its low byte in page zero
+			assert(mem[instruction.target] == instruction.result && mem[0x0000] == 0 && mem[0x0001] == 0);
+		}
+}; // class AB : public testUnit
+
+// test unit for the CPU_T policies : the minimal instantiation (MINIMAL_CPU) against the full one, and the features each policy leaves out
+class AC : public testUnit {
+	public:
+		typedef m6502::CPU_T<m6502::INSTRUCTION_TIMING, m6502::EAGER_FLAGS, m6502::PAGED_BUS, m6502::SINK_TRACE, m6502::SCHEDULED_INTERRUPTS> FULL_CPU;
+
+		void test() {
+			std::cout << "test AC started" << std::endl;
+			// sta $3000 then lda $3000 : the flat bus writes a ROM page like RAM
+			std::vector<m6502::BYTE> program = {
+				m6502::CPU::ins_lda_im, 0x42,			// 2000 : lda #$42
+				m6502::CPU::ins_sta_abs, 0x00, 0x30,	// 2002 : sta $3000
+				m6502::CPU::ins_lda_abs, 0x00, 0x30,	// 2005 : lda $3000
+				m6502::CPU::ins_jmp_abs, 0x08, 0x20		// 2008 : jmp $2008
+			};
+			m6502::MINIMAL_CPU minimal;
+			FULL_CPU full;
+			m6502::RING_TRACE_SINK<1024> minimalSink, fullSink;
+			m6502::SCHEDULER minimalScheduler, fullScheduler;
+			assert(run(minimal, program, minimalSink, minimalScheduler) == 0x42 && minimalSink.size() == 0 && minimal.interrupts == 0);
+			std::cout << "test AC : first assert passed" << std::endl;
+			// the full CPU keeps the ROM byte, reports its accesses and takes the NMI
+			assert(run(full, program, fullSink, fullScheduler) == 0xEA && fullSink.size() > 0 && full.interrupts == 1);
+			std::cout << "test AC : second assert passed" << std::endl;
+			std::mt19937 random(6502);
+			for (int image = 0; image < 50; image++) {
+				std::vector<m6502::BYTE> bytes(m6502::MEMORY::MEM_SIZE);
+				for (m6502::BYTE &byte : bytes) {
+					byte = random();
+				}
+				bytes[0xFFFC] = 0x00;
+				bytes[0xFFFD] = 0x20;
+				compare<m6502::MINIMAL_CPU, FULL_CPU>(bytes);
+				compare<m6502::CPU_T<m6502::EXACT_TIMING, m6502::EAGER_FLAGS, m6502::FLAT_BUS, m6502::NO_TRACE, m6502::NO_INTERRUPTS>, m6502::CPU>(bytes);
+			}
+			std::cout << "test AC completed" << std::endl;
+		}
+	private:
+		// runs program with 0x3000 mapped as ROM, sink attached and an NMI pending on scheduler, returns the accumulator
+		template <class CPU_TYPE>
+		m6502::BYTE run(CPU_TYPE &cpu, const std::vector<m6502::BYTE> &program, m6502::TRACE_SINK &sink, m6502::SCHEDULER &scheduler) {
+			mem.init(&cycles);
+			std::vector<m6502::BYTE> image = constructProgram(program, {});
+			// the NMI handler is an rti
+			image[0xFFFA] = 0x00;
+			image[0xFFFB] = 0x40;
+			image[0x4000] = m6502::CPU::ins_rti;
+			mem.fill(image);
+			mem.mapRom(0x30, 0x30);
+			cpu.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			cycles = 7;
+			cpu.reset(cycles, mem);
+			cpu.traceSink = &sink;
+			cpu.scheduler = &scheduler;
+			scheduler.nmi(0, true);
+			cycles = 30;
+			cpu.execute(cycles, mem);
+			return cpu.reg_acc;
+		}
+
+		// runs image in slices on both instantiations (no ROM, device or sink : they must behave the same), comparing the machines after each slice
+		template <class FIRST_CPU, class SECOND_CPU>
+		void compare(const std::vector<m6502::BYTE> &image) {
+			uint32_t firstCycles = 0, secondCycles = 0;
+			m6502::MEMORY firstMem, secondMem;
+			FIRST_CPU first;
+			SECOND_CPU second;
+			firstMem.init(&firstCycles);
+			firstMem.fill(image);
+			secondMem.init(&secondCycles);
+			secondMem.fill(image);
+			first.throttle.mode = second.throttle.mode = m6502::THROTTLE::UNTHROTTLED;
+			firstCycles = secondCycles = 7;
+			first.reset(firstCycles, firstMem);
+			second.reset(secondCycles, secondMem);
+			for (int slice = 0; slice < 10; slice++) {
+				firstCycles = secondCycles = 300;
+				first.template executeWith<FIRST_CPU::DISPATCH_THREADED>(firstCycles, firstMem);
+				second.execute(secondCycles, secondMem);
+				assert(first.reg_programCounter == second.reg_programCounter && first.reg_acc == second.reg_acc && first.reg_x == second.reg_x);
+				assert(first.reg_y == second.reg_y && first.reg_stackPointer == second.reg_stackPointer && first.reg_status == second.reg_status);
+				assert(firstCycles == secondCycles);
+				for (uint32_t address = 0; address < m6502::MEMORY::MEM_SIZE; address++) {
+					assert(firstMem.readAt(address) == secondMem.readAt(address));
+				}
+			}
+		}
+}; // class AC : public testUnit
+
 int main() {
 	A a;
 	B b;
@@ -185,11 +1949,53 @@ int main() {
 	D d;
 	E e;
 	F f;
+	I i;
+	J j;
+	K k;
+	L l;
+	M m;
+	N n;
+	O o;
+	P p;
+	Q q;
+	R r;
+	S s;
+	T t;
+	U u;
+	V v;
+	W w;
+	X x;
+	Y y;
+	Z z;
+	AA aa;
+	AB ab;
+	AC ac;
 	a.test();
 	b.test();
 	c.test();
 	d.test();
 	e.test();
 	f.test();
+	i.test();
+	j.test();
+	k.test();
+	l.test();
+	m.test();
+	n.test();
+	o.test();
+	p.test();
+	q.test();
+	r.test();
+	s.test();
+	t.test();
+	u.test();
+	v.test();
+	w.test();
+	x.test();
+	y.test();
+	z.test();
+	aa.test();
+	ab.test();
+	ac.test();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef _THROTTLE_H
+#define _THROTTLE_H
+
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+namespace m6502 {
+
+	// paces emulated cycles against the host steady clock
+	// deadlines are absolute (origin + cycles / frequency), so rounding errors and oversleeps never accumulate into drift
+	struct THROTTLE {
+		public:
+			typedef std::chrono::steady_clock CLOCK;
+			typedef std::chrono::nanoseconds DURATION;
+
+			enum MODE {
+				REALTIME,		// sleeps to match frequency
+				UNTHROTTLED		// never sleeps (max speed)
+			};
+
+			MODE mode = REALTIME;			// pacing mode
+			uint32_t frequency = 1000000;	// emulated clock frequency in Hz (1 MHz by default)
+			uint32_t batchCycles = 1000;	// cycles run between two synchronisations with the host clock
+			DURATION catchUpLimit = std::chrono::milliseconds(100);	// lag after which pacing restarts from now instead of running flat out to catch up
+
+			uint64_t syncs;				// number of synchronisations with the host clock
+			uint64_t lateSyncs;			// synchronisations where the host was already past the deadline
+			uint64_t resyncs;			// times the lag exceeded catchUpLimit and the origin was moved
+			DURATION maxLag;			// worst lag behind real time seen at a synchronisation
+			DURATION totalLag;			// sum of all lags (divide by lateSyncs for the mean)
+			DURATION maxJitter;			// worst oversleep past a deadline
+			DURATION totalJitter;		// sum of all oversleeps (divide by syncs - lateSyncs for the mean)
+
+			// starts pacing from now and clears lag and jitter counters
+			void start() {
+				origin = CLOCK::now();
+				originCycles = 0;
+				// an unthrottled run never reaches its first synchronisation
+				nextSync = (mode == UNTHROTTLED ? UINT64_MAX : batchCycles);
+				syncs = lateSyncs = resyncs = 0;
+				maxLag = totalLag = maxJitter = totalJitter = DURATION::zero();
+			}
+
+			// called with the cycle count elapsed since start(). Sleeps until the deadline once a full batch has run
+			void sync(uint64_t elapsedCycles) {
+				if (elapsedCycles < nextSync) {
+					return;
+				}
+				nextSync = elapsedCycles + batchCycles;
+				syncs++;
+				CLOCK::time_point deadline = origin + cyclesToDuration(elapsedCycles - originCycles);
+				CLOCK::time_point now = CLOCK::now();
+				if (now >= deadline) {
+					// host fell behind real time : do not sleep
+					DURATION lag = std::chrono::duration_cast<DURATION>(now - deadline);
+					lateSyncs++;
+					totalLag += lag;
+					if (lag > maxLag) {
+						maxLag = lag;
+					}
+					if (lag > catchUpLimit) {
+						origin = now;
+						originCycles = elapsedCycles;
+						resyncs++;
+					}
+					return;
+				}
+				std::this_thread::sleep_until(deadline);
+				DURATION jitter = std::chrono::duration_cast<DURATION>(CLOCK::now() - deadline);
+				totalJitter += jitter;
+				if (jitter > maxJitter) {
+					maxJitter = jitter;
+				}
+			}
+
+			// returns host time taken by a number of emulated cycles at the current frequency
+			DURATION cyclesToDuration(uint64_t cycles) const {
+				// split in whole seconds and remainder to avoid overflowing 64 bits on long runs
+				return std::chrono::seconds(cycles / frequency) + DURATION((cycles % frequency) * 1000000000ull / frequency);
+			}
+		private:
+			CLOCK::time_point origin;	// host time at which originCycles was reached
+			uint64_t originCycles;		// elapsed cycles at origin
+			uint64_t nextSync;			// elapsed cycles at which the next synchronisation happens
+	}; // struct THROTTLE
+} // namespace m6502
+
+#endif // ifndef _THROTTLE_H
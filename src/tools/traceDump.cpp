@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../tracefile.h"
+
+// usage : traceDump file [--from cycle] [--to cycle] [--range low-high]
+// prints the records of a binary bus trace as "cycle addr r val" lines
+// --from seeks through the chunk index instead of decoding the whole file, --range keeps accesses to hex addresses low to high only
+int main(int argc, char **argv) {
+	if (argc < 2 || argc % 2 != 0) {
+		// every option takes a value
+		std::cerr << "usage : " << argv[0] << " file [--from cycle] [--to cycle] [--range low-high]" << std::endl;
+		return 1;
+	}
+	uint64_t from = 0;
+	uint64_t to = UINT64_MAX;
+	unsigned long low = 0x0000;
+	unsigned long high = 0xFFFF;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "--from") == 0) {
+			from = std::strtoull(argv[i + 1], nullptr, 10);
+		} else if (std::strcmp(argv[i], "--to") == 0) {
+			to = std::strtoull(argv[i + 1], nullptr, 10);
+		} else if (std::strcmp(argv[i], "--range") == 0) {
+			char *separator;
+			low = std::strtoul(argv[i + 1], &separator, 16);
+			high = (*separator == '-' ? std::strtoul(separator + 1, nullptr, 16) : low);
+		} else {
+			std::cerr << "unknown option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	m6502::TRACE_READER reader;
+	if (!reader.open(argv[1])) {
+		std::cerr << "cannot read trace " << argv[1] << std::endl;
+		return 1;
+	}
+	if (from > 0) {
+		reader.seek(from);
+	}
+	m6502::TRACE_RECORD record;
+	while (reader.next(record) && record.cycle <= to) {
+		if (record.address >= low && record.address <= high) {
+			std::printf("%llu %04x %c %02x\n", (unsigned long long)record.cycle, record.address, (record.read ? 'r' : 'W'), record.value);
+		}
+	}
+	return 0;
+}
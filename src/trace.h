@@ -0,0 +1,120 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <ostream>
+
+namespace m6502 {
+
+	typedef uint8_t BYTE;	// uint8_t (1 byte)
+	typedef uint16_t WORD;	// uint16_t (2 bytes)
+
+	// one bus access as seen by CPU::rw
+	struct TRACE_RECORD {
+		uint64_t cycle;	// absolute emulated time of the access
+		WORD address;	// accessed address
+		BYTE value;		// byte read or written
+		bool read;		// true for a read, false for a write
+	}; // struct TRACE_RECORD
+
+	// receives every bus access of a CPU with the SINK_TRACE policy (the default tracing of CPU_T when M6502_TRACE is defined)
+	// with NO_TRACE, CPU::rw contains no tracing code at all
+	struct TRACE_SINK {
+		public:
+			virtual ~TRACE_SINK() {}
+
+			// called once per bus access, after the access is done
+			virtual void access(uint64_t cycle, WORD address, bool read, BYTE value) = 0;
+
+			// called with (cycle, address) at the start of each instruction, before the access fetching its opcode at address
+			virtual void instruction(uint64_t, WORD) {}
+
+			// writes out anything buffered
+			virtual void flush() {}
+	}; // struct TRACE_SINK
+
+	// discards every access (default sink of a traced CPU)
+	struct NULL_TRACE_SINK : public TRACE_SINK {
+		public:
+			void access(uint64_t, WORD, bool, BYTE) {}
+	}; // struct NULL_TRACE_SINK : public TRACE_SINK
+
+	inline NULL_TRACE_SINK nullTraceSink;	// shared instance used when no sink is attached
+
+	// lock-free single-producer single-consumer ring of records. The CPU thread produces, any one other thread may consume with pop()
+	// accesses are dropped (and counted) rather than blocking the CPU when the ring is full
+	template <size_t CAPACITY>
+	struct RING_TRACE_SINK : public TRACE_SINK {
+		public:
+			static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+			void access(uint64_t cycle, WORD address, bool read, BYTE value) {
+				size_t h = head.load(std::memory_order_relaxed);
+				if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+					dropped++;
+					return;
+				}
+				records[h & (CAPACITY - 1)] = {cycle, address, value, read};
+				head.store(h + 1, std::memory_order_release);
+			}
+
+			// moves the oldest record into record. Returns false if the ring is empty
+			bool pop(TRACE_RECORD &record) {
+				size_t t = tail.load(std::memory_order_relaxed);
+				if (t == head.load(std::memory_order_acquire)) {
+					return false;
+				}
+				record = records[t & (CAPACITY - 1)];
+				tail.store(t + 1, std::memory_order_release);
+				return true;
+			}
+
+			// returns the number of records waiting to be popped
+			size_t size() const {
+				return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+			}
+
+			uint64_t dropped = 0;	// accesses lost because the ring was full (written by the producer only)
+		private:
+			TRACE_RECORD records[CAPACITY];
+			alignas(64) std::atomic<size_t> head{0};	// next slot written by the producer
+			alignas(64) std::atomic<size_t> tail{0};	// next slot read by the consumer
+	}; // struct RING_TRACE_SINK : public TRACE_SINK
+
+	// formats accesses as "addr r val" / "addr W val" lines into a buffer written to a stream in large blocks
+	// unlike std::endl, nothing is flushed per access
+	struct TEXT_TRACE_SINK : public TRACE_SINK {
+		public:
+			TEXT_TRACE_SINK(std::ostream &nOut, size_t nBufferSize = 1 << 16) : out(nOut), bufferSize(nBufferSize) {
+				buffer.reserve(bufferSize + LINE_LENGTH);
+			}
+
+			~TEXT_TRACE_SINK() {
+				flush();
+			}
+
+			void access(uint64_t, WORD address, bool read, BYTE value) {
+				static constexpr char hex[] = "0123456789abcdef";
+				char line[LINE_LENGTH] = {hex[address >> 12], hex[(address >> 8) & 0xF], hex[(address >> 4) & 0xF], hex[address & 0xF], ' ', (read ? 'r' : 'W'), ' ', hex[value >> 4], hex[value & 0xF], '\n'};
+				buffer.append(line, LINE_LENGTH);
+				if (buffer.size() >= bufferSize) {
+					flush();
+				}
+			}
+
+			void flush() {
+				out.write(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+		private:
+			static constexpr size_t LINE_LENGTH = 10;
+			std::ostream &out;
+			size_t bufferSize;
+			std::string buffer;
+	}; // struct TEXT_TRACE_SINK : public TRACE_SINK
+} // namespace m6502
+
+#endif // ifndef _TRACE_H
@@ -0,0 +1,372 @@
+#ifndef _TRACEFILE_H
+#define _TRACEFILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace m6502 {
+
+	// binary bus trace file layout (all integers little-endian) :
+	//   file header   "6502TRC\0", uint32 version, uint32 records per chunk
+	//   chunks        uint64 first cycle, uint32 record count, uint32 byte length, then the encoded records
+	//   chunk index   one (uint64 first cycle, uint64 file offset) pair per chunk
+	//   footer        uint64 index offset, uint32 chunk count, "TIDX"
+	// each record starts with a tag byte :
+	//   bit 0         1 for a read, 0 for a write
+	//   bits 1-2      address : 0 = previous + 1, 1 = same high byte (low byte follows), 2 = full word follows, 3 = same as previous
+	//   bits 3-7      cycle delta from the previous record (0-30), 31 = delta follows as a LEB128 varint
+	// followed by the varint delta, the address bytes and the data byte. A typical opcode or operand fetch takes 2 bytes
+	// delta state restarts at every chunk so a reader can start decoding at any chunk found through the index
+	namespace tracefile {
+		static constexpr char FILE_MAGIC[8] = {'6', '5', '0', '2', 'T', 'R', 'C', '\0'};
+		static constexpr char FOOTER_MAGIC[4] = {'T', 'I', 'D', 'X'};
+		static constexpr uint32_t VERSION = 1;
+		static constexpr size_t FILE_HEADER_SIZE = 16;
+		static constexpr size_t CHUNK_HEADER_SIZE = 16;
+		static constexpr size_t INDEX_ENTRY_SIZE = 16;
+		static constexpr size_t FOOTER_SIZE = 16;
+
+		static constexpr BYTE ADDRESS_NEXT = 0;
+		static constexpr BYTE ADDRESS_LOW = 1;
+		static constexpr BYTE ADDRESS_FULL = 2;
+		static constexpr BYTE ADDRESS_SAME = 3;
+		static constexpr BYTE DELTA_ESCAPE = 31;
+
+		// appends an integer in little-endian order
+		template <typename T>
+		void put(std::vector<BYTE> &out, T value) {
+			for (size_t i = 0; i < sizeof(T); i++) {
+				out.push_back((BYTE)(value >> (8 * i)));
+			}
+		}
+
+		// reads an integer stored in little-endian order
+		template <typename T>
+		T get(const BYTE *in) {
+			T value = 0;
+			for (size_t i = 0; i < sizeof(T); i++) {
+				value |= (T)in[i] << (8 * i);
+			}
+			return value;
+		}
+	} // namespace tracefile
+
+	// trace sink writing the binary format above to a file
+	struct BINARY_TRACE_SINK : public TRACE_SINK {
+		public:
+			BINARY_TRACE_SINK(const char *path, uint32_t nChunkRecords = 1 << 16) : out(path, std::ios::binary | std::ios::trunc), chunkRecords(nChunkRecords) {
+				std::vector<BYTE> header(tracefile::FILE_MAGIC, tracefile::FILE_MAGIC + 8);
+				tracefile::put<uint32_t>(header, tracefile::VERSION);
+				tracefile::put<uint32_t>(header, chunkRecords);
+				write(header);
+			}
+
+			~BINARY_TRACE_SINK() {
+				close();
+			}
+
+			// returns false if the file could not be opened or written
+			bool good() const {
+				return out.good();
+			}
+
+			void access(uint64_t cycle, WORD address, bool read, BYTE value) {
+				if (!out.is_open()) {
+					return;
+				}
+				if (chunkCount == 0) {
+					chunkFirstCycle = previousCycle = cycle;
+					previousAddress = 0xFFFF;
+				}
+				uint64_t delta = cycle - previousCycle;
+				BYTE addressMode;
+				if (address == previousAddress) {
+					addressMode = tracefile::ADDRESS_SAME;
+				} else if (address == (WORD)(previousAddress + 1)) {
+					addressMode = tracefile::ADDRESS_NEXT;
+				} else if ((address >> 8) == (previousAddress >> 8)) {
+					addressMode = tracefile::ADDRESS_LOW;
+				} else {
+					addressMode = tracefile::ADDRESS_FULL;
+				}
+				chunk.push_back((read ? 1 : 0) | addressMode << 1 | (delta < tracefile::DELTA_ESCAPE ? delta : tracefile::DELTA_ESCAPE) << 3);
+				if (delta >= tracefile::DELTA_ESCAPE) {
+					do {
+						chunk.push_back((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0));
+						delta >>= 7;
+					} while (delta > 0);
+				}
+				if (addressMode == tracefile::ADDRESS_LOW) {
+					chunk.push_back(address & 0xFF);
+				} else if (addressMode == tracefile::ADDRESS_FULL) {
+					tracefile::put<WORD>(chunk, address);
+				}
+				chunk.push_back(value);
+				previousCycle = cycle;
+				previousAddress = address;
+				if (++chunkCount == chunkRecords) {
+					flush();
+				}
+			}
+
+			// ends the current chunk and writes it out
+			void flush() {
+				if (chunkCount == 0 || !out.is_open()) {
+					return;
+				}
+				index.push_back({chunkFirstCycle, offset});
+				std::vector<BYTE> header;
+				tracefile::put<uint64_t>(header, chunkFirstCycle);
+				tracefile::put<uint32_t>(header, chunkCount);
+				tracefile::put<uint32_t>(header, (uint32_t)chunk.size());
+				write(header);
+				write(chunk);
+				chunk.clear();
+				chunkCount = 0;
+			}
+
+			// writes the last chunk, the index and the footer. The sink ignores accesses afterwards
+			void close() {
+				if (!out.is_open()) {
+					return;
+				}
+				flush();
+				std::vector<BYTE> tail;
+				for (const INDEX_ENTRY &entry : index) {
+					tracefile::put<uint64_t>(tail, entry.firstCycle);
+					tracefile::put<uint64_t>(tail, entry.offset);
+				}
+				tracefile::put<uint64_t>(tail, offset);
+				tracefile::put<uint32_t>(tail, (uint32_t)index.size());
+				tail.insert(tail.end(), tracefile::FOOTER_MAGIC, tracefile::FOOTER_MAGIC + 4);
+				write(tail);
+				out.close();
+			}
+		private:
+			struct INDEX_ENTRY {
+				uint64_t firstCycle;
+				uint64_t offset;
+			};
+
+			void write(const std::vector<BYTE> &bytes) {
+				out.write((const char *)bytes.data(), bytes.size());
+				offset += bytes.size();
+			}
+
+			std::ofstream out;
+			uint32_t chunkRecords;		// records per chunk
+			uint64_t offset = 0;		// bytes written so far
+			std::vector<BYTE> chunk;	// encoded records of the current chunk
+			uint32_t chunkCount = 0;	// records in the current chunk
+			uint64_t chunkFirstCycle = 0;
+			uint64_t previousCycle = 0;
+			WORD previousAddress = 0xFFFF;
+			std::vector<INDEX_ENTRY> index;
+	}; // struct BINARY_TRACE_SINK : public TRACE_SINK
+
+	// memory-mapped reader of binary trace files. Seeking to a cycle only decodes from the closest indexed chunk
+	struct TRACE_READER {
+		public:
+			~TRACE_READER() {
+				close();
+			}
+
+			// maps a trace file. Returns false if it cannot be read or is not a complete trace (including an index entry pointing outside the chunks)
+			bool open(const char *path) {
+				close();
+				int fd = ::open(path, O_RDONLY);
+				if (fd < 0) {
+					return false;
+				}
+				struct stat info;
+				if (fstat(fd, &info) == 0 && (size_t)info.st_size >= tracefile::FILE_HEADER_SIZE + tracefile::FOOTER_SIZE) {
+					void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (mapping != MAP_FAILED) {
+						data = (const BYTE *)mapping;
+						size = info.st_size;
+					}
+				}
+				::close(fd);
+				if (data == nullptr) {
+					return false;
+				}
+				const BYTE *footer = data + size - tracefile::FOOTER_SIZE;
+				uint64_t indexOffset = tracefile::get<uint64_t>(footer);
+				chunkCount = tracefile::get<uint32_t>(footer + 8);
+				if (std::memcmp(data, tracefile::FILE_MAGIC, 8) != 0 || tracefile::get<uint32_t>(data + 8) != tracefile::VERSION
+					|| std::memcmp(footer + 12, tracefile::FOOTER_MAGIC, 4) != 0 || indexOffset < tracefile::FILE_HEADER_SIZE
+					|| indexOffset > size - tracefile::FOOTER_SIZE || size - tracefile::FOOTER_SIZE - indexOffset != (uint64_t)chunkCount * tracefile::INDEX_ENTRY_SIZE) {
+					close();
+					return false;
+				}
+				index = data + indexOffset;
+				// every chunk (header and records) must lie between the file header and the index
+				for (uint32_t i = 0; i < chunkCount; i++) {
+					uint64_t offset = tracefile::get<uint64_t>(index + i * tracefile::INDEX_ENTRY_SIZE + 8);
+					if (offset < tracefile::FILE_HEADER_SIZE || offset > indexOffset - tracefile::CHUNK_HEADER_SIZE
+						|| tracefile::get<uint32_t>(data + offset + 12) > indexOffset - tracefile::CHUNK_HEADER_SIZE - offset) {
+						close();
+						return false;
+					}
+				}
+				seekChunk(0);
+				return true;
+			}
+
+			void close() {
+				if (data != nullptr) {
+					munmap((void *)data, size);
+				}
+				data = nullptr;
+				size = 0;
+				chunkCount = 0;
+				chunk = 0;
+				position = end = 0;
+			}
+
+			// returns the number of chunks in the file
+			uint32_t chunks() const {
+				return chunkCount;
+			}
+
+			// positions the reader on the first record whose cycle is at least cycle
+			void seek(uint64_t cycle) {
+				// binary search for the last chunk starting before cycle (records of one cycle may straddle two chunks)
+				uint32_t low = 0;
+				uint32_t high = chunkCount;
+				while (high - low > 1) {
+					uint32_t middle = (low + high) / 2;
+					if (tracefile::get<uint64_t>(index + middle * tracefile::INDEX_ENTRY_SIZE) < cycle) {
+						low = middle;
+					} else {
+						high = middle;
+					}
+				}
+				seekChunk(low);
+				size_t savedPosition;
+				uint32_t savedChunk;
+				uint64_t savedCycle;
+				WORD savedAddress;
+				TRACE_RECORD record;
+				do {
+					savedPosition = position;
+					savedChunk = chunk;
+					savedCycle = previousCycle;
+					savedAddress = previousAddress;
+				} while (next(record) && record.cycle < cycle);
+				if (record.cycle >= cycle) {
+					// step back onto the record found
+					if (savedChunk != chunk) {
+						seekChunk(savedChunk);
+					}
+					position = savedPosition;
+					previousCycle = savedCycle;
+					previousAddress = savedAddress;
+				}
+			}
+
+			// decodes the next record. Returns false at the end of the trace, or at a record running past the end of its chunk (corrupt file)
+			bool next(TRACE_RECORD &record) {
+				record.cycle = 0;
+				while (position == end) {
+					if (chunk + 1 >= chunkCount) {
+						return false;
+					}
+					seekChunk(chunk + 1);
+				}
+				BYTE tag;
+				if (!take(tag)) {
+					return false;
+				}
+				uint64_t delta = tag >> 3;
+				if (delta == tracefile::DELTA_ESCAPE) {
+					delta = 0;
+					int shift = 0;
+					BYTE byte;
+					do {
+						if (shift >= 64 || !take(byte)) {
+							return false;
+						}
+						delta |= (uint64_t)(byte & 0x7F) << shift;
+						shift += 7;
+					} while (byte & 0x80);
+				}
+				WORD address = previousAddress;
+				BYTE low, high;
+				switch ((tag >> 1) & 0b11) {
+					case tracefile::ADDRESS_NEXT:
+						address++;
+						break;
+					case tracefile::ADDRESS_LOW:
+						if (!take(low)) {
+							return false;
+						}
+						address = (address & 0xFF00) | low;
+						break;
+					case tracefile::ADDRESS_FULL:
+						if (!take(low) || !take(high)) {
+							return false;
+						}
+						address = low | high << 8;
+						break;
+				}
+				BYTE value;
+				if (!take(value)) {
+					return false;
+				}
+				previousAddress = address;
+				previousCycle += delta;
+				record.cycle = previousCycle;
+				record.address = previousAddress;
+				record.read = (tag & 1);
+				record.value = value;
+				return true;
+			}
+		private:
+			// reads the next byte of the chunk into byte. Returns false (and stays at the end) if the chunk has no bytes left
+			bool take(BYTE &byte) {
+				if (position >= end) {
+					position = end;
+					return false;
+				}
+				byte = data[position++];
+				return true;
+			}
+
+			// moves to the start of a chunk and restarts delta decoding
+			void seekChunk(uint32_t nChunk) {
+				chunk = nChunk;
+				if (chunk >= chunkCount) {
+					position = end = 0;
+					return;
+				}
+				const BYTE *entry = index + chunk * tracefile::INDEX_ENTRY_SIZE;
+				size_t header = tracefile::get<uint64_t>(entry + 8);
+				previousCycle = tracefile::get<uint64_t>(data + header);
+				previousAddress = 0xFFFF;
+				position = header + tracefile::CHUNK_HEADER_SIZE;
+				end = position + tracefile::get<uint32_t>(data + header + 12);
+			}
+
+			const BYTE *data = nullptr;		// mapped file
+			size_t size = 0;				// mapped size
+			const BYTE *index = nullptr;	// first chunk index entry
+			uint32_t chunkCount = 0;
+			uint32_t chunk = 0;				// chunk being decoded
+			size_t position = 0;			// offset of the next record
+			size_t end = 0;					// offset past the last record of the chunk
+			uint64_t previousCycle = 0;
+			WORD previousAddress = 0xFFFF;
+	}; // struct TRACE_READER
+} // namespace m6502
+
+#endif // ifndef _TRACEFILE_H
@@ -0,0 +1,215 @@
+#ifndef _VIA_H
+#define _VIA_H
+
+#include <cstdint>
+#include <array>
+
+#include "6502.h"
+#include "scheduler.h"
+
+namespace m6502 {
+
+	// timers of a 6522 VIA (versatile interface adapter), mapped on one page of the bus (the 16 registers repeat over the page)
+	// the counters are not decremented every cycle : each timer keeps the time it was loaded at, a read computes the counter from the current time
+	// (SCHEDULER::now), and the underflow that raises IRQ is an event scheduled when the timer is loaded
+	// timer 1 is one-shot or free-running (ACR bit 6), timer 2 one-shot. The ports, shift register and pulse counting are not emulated : their registers only hold what is written
+	struct VIA : public DEVICE {
+		public:
+			// register numbers (low 4 bits of the address)
+			enum REGISTER : BYTE {
+				ORB = 0x0, ORA = 0x1, DDRB = 0x2, DDRA = 0x3,
+				T1C_L = 0x4, T1C_H = 0x5, T1L_L = 0x6, T1L_H = 0x7,
+				T2C_L = 0x8, T2C_H = 0x9, SR = 0xA, ACR = 0xB,
+				PCR = 0xC, IFR = 0xD, IER = 0xE, ORA_NH = 0xF
+			};
+
+			// IFR and IER bits
+			enum INTERRUPT : BYTE {
+				INT_T2 = 0b00100000,
+				INT_T1 = 0b01000000,
+				INT_ANY = 0b10000000		// IFR : set while an enabled flag is set, IER : set or clear the written bits
+			};
+
+			static constexpr BYTE ACR_T1_FREE_RUN = 0b01000000;
+
+			// nScheduler gives the time and receives the underflow events. IRQ is driven as source nSource of the scheduler
+			VIA(SCHEDULER *nScheduler, BYTE nSource = 0) : scheduler(nScheduler), source(nSource), timer1(this, INT_T1), timer2(this, INT_T2) {
+				registers.fill(0);
+			}
+
+			~VIA() {
+				timer1.stop();
+				timer2.stop();
+			}
+
+			// maps the registers on page of nMem. The VIA must outlive the mapping
+			void attach(MEMORY &nMem, BYTE page) {
+				nMem.mapDevice(page, page, this);
+			}
+
+			BYTE read(WORD address) {
+				switch (address & 0x0F) {
+					case T1C_L:
+						clearFlags(INT_T1);
+						return timer1.counter() & 0xFF;
+					case T1C_H:
+						return timer1.counter() >> 8;
+					case T1L_L:
+						return timer1.latch & 0xFF;
+					case T1L_H:
+						return timer1.latch >> 8;
+					case T2C_L:
+						clearFlags(INT_T2);
+						return timer2.counter() & 0xFF;
+					case T2C_H:
+						return timer2.counter() >> 8;
+					case IFR:
+						return flags | ((flags & enabled) != 0 ? INT_ANY : 0);
+					case IER:
+						return enabled | INT_ANY;
+					default:
+						return registers[address & 0x0F];
+				}
+			}
+
+			void write(WORD address, BYTE value) {
+				switch (address & 0x0F) {
+					case T1C_L:
+					case T1L_L:
+						timer1.latch = (timer1.latch & 0xFF00) | value;
+						break;
+					case T1C_H:
+						// loads the counter from the latch and starts timer 1
+						timer1.latch = (timer1.latch & 0x00FF) | value << 8;
+						clearFlags(INT_T1);
+						timer1.load(timer1.latch);
+						break;
+					case T1L_H:
+						timer1.latch = (timer1.latch & 0x00FF) | value << 8;
+						clearFlags(INT_T1);
+						break;
+					case T2C_L:
+						timer2.latch = (timer2.latch & 0xFF00) | value;
+						break;
+					case T2C_H:
+						clearFlags(INT_T2);
+						timer2.load((timer2.latch & 0x00FF) | value << 8);
+						break;
+					case IFR:
+						clearFlags(value);
+						break;
+					case IER:
+						enabled = ((value & INT_ANY) ? enabled | value : enabled & ~value) & ~INT_ANY;
+						updateIrq();
+						break;
+					default:
+						registers[address & 0x0F] = value;
+						break;
+				}
+			}
+
+			// returns the counter of timer 1 or 2 at the current time
+			WORD counter1() const {
+				return timer1.counter();
+			}
+
+			WORD counter2() const {
+				return timer2.counter();
+			}
+
+			uint64_t underflows = 0;	// timer underflows since construction (an event each, nothing runs between them)
+		private:
+			// one timer : counts down from start, loaded at time base, at one count per cycle
+			// it underflows start + 1 cycles after being loaded, reading 0xFFFF, then (free-running timer 1) reloads the latch on the next cycle
+			struct TIMER : public EVENT_HANDLER {
+				public:
+					TIMER(VIA *nVia, BYTE nFlag) : via(nVia), flag(nFlag) {}
+
+					// starts counting down from value at the current time, and schedules the underflow
+					void load(WORD value) {
+						stop();
+						start = value;
+						base = via->scheduler->now();
+						scheduleUnderflow(base + start + 1);
+					}
+
+					// cancels the pending underflow
+					void stop() {
+						if (running) {
+							via->scheduler->cancel(event);
+							running = false;
+						}
+					}
+
+					// computes the counter at the current time
+					WORD counter() const {
+						int64_t elapsed = (int64_t)(via->scheduler->now() - base);
+						if (elapsed < 0) {
+							// the underflow cycle of a free-running timer, just rebased (see fire)
+							return 0xFFFF;
+						}
+						if (elapsed <= start || !freeRunning()) {
+							return (WORD)(start - elapsed);
+						}
+						// free-running timer read past an underflow not fired yet (within the instruction it happens in) : latch + 2 cycles per period
+						uint64_t position = (elapsed - start - 1) % ((uint64_t)latch + 2);
+						return (position == 0 ? 0xFFFF : (WORD)(latch - (position - 1)));
+					}
+
+					void fire(uint64_t time) {
+						running = false;
+						via->underflows++;
+						via->setFlags(flag);
+						if (freeRunning()) {
+							// reloads the latch on the cycle after the underflow
+							start = latch;
+							base = time + 1;
+							scheduleUnderflow(base + start + 1);
+						}
+					}
+
+					WORD latch = 0;
+				private:
+					bool freeRunning() const {
+						return flag == INT_T1 && (via->registers[ACR] & ACR_T1_FREE_RUN);
+					}
+
+					void scheduleUnderflow(uint64_t time) {
+						event = via->scheduler->schedule(time, this);
+						running = true;
+					}
+
+					VIA *via;
+					BYTE flag;						// IFR bit set on underflow
+					WORD start = 0;					// counter at base
+					uint64_t base = 0;				// time the counter was (re)loaded
+					SCHEDULER::EVENT_ID event = 0;	// pending underflow, if running
+					bool running = false;
+			}; // struct TIMER : public EVENT_HANDLER
+
+			void setFlags(BYTE bits) {
+				flags |= bits & ~INT_ANY;
+				updateIrq();
+			}
+
+			void clearFlags(BYTE bits) {
+				flags &= ~bits;
+				updateIrq();
+			}
+
+			// holds IRQ while an enabled flag is set
+			void updateIrq() {
+				scheduler->irq(source, (flags & enabled) != 0);
+			}
+
+			SCHEDULER *scheduler;
+			BYTE source;					// IRQ source number on the scheduler
+			BYTE flags = 0;					// IFR without bit 7
+			BYTE enabled = 0;				// IER without bit 7
+			std::array<BYTE, 16> registers;	// registers without behaviour (ports, shift register, ACR, PCR)
+			TIMER timer1;
+			TIMER timer2;
+	}; // struct VIA : public DEVICE
+} // namespace m6502
+
+#endif // ifndef _VIA_H